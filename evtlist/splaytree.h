@@ -31,6 +31,11 @@ class SplayTree : public Eventlist<T> {
   virtual void cancel(SimEvent<T>* evt);
   virtual void clear();
 
+  // return the event right after the given one in timestamp order (or
+  // null if it's the last); the splay tree can be walked this way
+  // starting from getMin(), without taking the events out
+  SimEvent<T>* getNext(SimEvent<T>* evt) const;
+
  protected:
   int num_items; // total number of tree nodes
   SplayTreeNode<T>* root; // point to the root of the splay tree
@@ -241,6 +246,18 @@ void SplayTree<T>::clear()
   }
 }
 
+template<typename T>
+SimEvent<T>* SplayTree<T>::getNext(SimEvent<T>* evt) const
+{
+  SplayTreeNode<T>* n = (SplayTreeNode<T>*)evt;
+  if(SPLAYTREE_RIGHT(n)) {
+    for(n = SPLAYTREE_RIGHT(n); SPLAYTREE_LEFT(n); n = SPLAYTREE_LEFT(n));
+    return (SimEvent<T>*)n;
+  }
+  while(SPLAYTREE_UP(n) && n == SPLAYTREE_RIGHT(SPLAYTREE_UP(n))) n = SPLAYTREE_UP(n);
+  return (SimEvent<T>*)SPLAYTREE_UP(n);
+}
+
 template<typename T>
 SplayTreeNode<T>* SplayTree<T>::remove_min()
 {
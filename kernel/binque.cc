@@ -9,6 +9,12 @@ BinQueue::BinQueue() : bin_array(0), tmp_holder(0) {}
 
 void BinQueue::settle(VirtualTime bs, int nb, VirtualTime now)
 {
+  if(bin_array) { // settled before, must be empty
+    for(int i=0; i<nbins; i++) assert(!bin_array[i]);
+    assert(splay.size() == 0);
+    delete[] bin_array;
+  }
+
   binsize = bs;
   nbins = nb; assert(nbins > 0);
   offset = now;
@@ -49,7 +55,7 @@ void BinQueue::insert_event(ChannelEvent* evt)
 {
   assert(evt);
   if(!bin_array) { // before settlement
-    evt->get_next_event() = tmp_holder;
+    evt->set_next_event(tmp_holder);
     tmp_holder = evt;
   } else {
     VirtualTime key = evt->time()-offset;
@@ -58,7 +64,7 @@ void BinQueue::insert_event(ChannelEvent* evt)
     if(key < lower_edge+binsize*nbins) { // not too far into the future
       int n = key.get_ticks()/binsize.get_ticks()%nbins;
       assert(0 <= n && n < nbins);
-      evt->get_next_event() = bin_array[n];
+      evt->set_next_event(bin_array[n]);
       bin_array[n] = evt;
       //printf("%d: insert evt %lg into bin %d (binsize=%lg)\n", Universe::args_rank, key.second(), n, binsize.second());
     } else {
@@ -126,7 +132,7 @@ ChannelEvent* BinQueue::retrieve_events(VirtualTime upper_time)
       ChannelEvent* evt = (ChannelEvent*)splay.getMin();
       if(evt->time() < upper_time) {
 	splay.deleteMin();
-	evt->get_next_event() = evtlist;
+	evt->set_next_event(evtlist);
 	evtlist = evt;
       } else break;
     }
@@ -136,7 +142,7 @@ ChannelEvent* BinQueue::retrieve_events(VirtualTime upper_time)
     while(tmp_holder) {
       ChannelEvent* evt = tmp_holder;
       tmp_holder = (ChannelEvent*)evt->get_next_event();
-      evt->get_next_event() = evtlist;
+      evt->set_next_event(evtlist);
       evtlist = evt;
     }
 
@@ -144,6 +150,28 @@ ChannelEvent* BinQueue::retrieve_events(VirtualTime upper_time)
   }
 }
 
+ChannelEvent* BinQueue::retrieve_all_events()
+{
+  ChannelEvent* evtlist = tmp_holder;
+  tmp_holder = 0;
+  if(bin_array) {
+    for(int i=0; i<nbins; i++) {
+      while(bin_array[i]) {
+	ChannelEvent* evt = bin_array[i];
+	bin_array[i] = (ChannelEvent*)evt->get_next_event();
+	evt->set_next_event(evtlist);
+	evtlist = evt;
+      }
+    }
+  }
+  while(splay.size() > 0) {
+    ChannelEvent* evt = (ChannelEvent*)splay.deleteMin();
+    evt->set_next_event(evtlist);
+    evtlist = evt;
+  }
+  return evtlist;
+}
+
 }; // namespace minissf
 
 /*
@@ -17,7 +17,9 @@ public:
   // the constructor
   BinQueue();
 
-  // when it's time, construct the binque permanently
+  // when it's time, construct the binque permanently; it can be
+  // settled again (when the window size changes), but only after all
+  // events have been retrieved
   void settle(VirtualTime binsize, int nbins, VirtualTime now);
 
   // the destructor
@@ -29,6 +31,10 @@ public:
   // retrieve all events (as a linked list) from the bins below the given time
   ChannelEvent* retrieve_events(VirtualTime upper_time);
 
+  // retrieve all events (as a linked list) regardless of their time;
+  // the current bin is left unchanged
+  ChannelEvent* retrieve_all_events();
+
 private:
   VirtualTime binsize; // size of the bin (in virtual time)
   int nbins; // number of bins for the calendar queue
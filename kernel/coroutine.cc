@@ -0,0 +1,183 @@
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "kernel/coroutine.h"
+#include "kernel/universe.h"
+
+#if defined(__x86_64__) && defined(__ELF__)
+#define SSF_COROUTINE_HANDROLLED
+#else
+#include <ucontext.h>
+#endif
+
+namespace minissf {
+
+static long ssf_coroutine_pagesize = 0;
+
+#ifdef SSF_COROUTINE_HANDROLLED
+// switch stacks: save the callee-saved registers (and the control
+// words of the floating point units) on the current stack, store the
+// stack pointer at *save_sp, and restore the same from load_sp; a new
+// stack is laid out so that the switch "returns" to ssf_context_start,
+// which calls the coroutine function (in r13) with its argument (in r12)
+extern "C" void ssf_context_switch(void** save_sp, void* load_sp);
+extern "C" void ssf_context_start();
+asm(".text\n"
+    ".globl ssf_context_switch\n"
+    ".hidden ssf_context_switch\n"
+    ".type ssf_context_switch,@function\n"
+    "ssf_context_switch:\n"
+    "  pushq %rbp\n"
+    "  pushq %rbx\n"
+    "  pushq %r12\n"
+    "  pushq %r13\n"
+    "  pushq %r14\n"
+    "  pushq %r15\n"
+    "  subq $8, %rsp\n"
+    "  stmxcsr (%rsp)\n"
+    "  fnstcw 4(%rsp)\n"
+    "  movq %rsp, (%rdi)\n"
+    "  movq %rsi, %rsp\n"
+    "  ldmxcsr (%rsp)\n"
+    "  fldcw 4(%rsp)\n"
+    "  addq $8, %rsp\n"
+    "  popq %r15\n"
+    "  popq %r14\n"
+    "  popq %r13\n"
+    "  popq %r12\n"
+    "  popq %rbx\n"
+    "  popq %rbp\n"
+    "  ret\n"
+    ".size ssf_context_switch,.-ssf_context_switch\n"
+    ".globl ssf_context_start\n"
+    ".hidden ssf_context_start\n"
+    ".type ssf_context_start,@function\n"
+    "ssf_context_start:\n"
+    "  movq %r12, %rdi\n"
+    "  callq *%r13\n"
+    "  ud2\n" // the coroutine function must never return
+    ".size ssf_context_start,.-ssf_context_start\n");
+#else
+// the context is kept at the bottom of the stack (just above the
+// guard page): one for the coroutine and one for the caller
+static void ssf_context_entry(int lo, int hi)
+{
+  // makecontext() passes integer arguments only
+  unsigned long x = ((unsigned long)(unsigned int)hi << 32) | (unsigned int)lo;
+  void** args = (void**)x;
+  ((CoroutineFunction)args[0])(args[1]);
+  assert(0); // the coroutine function must never return
+}
+#endif
+
+Coroutine::Coroutine(Timeline* tmln, CoroutineFunction func, void* arg) :
+  universe(tmln->universe)
+{
+  assert(universe);
+  if(!ssf_coroutine_pagesize) ssf_coroutine_pagesize = sysconf(_SC_PAGESIZE);
+  if(!universe->stack_pool.empty()) {
+    stack = universe->stack_pool.back();
+    universe->stack_pool.pop_back();
+  } else {
+    // map the stack and the guard page below it
+    char* mem = (char*)mmap(0, Universe::args_stack_size+ssf_coroutine_pagesize, 
+			    PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(mem == (char*)MAP_FAILED) SSF_THROW("can't map process stack");
+    if(mprotect(mem, ssf_coroutine_pagesize, PROT_NONE))
+      SSF_THROW("can't protect the guard page of process stack");
+    stack = mem+ssf_coroutine_pagesize;
+  }
+
+#ifdef SSF_COROUTINE_HANDROLLED
+  // the initial frame: mxcsr and x87 control word, r15, r14, r13
+  // (function), r12 (argument), rbx, rbp, and the return address
+  void** sp = (void**)(stack+Universe::args_stack_size); // page aligned
+  *--sp = (void*)ssf_context_start;
+  *--sp = 0; // rbp
+  *--sp = 0; // rbx
+  *--sp = arg; // r12
+  *--sp = (void*)func; // r13
+  *--sp = 0; // r14
+  *--sp = 0; // r15
+  *--sp = 0;
+  ((unsigned int*)sp)[0] = 0x1f80; // default mxcsr
+  ((unsigned short*)sp)[2] = 0x037f; // default x87 control word
+  coroutine_sp = (void*)sp;
+  caller_sp = 0;
+#else
+  ucontext_t* ctx = (ucontext_t*)stack;
+  void** args = (void**)(ctx+2);
+  args[0] = (void*)func;
+  args[1] = arg;
+  char* base = (char*)(args+2);
+  if(getcontext(&ctx[0])) SSF_THROW("can't get process context");
+  ctx[0].uc_stack.ss_sp = base;
+  ctx[0].uc_stack.ss_size = stack+Universe::args_stack_size-base;
+  ctx[0].uc_link = 0;
+  unsigned long x = (unsigned long)args;
+  makecontext(&ctx[0], (void(*)())ssf_context_entry, 2, (int)(unsigned int)x, (int)(unsigned int)(x>>32));
+  coroutine_sp = (void*)&ctx[0];
+  caller_sp = (void*)&ctx[1];
+#endif
+}
+
+Coroutine::~Coroutine()
+{
+  universe->stack_pool.push_back(stack);
+}
+
+void Coroutine::resume()
+{
+#ifdef SSF_COROUTINE_HANDROLLED
+  ssf_context_switch(&caller_sp, coroutine_sp);
+#else
+  swapcontext((ucontext_t*)caller_sp, (ucontext_t*)coroutine_sp);
+#endif
+}
+
+void Coroutine::yield()
+{
+#ifdef SSF_COROUTINE_HANDROLLED
+  ssf_context_switch(&coroutine_sp, caller_sp);
+#else
+  swapcontext((ucontext_t*)coroutine_sp, (ucontext_t*)caller_sp);
+#endif
+}
+
+void ssf_coroutine_wrapup(Universe* univ)
+{
+  for(VECTOR(char*)::iterator iter = univ->stack_pool.begin();
+      iter != univ->stack_pool.end(); iter++)
+    munmap((*iter)-ssf_coroutine_pagesize, Universe::args_stack_size+ssf_coroutine_pagesize);
+  univ->stack_pool.clear();
+}
+
+}; /*namespace minissf*/
+
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
@@ -0,0 +1,78 @@
+// stackful coroutines for running simulation processes on their own
+// stacks (an alternative to the procedure frames of translated code)
+
+#ifndef __MINISSF_COROUTINE_H__
+#define __MINISSF_COROUTINE_H__
+
+#include "ssfapi/ssf_common.h"
+
+namespace minissf {
+
+// the function run by a coroutine; it must never return
+typedef void (*CoroutineFunction)(void*);
+
+// a coroutine runs a function on its own stack; the stack is taken
+// from the pool of the universe that first runs the coroutine and
+// has a guard page at the bottom to catch overflows; the context
+// switch only saves the callee-saved registers (hand-rolled for
+// x86-64; ucontext is used on other machines)
+class Coroutine {
+ public:
+  // create the coroutine for running on the given timeline, which
+  // will start the function with the given argument when it's
+  // resumed for the first time
+  Coroutine(Timeline* tmln, CoroutineFunction func, void* arg);
+
+  // the stack is returned to the pool of the universe; whatever is
+  // on the stack is simply discarded (no destructors are called)
+  ~Coroutine();
+
+  // switch from the caller to the coroutine; it returns when the
+  // coroutine yields
+  void resume();
+
+  // switch from the coroutine back to the caller; it returns when
+  // the coroutine is resumed
+  void yield();
+
+ protected:
+  Universe* universe; // the universe owning the stack pool
+  char* stack; // the stack (from the lowest address, excluding the guard page)
+  void* coroutine_sp; // saved context of the coroutine
+  void* caller_sp; // saved context of the caller
+}; /*class Coroutine*/
+
+// reclaim all stacks in the pool of the universe; called at the end
+// of simulation after all processes are gone
+extern void ssf_coroutine_wrapup(Universe* univ);
+
+}; /*namespace minissf*/
+
+#endif /*__MINISSF_COROUTINE_H__*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
@@ -58,7 +58,16 @@ void TimerEvent::process_event(Timeline* timeline)
 {
   assert(timer->timer_event == this);
   timer->timer_event = 0;
-  timer->callback();
+  if(timer->timer_entity_callback) 
+    (timer->entity_owner->*timer->timer_entity_callback)(timer);
+  else if(timer->timer_callback) timer->timer_callback(timer);
+  else timer->callback();
+}
+
+void TimerEvent::discard()
+{
+  assert(timer->timer_event == this);
+  timer->timer_event = 0;
 }
 
 /* hold event for wait statements */
@@ -78,7 +87,7 @@ void HoldEvent::process_event(Timeline* timeline)
   // sign off; or, if it's waiting on a set of dynamic in-channels,
   // insensitize it
   if(process->static_sensitivity) process->static_sensitivity = false;
-  else if(process->waiton_node) process->desensitize_inchannels();
+  else if(process->waiton_count) process->desensitize_inchannels();
 
   // activate the process
   timeline->activate_process(process);
@@ -112,13 +121,13 @@ void SemaphoreEvent::process_event(Timeline* timeline)
 /* chained event */
 
 ChainedEvent::ChainedEvent(Entity* ent, VirtualTime vt, Event* evt) :
-  KernelEvent(ent, vt), event(evt), nextevt(0) {}
+  KernelEvent(ent, vt), event(evt) {}
 
 ChainedEvent::ChainedEvent(Timestamp ts, Event* evt) :
-  KernelEvent(ts), event(evt), nextevt(0) {}
+  KernelEvent(ts), event(evt) {}
 
 ChainedEvent::~ChainedEvent() {
-  if(event) delete event;
+  if(event) Event::release_event(event);
 }
 
 /* emulated event */
@@ -148,90 +157,106 @@ void EmulatedTimerEvent::process_event(Timeline* timeline)
 
 ChannelEvent::ChannelEvent(outChannel* oc, VirtualTime arrival, Event* evt, MapInport* ip) :
   ChainedEvent(oc->entity_owner, arrival, evt), 
-  inport(ip), stargate(0), outportno(0) {}
+  inport(ip), resolved(true), stargate(0) {}
 
 ChannelEvent::ChannelEvent(outChannel* oc, VirtualTime arrival, Event* evt, int pno) :
-  ChainedEvent(oc->entity_owner, arrival, evt),
-  inport(0), stargate(0), outportno(pno) {}
+  ChainedEvent(oc->entity_owner, arrival, evt), 
+  inport(0), resolved(false), stargate(0) { outportno = pno; }
 
 ChannelEvent::ChannelEvent(Timestamp t, Event* evt, MapInport* ip) :
-  ChainedEvent(t, evt), inport(ip), stargate(0), outportno(0) {}
+  ChainedEvent(t, evt), inport(ip), resolved(true), stargate(0) {}
 
 ChannelEvent::ChannelEvent(Timestamp t, Event* evt, int pno) :
-  ChainedEvent(t, evt), inport(0), stargate(0), outportno(pno) {}
+  ChainedEvent(t, evt), inport(0), resolved(false), stargate(0) {
+  outportno = pno; // the union is cleared first (the pointer is wider)
+}
 
 bool ChannelEvent::is_emulated()
 { 
-  if(inport) return inport->ic->entity_owner->isEmulated();
+  if(resolved && inport) return inport->ic->entity_owner->isEmulated();
   else return false;
 }
 
 void ChannelEvent::process_event(Timeline* timeline) 
 {
-  assert(inport);
+  assert(resolved && inport);
   Event* evt = delete_event(); assert(evt);
   if(inport->next) {
     Timestamp ts = time();
     ts.key1 += int64(inport->next->extra_delay);
     ChannelEvent* chevt = new ChannelEvent
-      (ts, evt->clone(), inport->next);
+      (ts, Event::share_event(evt), inport->next);
     timeline->insert_event(chevt);
   }
   inport->ic->schedule_arrival(evt);
 }
 
-#ifdef HAVE_MPI_H
+/* null message kept by the stargate */
+
+NullMessage::NullMessage(Stargate* sg) :
+  ChainedEvent(Timestamp(0,0,0), 0), stargate(sg), posted(false) {}
+
+void NullMessage::process_event(Timeline* timeline)
+{
+  assert(0); // the null message is never inserted into the event list
+}
+
 #define MAXEVTSIZ 4096
-void ChannelEvent::pack(MPI_Comm comm, char* buffer, int& pos, int bufsiz)
+#define NULL_MESSAGE_FLAG 0x80000000u // set in the packed outport number of a null message
+void ChannelEvent::pack(char* buffer, int& pos, int bufsiz)
 {
+  // the outport number goes first so that the receiver can tell a
+  // null message, which has only the time and the target timeline id
   Timestamp ts = time();
-  ssf_mpi_pack(&ts.key1, 1, MPI_LONG_LONG_INT, buffer, bufsiz, &pos, comm);
-  ssf_mpi_pack(&ts.key2, 1, MPI_UNSIGNED, buffer, bufsiz, &pos, comm);
-  ssf_mpi_pack(&ts.key3, 1, MPI_UNSIGNED, buffer, bufsiz, &pos, comm);
-
-  ssf_mpi_pack(&outportno, 1, MPI_UNSIGNED, buffer, bufsiz, &pos, comm);
+  uint32 portno = (uint32)get_outportno();
+  assert(!(portno&NULL_MESSAGE_FLAG));
+  if(!event) portno |= NULL_MESSAGE_FLAG;
+  ssf_pack(&portno, sizeof(portno), buffer, bufsiz, &pos);
+  ssf_pack(&ts.key1, sizeof(ts.key1), buffer, bufsiz, &pos);
+  ssf_pack(&ts.key2, sizeof(ts.key2), buffer, bufsiz, &pos);
+  if(!event) return;
+  ssf_pack(&ts.key3, sizeof(ts.key3), buffer, bufsiz, &pos);
 
   //int32 emu = emulated ? 1 : 0;
-  //ssf_mpi_pack(&emu, 1, MPI_INT, buffer, bufsiz, &pos, comm);
+  //ssf_pack(&emu, sizeof(emu), buffer, bufsiz, &pos);
 
   int32 event_ident, data_size;
-  char* sbuf = 0;
-  if(event) {
-    event_ident = event->event_class_ident();
-    sbuf = new char[MAXEVTSIZ]; /*(char*)QuickObject::quick_new(MAXEVTSIZ);*/ assert(sbuf);
-    data_size = event->pack(sbuf, bufsiz-pos-16); // 16 is for safety
-    //printf("packing bufsiz=%d pos=%d ds=%d\n", bufsiz, pos, data_size);
-  } else event_ident = data_size = 0;
-  ssf_mpi_pack(&event_ident, 1, MPI_INT, buffer, bufsiz, &pos, comm);
-  ssf_mpi_pack(&data_size, 1, MPI_INT, buffer, bufsiz, &pos, comm);
+  event_ident = event->event_class_ident();
+  char* sbuf = new char[MAXEVTSIZ]; /*(char*)QuickObject::quick_new(MAXEVTSIZ);*/ assert(sbuf);
+  data_size = event->pack(sbuf, bufsiz-pos-16); // 16 is for safety
+  //printf("packing bufsiz=%d pos=%d ds=%d\n", bufsiz, pos, data_size);
+  ssf_pack(&event_ident, sizeof(event_ident), buffer, bufsiz, &pos);
+  ssf_pack(&data_size, sizeof(data_size), buffer, bufsiz, &pos);
   //printf("packing %d bytes\n", data_size);
   if(data_size > 0)
-    ssf_mpi_pack(sbuf, data_size, MPI_CHAR, buffer, bufsiz, &pos, comm);
-  if(sbuf) delete[] sbuf; /*QuickObject::quick_delete(sbuf);*/
+    ssf_pack(sbuf, data_size, buffer, bufsiz, &pos);
+  delete[] sbuf; /*QuickObject::quick_delete(sbuf);*/
 }
 
-ChannelEvent* ChannelEvent::unpack(MPI_Comm comm, char* buffer, int& pos, int bufsiz)
+ChannelEvent* ChannelEvent::unpack(char* buffer, int& pos, int bufsiz)
 {
-  Timestamp ts;
-  ssf_mpi_unpack(buffer, bufsiz, &pos, &ts.key1, 1, MPI_LONG_LONG_INT, comm);
-  ssf_mpi_unpack(buffer, bufsiz, &pos, &ts.key2, 1, MPI_UNSIGNED, comm);
-  ssf_mpi_unpack(buffer, bufsiz, &pos, &ts.key3, 1, MPI_UNSIGNED, comm);
-
   uint32 outportno;
-  ssf_mpi_unpack(buffer, bufsiz, &pos, &outportno, 1, MPI_UNSIGNED, comm);
+  ssf_unpack(buffer, bufsiz, &pos, &outportno, sizeof(outportno));
+
+  Timestamp ts;
+  ssf_unpack(buffer, bufsiz, &pos, &ts.key1, sizeof(ts.key1));
+  ssf_unpack(buffer, bufsiz, &pos, &ts.key2, sizeof(ts.key2));
+  if(outportno&NULL_MESSAGE_FLAG) 
+    return new ChannelEvent(ts, 0, (int)(outportno&~NULL_MESSAGE_FLAG));
+  ssf_unpack(buffer, bufsiz, &pos, &ts.key3, sizeof(ts.key3));
 
   //int32 emu;
-  //ssf_mpi_unpack(buffer, bufsiz, &pos, &emu, 1, MPI_INT, comm);
+  //ssf_unpack(buffer, bufsiz, &pos, &emu, sizeof(emu));
 
   int32 event_ident;
   int32 data_size;
   char* sbuf = 0;
-  ssf_mpi_unpack(buffer, bufsiz, &pos, &event_ident, 1, MPI_INT, comm);
-  ssf_mpi_unpack(buffer, bufsiz, &pos, &data_size, 1, MPI_INT, comm);
+  ssf_unpack(buffer, bufsiz, &pos, &event_ident, sizeof(event_ident));
+  ssf_unpack(buffer, bufsiz, &pos, &data_size, sizeof(data_size));
   if(data_size > 0) {
     //printf("unpacking ds=%d\n", data_size); fflush(0);
     sbuf = new char[data_size]; /*(char*)QuickObject::quick_new(data_size);*/ assert(sbuf);
-    ssf_mpi_unpack(buffer, bufsiz, &pos, sbuf, data_size, MPI_CHAR, comm);
+    ssf_unpack(buffer, bufsiz, &pos, sbuf, data_size);
   }
 
   Event* event = 0;
@@ -240,9 +265,52 @@ ChannelEvent* ChannelEvent::unpack(MPI_Comm comm, char* buffer, int& pos, int bu
     if(!event) SSF_THROW("unable to create event with id=" << event_ident);
   }
   if(sbuf) delete[] sbuf; /*QuickObject::quick_delete(sbuf);*/
-  return new ChannelEvent(ts, event, outportno);
+  return new ChannelEvent(ts, event, (int)outportno);
+}
+
+bool ChannelEvent::unpack_null(char* buffer, int& pos, int bufsiz,
+			       int& outportno, Timestamp& ts)
+{
+  int start = pos;
+  uint32 portno;
+  ssf_unpack(buffer, bufsiz, &pos, &portno, sizeof(portno));
+  if(!(portno&NULL_MESSAGE_FLAG)) { pos = start; return false; }
+  outportno = (int)(portno&~NULL_MESSAGE_FLAG);
+  ssf_unpack(buffer, bufsiz, &pos, &ts.key1, sizeof(ts.key1));
+  ssf_unpack(buffer, bufsiz, &pos, &ts.key2, sizeof(ts.key2));
+  ts.key3 = 0;
+  return true;
+}
+
+int ChannelEvent::skip(char* buffer, int& pos, int bufsiz,
+		       Timestamp& ts, bool& isnull)
+{
+  uint32 outportno;
+  ssf_unpack(buffer, bufsiz, &pos, &outportno, sizeof(outportno));
+
+  ssf_unpack(buffer, bufsiz, &pos, &ts.key1, sizeof(ts.key1));
+  ssf_unpack(buffer, bufsiz, &pos, &ts.key2, sizeof(ts.key2));
+  isnull = (outportno&NULL_MESSAGE_FLAG) != 0;
+  if(isnull) return (int)(outportno&~NULL_MESSAGE_FLAG);
+  ssf_unpack(buffer, bufsiz, &pos, &ts.key3, sizeof(ts.key3));
+
+  int32 event_ident;
+  int32 data_size;
+  ssf_unpack(buffer, bufsiz, &pos, &event_ident, sizeof(event_ident));
+  ssf_unpack(buffer, bufsiz, &pos, &data_size, sizeof(data_size));
+  // the event data is packed as chars, which take one byte each
+  if(data_size > 0) pos += data_size;
+  assert(pos <= bufsiz);
+  return (int)outportno;
+}
+
+ChannelBatchEvent::ChannelBatchEvent(char* d, int sz) :
+  ChainedEvent(Timestamp(0,0,0), 0), data(d), size(sz) {}
+
+void ChannelBatchEvent::process_event(Timeline* timeline)
+{
+  assert(0); // the batch is never inserted into the event list
 }
-#endif
 
 }; /*namespace minissf*/
 
@@ -24,6 +24,18 @@ public:
 
   // process the event dispatched by the given timeline
   virtual void process_event(Timeline* timeline) = 0;
+
+  // only channel events are saved in a checkpoint
+  virtual bool is_channel_event() { return false; }
+
+  // the event is created anew when the simulation restarts from a
+  // checkpoint (otherwise, it can't be pending at a checkpoint)
+  virtual bool is_recreated() { return false; }
+
+  // the event is reclaimed without being processed (when the
+  // simulation restarts from a checkpoint); the owner of the event
+  // must not refer to it any more
+  virtual void discard() {}
 }; /*class KernelEvent*/
 
 // this is the event for progress ticking
@@ -33,6 +45,7 @@ public:
   virtual ~TickEvent() {}
   virtual bool is_emulated() { return true; } // it's ok; on a non-emulated timeline, it's not paced
   virtual void process_event(Timeline* timeline);
+  virtual bool is_recreated() { return true; }
 }; /*class TickEvent*/
 
 // this is the event for timers
@@ -50,6 +63,9 @@ public:
   // process this event
   virtual void process_event(Timeline* timeline);
 
+  // the timer is no longer scheduled
+  virtual void discard();
+
 protected:
   Timer* timer;
 }; /*class TimerEvent*/
@@ -82,6 +98,9 @@ class ProcessEvent : public KernelEvent {
   // process the event
   virtual void process_event(Timeline* timeline);
 
+  // each process is started anew at restart
+  virtual bool is_recreated() { return true; }
+
 protected:
   Process* process;
 }; /*class ProcessEvent*/
@@ -105,14 +124,14 @@ protected:
 class ChainedEvent : public KernelEvent {
 protected:
   Event* event;
-  ChainedEvent* nextevt;
 
   ChainedEvent(Entity* ent, VirtualTime vt, Event* evt);
   ChainedEvent(Timestamp ts, Event* evt);
 
 public:
   virtual ~ChainedEvent();
-  virtual bool is_channel_event() { return false; }
+  virtual bool is_channel_batch() { return false; }
+  virtual bool is_null_message() { return false; }
 
   // return the ssf event carried by this kernel event
   inline Event* get_event() { return event; }
@@ -122,12 +141,16 @@ public:
   // in the binque as well; the difference is that in the mailboxes,
   // the events need to keep the FIFO order (so that it won't cause
   // synchronization issue); in the binque it doesn't matter as they
-  // are sorted using all the three keys
-  inline ChainedEvent*& get_next_event() { return nextevt; }
+  // are sorted using all the three keys; an event is never on a
+  // linked list and in a splay tree at the same time, so the link
+  // reuses the parent pointer of the splay tree node (instead of
+  // having a separate field)
+  inline ChainedEvent* get_next_event() { return (ChainedEvent*)parent; }
+  inline void set_next_event(ChainedEvent* e) { parent = e; }
 
   inline void append_to_list(ChainedEvent** head, ChainedEvent** tail) { 
-    nextevt = 0; // must reset to null
-    if(*head) { (*tail) = (*tail)->nextevt = this; }
+    parent = 0; // must reset to null
+    if(*head) { (*tail)->parent = this; (*tail) = this; }
     else { (*head) = (*tail) = this; }
   }
 };
@@ -192,13 +215,39 @@ public:
   // process the event
   virtual void process_event(Timeline* timeline);
 
-#ifdef HAVE_MPI_H
-  void pack(MPI_Comm comm, char* buffer, int& pos, int bufsiz);
-  static ChannelEvent* unpack(MPI_Comm comm, char* buffer, int& pos, int bufsiz);
-#endif
+  // access the inport or the outport number (whichever is set)
+  MapInport* get_inport() { assert(resolved); return inport; }
+  int get_outportno() { assert(!resolved); return outportno; }
+
+  // the inport replaces the outport number once it's resolved
+  void set_inport(MapInport* ip) { inport = ip; resolved = true; }
+
+  void pack(char* buffer, int& pos, int bufsiz);
+  static ChannelEvent* unpack(char* buffer, int& pos, int bufsiz);
+
+  // a null message is packed with only the header (the outport
+  // number, the time, and the target timeline id); if the next
+  // packed event is a null message, unpack the header and return
+  // true; otherwise, leave the position unchanged and return false
+  static bool unpack_null(char* buffer, int& pos, int bufsiz,
+			  int& outportno, Timestamp& ts);
+
+  // skip over a packed event without creating it; return the outport
+  // number, and set the timestamp and whether it's a null message
+  static int skip(char* buffer, int& pos, int bufsiz,
+		  Timestamp& ts, bool& isnull);
   
 protected:
-  MapInport* inport;
+  // an event to be delivered on this machine needs the inport; an
+  // event to (or just arrived from) a remote machine needs the
+  // outport number instead (until the inport is resolved upon
+  // arrival); they are never used at the same time, and the flag
+  // tells which one is in the union
+  union {
+    MapInport* inport;
+    int outportno;
+  };
+  bool resolved; // true if the inport is set
   Stargate* stargate; // this field is used by writer thread to infer
 		      // target machine when the event is to be sent
 		      // to another machine; and also used by the
@@ -206,12 +255,51 @@ protected:
 		      // infer the stargate it needs to update the
 		      // time; also used by switch board to record the
 		      // stargate for delivery the message
-  int outportno;
 
   friend class Stargate;
   friend class Universe;
 }; /*class ChannelEvent*/
 
+// a null message carries nothing but the channel time; instead of
+// sending a channel event each time, the stargate keeps one null
+// message for the target universe, which is overwritten in place
+// with the latest time if it's still sitting in the universe mailbox
+class NullMessage : public ChainedEvent {
+public:
+  NullMessage(Stargate* sg);
+  virtual ~NullMessage() {}
+
+  virtual bool is_null_message() { return true; }
+  virtual bool is_emulated() { return false; }
+  virtual void process_event(Timeline* timeline); // never called
+
+protected:
+  Stargate* stargate; // the stargate owning this null message
+  bool posted; // true if it's in the universe mailbox (protected by the mailbox mutex)
+
+  friend class Stargate;
+  friend class Universe;
+}; /*class NullMessage*/
+
+// a batch of packed channel events from a remote machine destined to
+// the timelines of one universe; the reader thread only splits the
+// received batch and the universe unpacks the events itself
+class ChannelBatchEvent : public ChainedEvent {
+public:
+  ChannelBatchEvent(char* data, int size);
+  virtual ~ChannelBatchEvent() { delete[] data; }
+
+  virtual bool is_channel_batch() { return true; }
+  virtual bool is_emulated() { return false; }
+  virtual void process_event(Timeline* timeline); // never called
+
+protected:
+  char* data; // the packed events
+  int size; // the size of the packed events
+
+  friend class Universe;
+}; /*class ChannelBatchEvent*/
+
 }; /*namespace minissf*/
 
 #endif /*__MINISSF_KERNEL_EVENT_H__*/
@@ -215,6 +215,11 @@ int ssf_processor_range(int& startidx, int& endidx) {
   return np+ssf_processor_index();
 }
 
+bool ssf_model_restored() {
+  if(Universe::is_uninitialized()) SSF_THROW("ssf has not been initialized");
+  return !Universe::args_load_model.empty();
+}
+
 }; /*namespace minissf*/
 
 /*
@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 #include <sched.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -108,6 +110,18 @@ int64 ssf_wallclock_in_nanoseconds() {
 #error "ERROR: missing timing support!"
 #endif
 
+// the resident set size is only available on systems with procfs
+int64 ssf_resident_memory_in_bytes()
+{
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if(!fp) return 0;
+  long vsz, rss;
+  int n = fscanf(fp, "%ld %ld", &vsz, &rss);
+  fclose(fp);
+  if(n != 2) return 0;
+  return (int64)rss*sysconf(_SC_PAGESIZE);
+}
+
 static int ssf_thread_barrier_counter = 0;
 static pthread_mutex_t ssf_thread_barrier_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t ssf_thread_barrier_release = PTHREAD_COND_INITIALIZER;
@@ -461,6 +475,20 @@ double ssf_sum_reduction(double myval)
   return sum;
 }
 
+void ssf_pack(void* inbuf, int insize, void* outbuf, int outsize, int* position)
+{
+  if(*position + insize > outsize) SSF_THROW("packing buffer overflow");
+  memcpy((char*)outbuf+*position, inbuf, insize);
+  *position += insize;
+}
+
+void ssf_unpack(void* inbuf, int insize, int* position, void* outbuf, int outsize)
+{
+  if(*position + outsize > insize) SSF_THROW("unpacking buffer overflow");
+  memcpy(outbuf, (char*)inbuf+*position, outsize);
+  *position += outsize;
+}
+
 #ifdef HAVE_MPI_H
 //#define DEBUG_SSF_MPI
 
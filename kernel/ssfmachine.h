@@ -27,6 +27,7 @@ extern void ssf_join_children();
 extern void ssf_thread_create(ssf_thread_t* tid, void (*child)(void*), void* data);
 extern void ssf_thread_yield();
 extern int64 ssf_wallclock_in_nanoseconds();
+extern int64 ssf_resident_memory_in_bytes(); // zero if unknown
 
 inline void ssf_thread_join(ssf_thread_t* tid)
   { pthread_join(*tid, 0); }
@@ -90,6 +91,12 @@ extern unsigned long long ssf_sum_reduction(unsigned long long myval);
 extern float ssf_sum_reduction(float  myval);
 extern double ssf_sum_reduction(double myval);
 
+// pack (and unpack) the given number of bytes to (and from) the
+// buffer at the position, which is advanced; the data is copied as
+// is, since we assume homogeneous machines
+extern void ssf_pack(void* inbuf, int insize, void* outbuf, int outsize, int* position);
+extern void ssf_unpack(void* inbuf, int insize, int* position, void* outbuf, int outsize);
+
 #ifdef HAVE_MPI_H
 extern void ssf_mpi_init_thread(int* argc, char*** argv, int required, int* provided);
 extern void ssf_mpi_finalize();
@@ -5,7 +5,7 @@
 namespace minissf {
 
 MapOutport::MapOutport(Stargate* sg, MapInport* ip, VirtualTime md) : 
-  stargate(sg), inport(ip), min_offset(md) {}
+  stargate(sg), inport(ip), min_offset(md), colocated(0), carried(false), next(0) {}
 
 MapOutport::~MapOutport() {
   // we reclaim the inport if we can (i.e., if on the same machine)
@@ -23,28 +23,31 @@ MapInport::~MapInport() {
 Stargate::Stargate(Timeline* lp1, Timeline* lp2) :
   source_timeline(lp1), target_timeline(lp2), 
   source_timeline_id(lp1->serialno), target_timeline_id(lp2->serialno),
-  outportno(0), in_sync(true), min_delay(0), time(0), mailbox(0), mailbox_tail(0)
+  outportno(0), in_sync(true), min_delay(0), time(0), mailbox(0), mailbox_tail(0), null_message(0)
 { constructor(); }
 
 // this is the constructor from a local timeline to a remote timeline
 Stargate::Stargate(Timeline* lp1, int lp2id, int port) :
   source_timeline(lp1), target_timeline(0), 
   source_timeline_id(lp1->serialno), target_timeline_id(lp2id),
-  outportno(port), in_sync(true), min_delay(0), time(0), mailbox(0), mailbox_tail(0)
+  outportno(port), in_sync(true), min_delay(0), time(0), mailbox(0), mailbox_tail(0), null_message(0)
 { constructor(); }
 
 // this is the constructor from a remote timeline to a local timeline
 Stargate::Stargate(int lp1id, int port, Timeline* lp2) :
   source_timeline(0), target_timeline(lp2), 
   source_timeline_id(lp1id), target_timeline_id(lp2->serialno),
-  outportno(port), in_sync(true), min_delay(0), time(0), mailbox(0), mailbox_tail(0)
+  outportno(port), in_sync(true), min_delay(0), time(0), mailbox(0), mailbox_tail(0), null_message(0)
 { constructor(); }
 
 // do the common work for all the constructors above
 void Stargate::constructor()
 {
+  stats_messages = 0;
   if(source_timeline) source_timeline->add_outbound_stargate(this);
-  if(target_timeline) target_timeline->add_inbound_stargate(this);
+  // if the channels are wired up in parallel, the target timeline
+  // (which may belong to another universe) is told afterwards
+  if(target_timeline && !Universe::init_concurrent) target_timeline->add_inbound_stargate(this);
   ssf_thread_mutex_init(&mailbox_mutex);
   Universe::register_stargate(this); // so that we can reclaim them in the end
 }
@@ -58,6 +61,7 @@ Stargate::~Stargate()
     delete evt;
   }
   mailbox_tail = 0;
+  if(null_message) delete null_message;
 }
 
 void Stargate::set_delay(VirtualTime t)
@@ -69,6 +73,12 @@ void Stargate::set_delay(VirtualTime t)
   if(min_delay == 0 || t < min_delay) min_delay = t;
 }
 
+inline void Stargate::trace_message(int type, VirtualTime t)
+{
+  TraceBuffer* tracer = source_timeline->universe->tracer;
+  if(tracer) tracer->instant(type, target_timeline_id, t.get_ticks(), source_timeline_id);
+}
+
 void Stargate::set_time(VirtualTime t, bool called_by_sender)
 {
   if(called_by_sender) { // called by the one originating the null message
@@ -82,10 +92,14 @@ void Stargate::set_time(VirtualTime t, bool called_by_sender)
     time = t+min_delay;
     assert(beforetime < time);
 
-    if(!target_timeline) { // if it's going to remote machine, we deliver a null message via mpi
-#ifdef HAVE_MPI_H
+    if(!target_timeline) { // if it's going to remote machine, we deliver a null message via the transport
       source_timeline->record_stats_remote_null_messages();
-      ChannelEvent* evt = new ChannelEvent(Timestamp(time,0,0), 0, outportno); // null message
+      trace_message(TRACE_REMOTE_NULL, time);
+      // the outport may be mapped to several timelines on the remote
+      // machine; the null message carries the target timeline id
+      // (as the second key of the timestamp) so that only the
+      // corresponding stargate is updated
+      ChannelEvent* evt = new ChannelEvent(Timestamp(time,target_timeline_id,0), 0, outportno); // null message
       evt->stargate = this;
       if((Universe::args_debug_mask&Universe::DEBUG_FLAG_LPSCHED) != 0) {
 	printf(">> [%d:%d] stargate [%d->%d]: set_time(t=%lg, true): remote null message, time=%lg->%lg\n",
@@ -93,15 +107,13 @@ void Stargate::set_time(VirtualTime t, bool called_by_sender)
 	       source_timeline_id, target_timeline_id, t.second(), beforetime.second(), time.second());
       }
       source_timeline->universe->transport_message(evt);
-#else
-      assert(0);
-#endif
     } else { // if this is local machine delivery
       if(source_timeline->universe == target_timeline->universe) {
 	// if both timelines reside on the same processor: if the
 	// target timeline is blocked on lbts to advance and if we
 	// can, we change the timeline into runnable
 	source_timeline->record_stats_local_null_messages();
+	trace_message(TRACE_LOCAL_NULL, time);
 	if((Universe::args_debug_mask&Universe::DEBUG_FLAG_LPSCHED) != 0) {
 	  printf(">> [%d:%d] stargate [%d->%d]: set_time(t=%lg, true): local null message, time=%lg->%lg\n",
 		 source_timeline->universe->args_rank, source_timeline->universe->processor_id,
@@ -117,19 +129,13 @@ void Stargate::set_time(VirtualTime t, bool called_by_sender)
 	// if the source and target timelines reside on different
 	// processors: we send a null message to that universe
 	source_timeline->record_stats_shmem_null_messages();
+	trace_message(TRACE_SHMEM_NULL, time);
 	if((Universe::args_debug_mask&Universe::DEBUG_FLAG_LPSCHED) != 0) {
 	  printf(">> [%d:%d] stargate [%d->%d]: set_time(t=%lg, true): shmem null message, time=%lg->%lg\n",
 		 source_timeline->universe->args_rank, source_timeline->universe->processor_id,
 		 source_timeline_id, target_timeline_id, t.second(), beforetime.second(), time.second());
 	}
-	ChannelEvent* evt = new ChannelEvent(Timestamp(time,0,0), 0, outportno); // null message
-	evt->stargate = this;
-	ssf_thread_mutex_lock(&target_timeline->universe->mailbox_mutex);
-	if(!target_timeline->universe->mailbox) 
-	  ssf_thread_cond_signal(&target_timeline->universe->mailbox_cond);
-	evt->append_to_list(&target_timeline->universe->mailbox, 
-			    &target_timeline->universe->mailbox_tail);
-	ssf_thread_mutex_unlock(&target_timeline->universe->mailbox_mutex);
+	post_null_message(time);
       }
     }
   } else { // called by the processor receiving the null message
@@ -162,6 +168,34 @@ void Stargate::set_time(VirtualTime t, bool called_by_sender)
   }
 }
 
+void Stargate::post_null_message(VirtualTime t)
+{
+  assert(target_timeline);
+  Universe* univ = target_timeline->universe;
+  ssf_thread_mutex_lock(&univ->mailbox_mutex);
+  if(!null_message) { null_message = new NullMessage(this); assert(null_message); }
+  if((VirtualTime)null_message->time() < t) null_message->setTime(Timestamp(t,0,0));
+  // if the null message is still in the mailbox, the universe will
+  // get the latest time when it's retrieved
+  if(!null_message->posted) {
+    null_message->posted = true;
+    if(!univ->mailbox) ssf_thread_cond_signal(&univ->mailbox_cond);
+    null_message->append_to_list(&univ->mailbox, &univ->mailbox_tail);
+  }
+  ssf_thread_mutex_unlock(&univ->mailbox_mutex);
+}
+
+void Stargate::receive_null_message()
+{
+  assert(target_timeline && null_message);
+  Universe* univ = target_timeline->universe;
+  ssf_thread_mutex_lock(&univ->mailbox_mutex);
+  VirtualTime t = null_message->time();
+  null_message->posted = false;
+  ssf_thread_mutex_unlock(&univ->mailbox_mutex);
+  set_time(t, false);
+}
+
 void Stargate::send_message(ChannelEvent* evt)
 {
   // this function is called when the target timeline is either in a
@@ -171,6 +205,7 @@ void Stargate::send_message(ChannelEvent* evt)
   // this is to syphon off the events that traverse the synchronous stargate!
   if(in_sync && source_timeline) {
     assert(evt);
+    trace_message(TRACE_SYNC_EVENT, evt->time());
     if(target_timeline) { // on the same machine
       assert(source_timeline->universe->local_binque);
       evt->stargate = this;
@@ -186,9 +221,9 @@ void Stargate::send_message(ChannelEvent* evt)
   }
 
   if(!target_timeline) { // remote machine delivery via message passing
-    assert(source_timeline && !evt->inport);
-#ifdef HAVE_MPI_H
+    assert(source_timeline);
     source_timeline->record_stats_remote_messages();
+    trace_message(TRACE_REMOTE_EVENT, evt->time());
     if((Universe::args_debug_mask&Universe::DEBUG_FLAG_LPSCHED) != 0) {
       printf(">> [%d:%d] stargate [%d->%d]: send_message(event @ %lg): remote message\n",
 	     source_timeline->universe->args_rank, source_timeline->universe->processor_id,
@@ -196,14 +231,14 @@ void Stargate::send_message(ChannelEvent* evt)
     }
     evt->stargate = this;
     source_timeline->universe->transport_message(evt);
-#else
-    assert(0);
-#endif
   } else { // local machine delivery (between different processors) via shared memory
     assert(!source_timeline || // this is possible when called by the reader thread
 	   source_timeline->universe != target_timeline->universe);
-    assert(evt->inport);
-    if(source_timeline) source_timeline->record_stats_shmem_messages();
+    assert(evt->get_inport());
+    if(source_timeline) {
+      source_timeline->record_stats_shmem_messages();
+      trace_message(TRACE_SHMEM_EVENT, evt->time());
+    }
     if((Universe::args_debug_mask&Universe::DEBUG_FLAG_LPSCHED) != 0) {
       if(source_timeline) {
 	printf(">> [%d:%d] stargate [%d->%d]: send_message(event @ %lg): shmem message\n",
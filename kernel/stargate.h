@@ -6,6 +6,7 @@
 #include "ssfapi/ssf_common.h"
 #include "kernel/ssfmachine.h"
 #include "kernel/kernel_event.h"
+#include "ssfapi/quick_memory.h"
 
 namespace minissf {
 
@@ -16,8 +17,8 @@ class Stargate;
 // CHEAT SHEET:
 // * The mapping structure is arranged as follows:
 //   1) oc has a unique identifier (called outport number)
-//   2) oc maintains a list of outports, DEQUE(MapOutport*), one for each target timeline 
-//      (including itself if wired so)
+//   2) oc maintains a linked list of outports, MapOutport (chained by next), one for 
+//      each target timeline (including itself if wired so)
 //   3) oc->outports[timeline] points MapOutport, which has:
 //      a) a pointer to stargate (if the source and target timelines are not the same); 
 //         the stargate is used for timeline (or LP) scheduling purposes
@@ -37,6 +38,13 @@ class Stargate;
 //      previous node)
 //  oc->outports[timeline]->stargate->min_delay is the min delay for all mapping from 
 //    the source timeline to the target timeline
+//
+// * An event written to an outchannel is sent only once to each remote
+//   machine, even if there are several target timelines on that machine:
+//   the first outport to the machine (with the smallest min_offset)
+//   carries the event, and the receiving machine fans it out using
+//   Universe::starmap[outportno], which has a MapStarport for each
+//   target timeline with the offset from the smallest min_offset
 
 // this data structure represents a mapping originating from an
 // outchannel at the sending timeline; there are as many outports as
@@ -46,8 +54,15 @@ class MapOutport {
   Stargate* stargate; // if not null, this is the stargate between the timelines
   MapInport* inport; // points to the inport if the target timeline is on the same machine
   VirtualTime min_offset; // minimum channel delay plus map delay
+  MapOutport* colocated; // next outport to the same remote machine (only set for the one carrying the events)
+  bool carried; // if true, events are carried by another outport to the same remote machine
+  MapOutport* next; // next outport of the same outchannel (in the order of creation)
   MapOutport(Stargate* sg, MapInport* ip, VirtualTime md);
   ~MapOutport();
+
+  // mappings are created only at initialization and kept till the end
+  static void* operator new(size_t sz) { return ssf_arena_malloc(sz); }
+  static void operator delete(void* p) {}
 }; /*class MapOutport*/
 
 // this data structure represents the ending of a map to one or more
@@ -59,8 +74,24 @@ class MapInport {
   MapInport* next; // next mapped inchannel in the linked list
   MapInport(inChannel* ic);
   ~MapInport();
+
+  // mappings are created only at initialization and kept till the end
+  static void* operator new(size_t sz) { return ssf_arena_malloc(sz); }
+  static void operator delete(void* p) {}
 }; /*class MapInport*/
 
+// this data structure represents the receiving end of an outport
+// from a remote machine; there is one for each target timeline on
+// this machine
+class MapStarport {
+ public:
+  MapInport* inport; // the inports at the target timeline
+  Stargate* stargate; // the stargate from the remote source timeline
+  VirtualTime offset; // delay in addition to the time of the event sent to this machine
+  MapStarport(MapInport* ip, Stargate* sg, VirtualTime off) :
+    inport(ip), stargate(sg), offset(off) {}
+}; /*class MapStarport*/
+
 // this is a directed edge in the LP graph
 class Stargate {
  public:
@@ -97,6 +128,18 @@ class Stargate {
   void send_message(ChannelEvent* evt);
   void receive_messages();
 
+  // a null message to a timeline on a different processor (from the
+  // source timeline on this machine, or from the reader thread when
+  // it's from a remote machine) is posted to the target universe
+  // using the null message kept by the stargate; the target universe
+  // calls receive_null_message() when it retrieves it
+  void post_null_message(VirtualTime t);
+  void receive_null_message();
+
+  // count the events written through this stargate by the source
+  // timeline on the same machine (saved in the alignment profile)
+  inline void record_stats_messages() { stats_messages++; }
+
  protected:
   Timeline* source_timeline; // null if not in this address space
   Timeline* target_timeline; // null if not in this address space
@@ -109,9 +152,15 @@ class Stargate {
   ssf_thread_mutex_t mailbox_mutex; // protect simultaneous access to the mailbox
   ChainedEvent* mailbox; // a linked list of channel events sent from source to target timeline
   ChainedEvent* mailbox_tail; // points to the end of the linked list for appending new events
+  NullMessage* null_message; // the null message to the target universe (created on demand)
+  unsigned long stats_messages; // number of events sent from the source timeline on this machine
 
   void constructor(); // do the common work for all constructors
 
+  // record a null message or an event sent through this stargate in
+  // the trace of the source universe (if the window is traced)
+  void trace_message(int type, VirtualTime t);
+
   friend class outChannel;
   friend class Timeline;
   friend class Universe;
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h> // for abort
+#include <algorithm>
 #include "kernel/timeline.h"
 #include "ssfapi/entity.h"
 #include "ssfapi/process.h"
@@ -32,12 +33,9 @@ Timeline::~Timeline()
 {
   assert(state == STATE_DONE || state == STATE_START);
   while(!entities.empty()) {
-    SET(Entity*)::iterator iter = entities.begin();
-    assert(iter != entities.end());
-    assert((*iter)->timeline == this);
-    delete (*iter);
+    assert(entities.back()->timeline == this);
+    delete entities.back();
   }
-  entities.clear();
   assert(active_processes.empty());
   evtlist.clear(); //simlist.clear(); emulist.clear(); // remaining events will be reclaimed here
   inbound.clear(); outbound.clear(); // stargates will be reclaimed by universe
@@ -49,7 +47,7 @@ bool Timeline::is_emulated()
   if(!emulated_set) {
     emulated_set = true;
     emulated = false; responsiveness = VirtualTime::INFINITY;
-    for(SET(Entity*)::iterator iter = entities.begin();
+    for(VECTOR(Entity*)::iterator iter = entities.begin();
 	iter != entities.end(); iter++) {
       if((*iter)->isEmulated()) {
 	emulated = true;
@@ -65,7 +63,7 @@ void Timeline::add_entity(Entity* entity)
 {
   assert(entity && !entity->timeline);
   entity->timeline = this;
-  entities.insert(entity);
+  entities.push_back(entity);
   emulated_set = false; // make sure its emulate-ability is recounted
 }
 
@@ -73,34 +71,35 @@ void Timeline::delete_entity(Entity* entity)
 {
   assert(entity && entity->timeline == this);
   entity->timeline = 0;
-  entities.erase(entity);
+  if(entities.back() == entity) entities.pop_back(); // most likely
+  else {
+    VECTOR(Entity*)::iterator iter = 
+      std::find(entities.begin(), entities.end(), entity);
+    assert(iter != entities.end());
+    entities.erase(iter);
+  }
 }
 
 void Timeline::merge_timeline(Timeline* timeline)
 {
   assert(timeline);
   if(this == timeline) return;
-  /*
-  for(SET(Entity*)::iterator iter = timeline->entities.begin();
+  // move all entities over at once (rather than one at a time)
+  for(VECTOR(Entity*)::iterator iter = timeline->entities.begin();
       iter != timeline->entities.end(); iter++) {
-    Entity* entity = *iter; 
-    timeline->delete_entity(entity);
-    add_entity(entity);
-  }
-  */
-  while(!timeline->entities.empty()) {
-    SET(Entity*)::iterator iter = timeline->entities.begin();
-    Entity* entity = *iter; 
-    timeline->delete_entity(entity);
-    add_entity(entity);
+    assert((*iter)->timeline == timeline);
+    (*iter)->timeline = this;
   }
+  entities.insert(entities.end(), timeline->entities.begin(), timeline->entities.end());
+  timeline->entities.clear();
+  emulated_set = false; // make sure its emulate-ability is recounted
   Universe::delete_timeline(timeline);
 }
 
 int Timeline::settle_serialno(int tmlnid, int startentid)
 {
   serialno = tmlnid;
-  for(SET(Entity*)::iterator iter = entities.begin();
+  for(VECTOR(Entity*)::iterator iter = entities.begin();
       iter != entities.end(); iter++) {
     (*iter)->serialno = startentid++;
   }
@@ -110,7 +109,7 @@ int Timeline::settle_serialno(int tmlnid, int startentid)
 int Timeline::get_portno_space() const
 {
   int id = 0;
-  for(SET(Entity*)::iterator iter = entities.begin();
+  for(VECTOR(Entity*)::const_iterator iter = entities.begin();
       iter != entities.end(); iter++) {
     id += (*iter)->outchannels.size();
   }
@@ -119,10 +118,10 @@ int Timeline::get_portno_space() const
 
 int Timeline::settle_portno(int id)
 {
-  for(SET(Entity*)::iterator iter = entities.begin();
+  for(VECTOR(Entity*)::iterator iter = entities.begin();
       iter != entities.end(); iter++) {
     Entity* ent = *iter;
-    for(SET(outChannel*)::iterator citer = ent->outchannels.begin();
+    for(VECTOR(outChannel*)::iterator citer = ent->outchannels.begin();
 	citer != ent->outchannels.end(); citer++)
       (*citer)->portno = id++;
   }
@@ -24,7 +24,7 @@ class Timeline : public TimelineQueueNode {
   void add_entity(Entity* entity);
   void delete_entity(Entity* entity);
   void merge_timeline(Timeline* timeline);
-  inline const SET(Entity*)& get_entities() const { return entities; }
+  inline const VECTOR(Entity*)& get_entities() const { return entities; }
 
   // all entities and timelines must be uniquely identified; the
   // timelines are uniquely identified because they are used to
@@ -109,7 +109,7 @@ class Timeline : public TimelineQueueNode {
   KernelEventList evtlist; // eventlist containing all future events (simulated and emulated)
   //KernelEventList simlist; // eventlist containing all future simulation events
   //KernelEventList emulist; // eventlist containing all future emulation events
-  SET(Entity*) entities; // list of entities defined in this timeline
+  VECTOR(Entity*) entities; // list of entities defined in this timeline (in order of alignment)
   DEQUE(Process*) active_processes; // list of processes ready to run
   VECTOR(Stargate*) inbound; // incoming portals to receive events from other timelines
   VECTOR(Stargate*) outbound; // /outgoing portals to send events to other timelines
@@ -136,6 +136,7 @@ class Timeline : public TimelineQueueNode {
   friend class Stargate;
   friend class TickEvent;
   friend class EmulatedTimerEvent;
+  friend class Coroutine;
 }; /*class Timeline*/
 
 }; /*namespace minissf*/
@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <string.h>
+#include "kernel/trace.h"
+#include "ssf.h"
+
+namespace minissf {
+
+FILE* TraceBuffer::fptr = 0;
+STRING TraceBuffer::fname;
+ssf_thread_mutex_t TraceBuffer::fmutex;
+
+TraceBuffer::TraceBuffer(int trk) : track(trk), nrecs(0)
+{
+  records = new TraceRecord[TRACE_BLOCK_SIZE]; assert(records);
+}
+
+TraceBuffer::~TraceBuffer()
+{
+  write_block();
+  delete[] records;
+}
+
+void TraceBuffer::open_file(const STRING& fn, int nmachs, int rank, int nprocs, int64 start)
+{
+  assert(!fptr);
+  fname = fn;
+  fptr = fopen(fname.c_str(), "w");
+  if(!fptr) SSF_THROW("can't open trace: " << fname);
+  ssf_thread_mutex_init(&fmutex);
+
+  // the header has the clock ticks per second (to convert the
+  // simulation time) and the wall-clock time at the start (to line
+  // up the trace files of different machines); the records are in
+  // the native byte order, which is checked with the version
+  int hdr[4] = { TRACE_VERSION, nmachs, rank, nprocs };
+  double tps = VirtualTime::SECOND;
+  if(fwrite(TRACE_MAGIC, 1, 8, fptr) != 8 || fwrite(hdr, sizeof(int), 4, fptr) != 4 ||
+     fwrite(&tps, sizeof(double), 1, fptr) != 1 || fwrite(&start, sizeof(int64), 1, fptr) != 1)
+    SSF_THROW("can't write trace: " << fname);
+}
+
+void TraceBuffer::close_file()
+{
+  assert(fptr);
+  if(fclose(fptr)) SSF_THROW("can't write trace: " << fname);
+  fptr = 0;
+}
+
+void TraceBuffer::write_block()
+{
+  if(!nrecs) return;
+  assert(fptr);
+  int hdr[2] = { track, nrecs };
+  ssf_thread_mutex_lock(&fmutex);
+  bool ok = fwrite(hdr, sizeof(int), 2, fptr) == 2 &&
+    fwrite(records, sizeof(TraceRecord), nrecs, fptr) == (size_t)nrecs;
+  ssf_thread_mutex_unlock(&fmutex);
+  if(!ok) SSF_THROW("can't write trace: " << fname);
+  nrecs = 0;
+}
+
+void TraceBuffer::flush()
+{
+  // the time spent writing the block shows up in the trace, as it
+  // may disturb the rest
+  int64 start = ssf_wallclock_in_nanoseconds();
+  write_block();
+  put(TRACE_FLUSH, track, 0, TRACE_BLOCK_SIZE, start, ssf_wallclock_in_nanoseconds()-start);
+}
+
+}; /*namespace minissf*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
@@ -0,0 +1,130 @@
+// the trace buffer keeps binary records of the scheduling activities
+// of a universe (or the transport threads on a machine). Only the
+// thread owning the buffer puts records in it, so there's no locking;
+// when the buffer is full, the records are appended as a block to the
+// trace file of the machine, which is shared by all buffers on the
+// machine (with a lock). The trace files can be converted to the
+// chrome trace format (json) using bin/trace2json.pl.
+
+#ifndef __MINISSF_TRACE_H__
+#define __MINISSF_TRACE_H__
+
+#include <stdio.h>
+#include "ssfapi/ssf_common.h"
+#include "kernel/ssfmachine.h"
+
+namespace minissf {
+
+#define TRACE_MAGIC "MSSFTRAC"
+#define TRACE_VERSION 1
+#define TRACE_BLOCK_SIZE 16384 // number of records in a block
+
+// the types of trace records (the meaning of the fields is given for
+// each type; the wall-clock time is in nanoseconds, the simulation
+// time in clock ticks)
+enum {
+  TRACE_RUN          = 0,  // a timeline runs (id=timeline, simtime=simclock, arg=number of events processed)
+  TRACE_BLOCK        = 1,  // the universe waits for lbts to advance (id=number of blocked timelines, simtime=synpoint)
+  TRACE_PACE         = 2,  // a timeline is paced (id=timeline, simtime=simclock, arg=time to wait until)
+  TRACE_BARRIER      = 3,  // the universe is at a synchronization point (simtime=synpoint, arg=end of the next window)
+  TRACE_LOCAL_NULL   = 4,  // null message to the same processor (id=target timeline, simtime=channel time, arg=source timeline)
+  TRACE_SHMEM_NULL   = 5,  // null message to another processor (same as above)
+  TRACE_REMOTE_NULL  = 6,  // null message to another machine (same as above)
+  TRACE_SYNC_EVENT   = 7,  // event held for a later window (id=target timeline, simtime=event time, arg=source timeline)
+  TRACE_SHMEM_EVENT  = 8,  // event to another processor (same as above)
+  TRACE_REMOTE_EVENT = 9,  // event to another machine (same as above)
+  TRACE_MPI_SEND     = 10, // a batch is sent (id=machine, arg=bytes)
+  TRACE_MPI_RECV     = 11, // a batch is received and unpacked (id=machine, arg=bytes)
+  TRACE_FLUSH        = 12, // a block of records is written to the trace file
+  TRACE_TOTAL        = 13
+};
+
+// a trace record is either a slice (with duration) or an instant
+struct TraceRecord {
+  int64 wall; // wall-clock time at the start
+  int64 dur; // wall-clock duration (0 for instants)
+  int64 simtime;
+  int64 arg;
+  int type;
+  int id;
+};
+
+class TraceBuffer {
+ public:
+  // the track tells whose records they are: the processor id of the
+  // universe, or args_nprocs (and plus one) for the mpi sender (and
+  // receiver) of the machine
+  TraceBuffer(int track);
+
+  // the remaining records are written out
+  ~TraceBuffer();
+
+  // record an instant (happening now)
+  inline void instant(int type, int id, int64 simtime, int64 arg) {
+    put(type, id, simtime, arg, ssf_wallclock_in_nanoseconds(), 0);
+  }
+
+  // record a slice (from the given start time until now)
+  inline void slice(int type, int id, int64 simtime, int64 arg, int64 start) {
+    put(type, id, simtime, arg, start, ssf_wallclock_in_nanoseconds()-start);
+  }
+
+  // the trace file is opened and closed by processor 0 (before the
+  // buffers are created and after they are deleted)
+  static void open_file(const STRING& fname, int nmachs, int rank, int nprocs, int64 start);
+  static void close_file();
+
+ private:
+  int track;
+  int nrecs; // number of records in the buffer
+  TraceRecord* records;
+
+  inline void put(int type, int id, int64 simtime, int64 arg, int64 wall, int64 dur) {
+    TraceRecord* rec = &records[nrecs];
+    rec->wall = wall; rec->dur = dur;
+    rec->simtime = simtime; rec->arg = arg;
+    rec->type = type; rec->id = id;
+    if(++nrecs == TRACE_BLOCK_SIZE) flush();
+  }
+
+  // write the records to the trace file as a block
+  void write_block();
+
+  // write the full buffer and note the time spent doing so
+  void flush();
+
+  static FILE* fptr;
+  static STRING fname;
+  static ssf_thread_mutex_t fmutex;
+}; /*TraceBuffer*/
+
+}; // namespace minissf
+
+#endif /*__MINISSF_TRACE_H__*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
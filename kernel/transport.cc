@@ -0,0 +1,210 @@
+#include <assert.h>
+#include <string.h>
+#include "kernel/transport.h"
+#include "kernel/universe.h"
+
+#ifdef HAVE_MPI_H
+/* The size of the buffer attached for mpi buffered send. */
+#define MPIBUF_ATTACHED (64*1024*1024)
+
+/* This is the mpi tag used to send and receive events. IMPORTANT: THE
+   USER WHO ALSO USES MPI FOR COMMUNICATION MUST NOT USE THIS TAG. */
+#define CHANNEL_EVENT_TAG 100
+#endif
+
+namespace minissf {
+
+Transport* Transport::create(int type)
+{
+  switch(type) {
+#ifdef HAVE_MPI_H
+  case TRANSPORT_MPI: return new MPITransport();
+#endif
+#ifdef SSF_TRANSPORT_TCP
+  case TRANSPORT_TCP: return new TCPTransport();
+#endif
+#ifdef SSF_TRANSPORT_SHM
+#ifdef HAVE_MPI_H
+  case TRANSPORT_SHM: return new ShmTransport(new MPITransport());
+#else
+  case TRANSPORT_SHM: return new ShmTransport(new TCPTransport());
+#endif
+#endif
+  default: SSF_THROW("transport not supported on this platform: " << type);
+  }
+  return 0;
+}
+
+void Transport::allgatherv(void* sendbuf, int size, void* recvbuf, int* recvcnts, int* displs)
+{
+  // the same block is sent to every machine
+  int nmachs = Universe::args_nmachs;
+  int* sendcnts = new int[2*nmachs]; assert(sendcnts);
+  int* sdispls = &sendcnts[nmachs];
+  for(int i=0; i<nmachs; i++) { sendcnts[i] = size; sdispls[i] = 0; }
+  alltoallv(sendbuf, sendcnts, sdispls, recvbuf, recvcnts, displs);
+  delete[] sendcnts;
+}
+
+void Transport::alltoall(void* sendbuf, int size, void* recvbuf)
+{
+  int nmachs = Universe::args_nmachs;
+  int* cnts = new int[2*nmachs]; assert(cnts);
+  int* displs = &cnts[nmachs];
+  for(int i=0; i<nmachs; i++) { cnts[i] = size; displs[i] = i*size; }
+  alltoallv(sendbuf, cnts, displs, recvbuf, cnts, displs);
+  delete[] cnts;
+}
+
+template<typename T> void Transport::allreduce(T* sendbuf, T* recvbuf, int count, int op)
+{
+  // the values are gathered from all machines and reduced locally;
+  // it's only used for a handful of values at a time
+  int nmachs = Universe::args_nmachs;
+  T* all = new T[nmachs*count]; assert(all);
+  allgather(sendbuf, count*sizeof(T), all);
+  for(int k=0; k<count; k++) {
+    T x = all[k];
+    for(int i=1; i<nmachs; i++) {
+      T y = all[i*count+k];
+      switch(op) {
+      case REDUCE_SUM: x += y; break;
+      case REDUCE_MIN: if(y < x) x = y; break;
+      case REDUCE_MAX: if(y > x) x = y; break;
+      default: SSF_THROW("unknown reduction operator: " << op);
+      }
+    }
+    recvbuf[k] = x;
+  }
+  delete[] all;
+}
+
+template void Transport::allreduce<int>(int*, int*, int, int);
+template void Transport::allreduce<int64>(int64*, int64*, int, int);
+template void Transport::allreduce<unsigned long>(unsigned long*, unsigned long*, int, int);
+template void Transport::allreduce<double>(double*, double*, int, int);
+
+#ifdef HAVE_MPI_H
+MPITransport::MPITransport()
+{
+  attachbuf = new char[MPIBUF_ATTACHED]; assert(attachbuf);
+  ssf_mpi_buffer_attach(attachbuf, MPIBUF_ATTACHED);
+
+  rscnt = new int[Universe::args_nmachs]; assert(rscnt);
+  for(int i=0; i<Universe::args_nmachs; i++) rscnt[i] = 1;
+}
+
+MPITransport::~MPITransport()
+{
+  int attachsiz; char* buf;
+  ssf_mpi_buffer_detach(&buf, &attachsiz);
+  assert(attachsiz==MPIBUF_ATTACHED && buf==attachbuf);
+  delete[] attachbuf;
+  delete[] rscnt;
+}
+
+bool MPITransport::is_concurrent() const
+{
+  return Universe::mpi_thread_support == MPI_THREAD_MULTIPLE;
+}
+
+void MPITransport::send_batch(int rank, char* buf, int size)
+{
+  ssf_mpi_bsend(buf, size, MPI_PACKED, rank, CHANNEL_EVENT_TAG, MPI_COMM_WORLD);
+}
+
+int MPITransport::recv_batch(char* buf, int bufsiz, int* source)
+{
+  MPI_Status status;
+  ssf_mpi_recv(buf, bufsiz, MPI_PACKED, MPI_ANY_SOURCE,
+	       CHANNEL_EVENT_TAG, MPI_COMM_WORLD, &status);
+  int size;
+  ssf_mpi_get_count(&status, MPI_PACKED, &size);
+  *source = status.MPI_SOURCE;
+  return size;
+}
+
+int MPITransport::poll_batch(char* buf, int bufsiz, int* source)
+{
+  int flag;
+  MPI_Status status;
+  ssf_mpi_iprobe(MPI_ANY_SOURCE, CHANNEL_EVENT_TAG, MPI_COMM_WORLD, &flag, &status);
+  if(!flag) return -1;
+
+  // check incoming message size
+  int size;
+  ssf_mpi_get_count(&status, MPI_PACKED, &size);
+  if(size > bufsiz) SSF_THROW("increase MPIBUF_SIZ to receive jumbo message: msgsiz=" << size);
+
+  ssf_mpi_recv(buf, size, MPI_PACKED, status.MPI_SOURCE,
+	       status.MPI_TAG, MPI_COMM_WORLD, &status);
+#ifndef NDEBUG
+  // WE ASSUME (ACCORDING TO MANPAGE) THE RECEIVED MESSAGE IS THE ONE PROBED
+  int t; ssf_mpi_get_count(&status, MPI_PACKED, &t);
+  if(t != size) SSF_THROW("internal error: invalid iprobe/recv sequence");
+#endif
+  *source = status.MPI_SOURCE;
+  return size;
+}
+
+void MPITransport::reduce_scatter(int64* sndcnt, int64* rcvcnt)
+{
+  ssf_mpi_reduce_scatter(sndcnt, rcvcnt, rscnt, MPI_LONG_LONG_INT, MPI_SUM, MPI_COMM_WORLD);
+}
+
+void MPITransport::barrier()
+{
+  ssf_mpi_barrier(MPI_COMM_WORLD);
+}
+
+void MPITransport::allgather(void* sendbuf, int size, void* recvbuf)
+{
+  ssf_mpi_allgather(sendbuf, size, MPI_BYTE, recvbuf, size, MPI_BYTE, MPI_COMM_WORLD);
+}
+
+void MPITransport::alltoallv(void* sendbuf, int* sendcnts, int* sdispls,
+			     void* recvbuf, int* recvcnts, int* rdispls)
+{
+  ssf_mpi_alltoallv(sendbuf, sendcnts, sdispls, MPI_BYTE,
+		    recvbuf, recvcnts, rdispls, MPI_BYTE, MPI_COMM_WORLD);
+}
+
+void MPITransport::interrupt()
+{
+  // inform the reader thread to finish by sending an mpi message (a
+  // packed dummy integer) to the same machine (it's a hack)
+  char mybuf[128]; int dummy = 0; int pos = 0;
+  ssf_mpi_pack(&dummy, 1, MPI_INT, mybuf, 128, &pos, MPI_COMM_WORLD);
+  ssf_mpi_bsend(mybuf, pos, MPI_PACKED, Universe::args_rank, CHANNEL_EVENT_TAG, MPI_COMM_WORLD);
+}
+
+#endif /*HAVE_MPI_H*/
+
+}; /*namespace minissf*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
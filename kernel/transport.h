@@ -0,0 +1,298 @@
+// the transport layer carries batches of packed channel events
+// between machines. The universe packs the events into a batch for
+// each remote machine and hands the batch over to the transport;
+// on the receiving side, the reader (or r/w) thread fetches the
+// batches from the transport and delivers the events. Besides
+// moving batches, the transport also provides the collective
+// operations: the reduce-scatter for counting transient events at the
+// epoch barrier (the only collective needed per epoch), a barrier,
+// and the collectives used at initialization (for the name directory
+// and the wiring), for reporting, and when the channels are
+// reclassified or retuned. None of these needs mpi, unless the
+// transport is built upon mpi.
+
+#ifndef __MINISSF_TRANSPORT_H__
+#define __MINISSF_TRANSPORT_H__
+
+#include "ssfapi/ssf_common.h"
+#include "kernel/ssfmachine.h"
+
+namespace minissf {
+
+class Transport {
+ public:
+  // the types of transport supported
+  enum {
+    TRANSPORT_MPI = 0, // mpi point-to-point messages (the default with mpi)
+    TRANSPORT_TCP = 1, // tcp sockets with an epoll progress thread (the default without mpi)
+    TRANSPORT_SHM = 2  // shared memory on the same host, mpi (or tcp without mpi) otherwise
+  };
+
+  // the reduction operators for allreduce
+  enum {
+    REDUCE_SUM = 0,
+    REDUCE_MIN = 1,
+    REDUCE_MAX = 2
+  };
+
+  // create the transport of the given type; the transport is created
+  // by processor 0 before the i/o threads are spawned
+  static Transport* create(int type);
+
+  // the destructor
+  virtual ~Transport() {}
+
+  // return the name of the transport (for reporting)
+  virtual const char* name() const = 0;
+
+  // return true if batches can be sent and received by separate
+  // threads and the collective operations can be called by processor
+  // 0 at the same time; otherwise, a single r/w thread must do it all
+  virtual bool is_concurrent() const = 0;
+
+  // send a batch of packed events to the remote machine; the buffer
+  // can be reused once the method returns
+  virtual void send_batch(int rank, char* buf, int size) = 0;
+
+  // receive a batch of packed events (blocking); return the size of
+  // the batch and set the source machine rank; a batch whose source
+  // is this machine indicates that the transport has been interrupted
+  virtual int recv_batch(char* buf, int bufsiz, int* source) = 0;
+
+  // receive a batch if one is available; return -1 if there is none
+  virtual int poll_batch(char* buf, int bufsiz, int* source) = 0;
+
+  // reduce the per-machine send counts from all machines and return
+  // the number of events this machine is expected to receive
+  virtual void reduce_scatter(int64* sndcnt, int64* rcvcnt) = 0;
+
+  // global barrier among all machines
+  virtual void barrier() = 0;
+
+  // gather the same number of bytes from each machine to all
+  // machines; the blocks are placed in the order of machine ranks
+  virtual void allgather(void* sendbuf, int size, void* recvbuf) = 0;
+
+  // send a distinct block of bytes from each machine to each
+  // machine; the counts and displacements are in bytes, indexed by
+  // machine rank (the receive counts must be known in advance)
+  virtual void alltoallv(void* sendbuf, int* sendcnts, int* sdispls,
+			 void* recvbuf, int* recvcnts, int* rdispls) = 0;
+
+  // make a blocking recv_batch return (to terminate the reader thread)
+  virtual void interrupt() = 0;
+
+  // the following are built upon the collectives above
+
+  // gather a different number of bytes from each machine
+  void allgatherv(void* sendbuf, int size, void* recvbuf, int* recvcnts, int* displs);
+
+  // send a block of the same number of bytes to each machine
+  void alltoall(void* sendbuf, int size, void* recvbuf);
+
+  // combine the values from all machines element-wise and return the
+  // result on all machines (T is int, int64, unsigned long, or double)
+  template<typename T> void allreduce(T* sendbuf, T* recvbuf, int count, int op);
+}; /*class Transport*/
+
+#ifdef HAVE_MPI_H
+// transport using mpi (buffered send for batches)
+class MPITransport : public Transport {
+ public:
+  MPITransport();
+  virtual ~MPITransport();
+
+  virtual const char* name() const { return "MPI"; }
+  virtual bool is_concurrent() const;
+  virtual void send_batch(int rank, char* buf, int size);
+  virtual int recv_batch(char* buf, int bufsiz, int* source);
+  virtual int poll_batch(char* buf, int bufsiz, int* source);
+  virtual void reduce_scatter(int64* sndcnt, int64* rcvcnt);
+  virtual void barrier();
+  virtual void allgather(void* sendbuf, int size, void* recvbuf);
+  virtual void alltoallv(void* sendbuf, int* sendcnts, int* sdispls,
+			 void* recvbuf, int* recvcnts, int* rdispls);
+  virtual void interrupt();
+
+ private:
+  char* attachbuf; // for mpi buffered send
+  int* rscnt; // used by reduce scatter
+}; /*class MPITransport*/
+#endif /*HAVE_MPI_H*/
+
+#ifdef __linux__
+#define SSF_TRANSPORT_TCP
+// transport using tcp sockets between all pairs of machines; an
+// epoll progress thread reads all sockets and queues the batches
+class TCPTransport : public Transport {
+ public:
+  TCPTransport();
+  virtual ~TCPTransport();
+
+  virtual const char* name() const { return "TCP"; }
+  virtual bool is_concurrent() const { return true; }
+  virtual void send_batch(int rank, char* buf, int size);
+  virtual int recv_batch(char* buf, int bufsiz, int* source);
+  virtual int poll_batch(char* buf, int bufsiz, int* source);
+  virtual void reduce_scatter(int64* sndcnt, int64* rcvcnt);
+  virtual void barrier();
+  virtual void allgather(void* sendbuf, int size, void* recvbuf);
+  virtual void alltoallv(void* sendbuf, int* sendcnts, int* sdispls,
+			 void* recvbuf, int* recvcnts, int* rdispls);
+  virtual void interrupt();
+
+ protected:
+  // frame types on the wire
+  enum { FRAME_BATCH = 0, FRAME_REDUCE = 1, FRAME_BARRIER = 2, FRAME_COLL = 3 };
+
+  struct FrameHeader {
+    int type; // one of the frame types
+    int size; // payload size in bytes
+  };
+
+  // a batch received by the progress thread waiting to be picked up
+  struct Batch {
+    int source;
+    int size;
+    char* data;
+  };
+
+  // per-peer connection state
+  struct Peer {
+    int fd; // socket connected to the peer (-1 for this machine)
+    bool closed; // the peer has shut down its end
+    ssf_thread_mutex_t send_mutex; // serialize frames sent to the peer
+    char* rbuf; // reassembly buffer for the incoming frames
+    int rbufsiz; // capacity of the reassembly buffer
+    int rpos; // number of bytes currently in the reassembly buffer
+  };
+
+  void connect_peers(); // establish the full mesh of connections
+  void rendezvous(int lfd, int* myinfo, int* info); // exchange addresses without mpi
+  void send_frame(int rank, int type, void* buf, int size);
+  int pop_batch(char* buf, int bufsiz, int* source); // called with mutex held
+  void handle_frame(int rank, FrameHeader* hdr, char* payload);
+  bool read_peer(int rank); // return false when peer has closed
+
+  static void progress_thread_start(void* data);
+  void progress_thread();
+
+  Peer* peers;
+  int epfd; // the epoll descriptor
+  ssf_thread_t progress_thread_id;
+
+  ssf_thread_mutex_t mutex; // protects everything below
+  ssf_thread_cond_t batch_cond; // signaled when a batch arrives
+  ssf_thread_cond_t coll_cond; // signaled when a collective frame arrives
+  DEQUE(Batch) batches; // the batches received
+  bool interrupted; // set by interrupt()
+  int64 reduce_round, barrier_round, coll_round; // the rounds of collectives started by this machine
+  MAP(int64,PAIR(int,int64)) reduce_arrivals; // round => (#arrivals, sum)
+  MAP(int64,int) barrier_arrivals; // round => #arrivals
+  MAP(int64,MAP(int,VECTOR(char))) coll_arrivals; // round => (source machine => block)
+}; /*class TCPTransport*/
+
+#define SSF_TRANSPORT_SHM
+// transport using posix shared memory between machines (mpi ranks)
+// co-located on the same host; batches to other hosts are sent using
+// the off-node transport (mpi, or tcp without mpi), which also
+// carries out the collective operations. Each machine creates a
+// shared memory segment as its inbox, which contains a
+// single-producer single-consumer ring buffer for each co-located
+// machine
+class ShmTransport : public Transport {
+ public:
+  ShmTransport(Transport* offnode);
+  virtual ~ShmTransport();
+
+  virtual const char* name() const { return "SHM"; }
+  virtual bool is_concurrent() const { return offnode->is_concurrent(); }
+  virtual void send_batch(int rank, char* buf, int size);
+  virtual int recv_batch(char* buf, int bufsiz, int* source);
+  virtual int poll_batch(char* buf, int bufsiz, int* source);
+  virtual void reduce_scatter(int64* sndcnt, int64* rcvcnt) { offnode->reduce_scatter(sndcnt, rcvcnt); }
+  virtual void barrier() { offnode->barrier(); }
+  virtual void allgather(void* sendbuf, int size, void* recvbuf) { 
+    offnode->allgather(sendbuf, size, recvbuf); }
+  virtual void alltoallv(void* sendbuf, int* sendcnts, int* sdispls,
+			 void* recvbuf, int* recvcnts, int* rdispls) {
+    offnode->alltoallv(sendbuf, sendcnts, sdispls, recvbuf, recvcnts, rdispls); }
+  virtual void interrupt() { interrupted = true; }
+
+  // return the number of other machines on the same host
+  int num_colocated() const { return nlocal-1; }
+
+ protected:
+  // the ring buffer; head and tail are the total number of bytes
+  // consumed and produced, and are kept on separate cache lines
+  struct Ring {
+    volatile int64 head;
+    char pad1[SSF_CACHE_LINE_SIZE-sizeof(int64)];
+    volatile int64 tail;
+    char pad2[SSF_CACHE_LINE_SIZE-sizeof(int64)];
+    char data[1]; // the actual size is determined at runtime
+  };
+
+  // a batch that can't fit in the ring buffer at the moment
+  struct Batch {
+    int size;
+    char* data;
+  };
+
+  // per-peer state for a co-located machine
+  struct Peer {
+    Ring* inring; // ring in my inbox written by the peer
+    Ring* outring; // ring in the peer's inbox written by me
+    ssf_thread_mutex_t send_mutex; // serialize writing to the ring
+    DEQUE(Batch) overflow; // batches waiting for room in the ring
+    volatile int noverflow; // number of batches in overflow
+  };
+
+  bool ring_push(Ring* ring, char* buf, int size);
+  int ring_pop(Ring* ring, char* buf, int bufsiz);
+  void flush_overflow(int lidx);
+
+  Transport* offnode; // for machines on other hosts
+  int nlocal; // number of machines on this host (including this one)
+  int* localidx; // machine rank => index among co-located machines (-1 if remote)
+  int* localrank; // index among co-located machines => machine rank
+  Peer* peers; // indexed by local index
+  int64 ringsize; // size of the data area of each ring
+  char* inbox; // my shared memory segment
+  int64 inbox_size;
+  VECTOR(PAIR(char*,int64)) mapped; // the peer segments mapped
+  int nextpoll; // for polling the rings round-robin
+  volatile bool interrupted;
+}; /*class ShmTransport*/
+#endif /*__linux__*/
+
+}; /*namespace minissf*/
+
+#endif /*__MINISSF_TRANSPORT_H__*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
@@ -0,0 +1,275 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "kernel/transport.h"
+#include "kernel/universe.h"
+
+#ifdef SSF_TRANSPORT_SHM
+
+/* The size of the data area of each ring buffer; a batch must be
+   smaller than half of this size. */
+#define SHM_RING_SIZE (1024*1024)
+
+/* Each record in the ring starts with a header that holds the size of
+   the batch (or -1 to mark that the rest of the ring is skipped). */
+#define SHM_RECORD_HEADER 8
+#define SHM_RECORD_ALIGN(x) (((x)+7)&~7)
+
+/* The max length of the host name used for detecting co-location. */
+#define SHM_HOSTNAME_LEN 64
+
+/* The number of times to poll before the reader thread takes a nap. */
+#define SHM_SPIN_COUNT 1000
+#define SHM_NAP_NSEC 20000
+
+namespace minissf {
+
+ShmTransport::ShmTransport(Transport* offtrans) :
+  offnode(offtrans), nextpoll(0), interrupted(false)
+{
+  assert(offnode);
+  int nmachs = Universe::args_nmachs;
+  int rank = Universe::args_rank;
+
+  // find out which machines are on the same host
+  char myinfo[SHM_HOSTNAME_LEN+sizeof(int)];
+  memset(myinfo, 0, sizeof(myinfo));
+  gethostname(myinfo, SHM_HOSTNAME_LEN-1);
+  int mypid = (int)getpid();
+  memcpy(myinfo+SHM_HOSTNAME_LEN, &mypid, sizeof(int));
+  char* info = new char[nmachs*sizeof(myinfo)]; assert(info);
+  offnode->allgather(myinfo, sizeof(myinfo), info);
+
+  localidx = new int[nmachs]; assert(localidx);
+  localrank = new int[nmachs]; assert(localrank);
+  nlocal = 0;
+  for(int i=0; i<nmachs; i++) {
+    if(!strncmp(myinfo, info+i*sizeof(myinfo), SHM_HOSTNAME_LEN)) {
+      localidx[i] = nlocal;
+      localrank[nlocal++] = i;
+    } else localidx[i] = -1;
+  }
+  assert(nlocal > 0 && localidx[rank] >= 0);
+
+  // create my inbox, with one ring for each co-located machine
+  ringsize = SHM_RING_SIZE;
+  int64 slotsize = SHM_RECORD_ALIGN(sizeof(Ring)+ringsize);
+  inbox_size = nlocal*slotsize;
+  char segname[128];
+  sprintf(segname, "/minissf-%d-%d", mypid, rank);
+  int fd = shm_open(segname, O_CREAT|O_EXCL|O_RDWR, 0600);
+  if(fd < 0) SSF_THROW("can't create shared memory segment " << segname << ": " << strerror(errno));
+  if(ftruncate(fd, inbox_size) < 0)
+    SSF_THROW("can't size shared memory segment " << segname << ": " << strerror(errno));
+  inbox = (char*)mmap(0, inbox_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(inbox == MAP_FAILED) SSF_THROW("can't map shared memory segment " << segname << ": " << strerror(errno));
+  close(fd);
+  memset(inbox, 0, inbox_size);
+
+  peers = new Peer[nlocal]; assert(peers);
+  for(int j=0; j<nlocal; j++) {
+    peers[j].inring = (Ring*)(inbox+j*slotsize);
+    peers[j].outring = 0;
+    ssf_thread_mutex_init(&peers[j].send_mutex);
+    peers[j].noverflow = 0;
+  }
+
+  // once all inboxes are created, map the peers' inboxes and locate
+  // the rings we write to; the names can be removed afterwards
+  offnode->barrier();
+  for(int j=0; j<nlocal; j++) {
+    if(localrank[j] == rank) continue;
+    int pid;
+    memcpy(&pid, info+localrank[j]*sizeof(myinfo)+SHM_HOSTNAME_LEN, sizeof(int));
+    char peername[128];
+    sprintf(peername, "/minissf-%d-%d", pid, localrank[j]);
+    int pfd = shm_open(peername, O_RDWR, 0600);
+    if(pfd < 0) SSF_THROW("can't open shared memory segment " << peername << ": " << strerror(errno));
+    char* seg = (char*)mmap(0, inbox_size, PROT_READ|PROT_WRITE, MAP_SHARED, pfd, 0);
+    if(seg == MAP_FAILED) SSF_THROW("can't map shared memory segment " << peername << ": " << strerror(errno));
+    close(pfd);
+    mapped.push_back(MAKE_PAIR(seg, inbox_size));
+    peers[j].outring = (Ring*)(seg+localidx[rank]*slotsize);
+  }
+  offnode->barrier();
+  shm_unlink(segname);
+  delete[] info;
+
+  if((Universe::args_debug_mask&Universe::DEBUG_FLAG_REPORT) != 0)
+    printf("[ MACH #%d: SHMEM PEERS=%d ]\n", rank, nlocal-1);
+}
+
+ShmTransport::~ShmTransport()
+{
+  for(int j=0; j<nlocal; j++) {
+    while(!peers[j].overflow.empty()) {
+      delete[] peers[j].overflow.front().data;
+      peers[j].overflow.pop_front();
+    }
+  }
+  delete[] peers;
+  for(VECTOR(PAIR(char*,int64))::iterator iter = mapped.begin();
+      iter != mapped.end(); iter++)
+    munmap((*iter).first, (*iter).second);
+  munmap(inbox, inbox_size);
+  delete[] localidx;
+  delete[] localrank;
+  delete offnode;
+}
+
+bool ShmTransport::ring_push(Ring* ring, char* buf, int size)
+{
+  int64 need = SHM_RECORD_HEADER+SHM_RECORD_ALIGN(size);
+  if(2*need > ringsize) SSF_THROW("batch too large for shared memory ring: size=" << size);
+
+  int64 tail = ring->tail; // only we write it
+  int64 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  int64 pos = tail%ringsize;
+  int64 skip = (ringsize-pos < need) ? ringsize-pos : 0;
+  if(ringsize-(tail-head) < skip+need) return false; // not enough room
+  if(skip) { // mark the rest of the ring as unused
+    *(int*)(ring->data+pos) = -1;
+    pos = 0;
+  }
+  *(int*)(ring->data+pos) = size;
+  memcpy(ring->data+pos+SHM_RECORD_HEADER, buf, size);
+  __atomic_store_n(&ring->tail, tail+skip+need, __ATOMIC_RELEASE);
+  return true;
+}
+
+int ShmTransport::ring_pop(Ring* ring, char* buf, int bufsiz)
+{
+  int64 head = ring->head; // only we write it
+  int64 tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  if(head == tail) return -1;
+  int64 pos = head%ringsize;
+  int size = *(int*)(ring->data+pos);
+  if(size < 0) { // skip to the beginning of the ring
+    head += ringsize-pos;
+    pos = 0;
+    size = *(int*)(ring->data);
+  }
+  if(size > bufsiz) SSF_THROW("increase MPIBUF_SIZ to receive jumbo message: msgsiz=" << size);
+  memcpy(buf, ring->data+pos+SHM_RECORD_HEADER, size);
+  __atomic_store_n(&ring->head, head+SHM_RECORD_HEADER+SHM_RECORD_ALIGN(size), __ATOMIC_RELEASE);
+  return size;
+}
+
+void ShmTransport::flush_overflow(int lidx)
+{
+  // called with the send mutex held; batches are kept in order
+  Peer& p = peers[lidx];
+  while(!p.overflow.empty()) {
+    Batch& b = p.overflow.front();
+    if(!ring_push(p.outring, b.data, b.size)) break;
+    delete[] b.data;
+    p.overflow.pop_front();
+    p.noverflow--;
+  }
+}
+
+void ShmTransport::send_batch(int rank, char* buf, int size)
+{
+  int lidx = localidx[rank];
+  if(lidx < 0) { offnode->send_batch(rank, buf, size); return; }
+
+  // if the ring is full, we hold on to the batch rather than waiting
+  // (the peer may be blocked sending to us); the reader thread will
+  // retry later
+  Peer& p = peers[lidx];
+  ssf_thread_mutex_lock(&p.send_mutex);
+  flush_overflow(lidx);
+  if(!p.overflow.empty() || !ring_push(p.outring, buf, size)) {
+    Batch b;
+    b.size = size;
+    b.data = new char[size]; assert(b.data);
+    memcpy(b.data, buf, size);
+    p.overflow.push_back(b);
+    p.noverflow++;
+  }
+  ssf_thread_mutex_unlock(&p.send_mutex);
+}
+
+int ShmTransport::poll_batch(char* buf, int bufsiz, int* source)
+{
+  // retry the batches held back for lack of room
+  for(int j=0; j<nlocal; j++) {
+    if(peers[j].noverflow > 0) {
+      ssf_thread_mutex_lock(&peers[j].send_mutex);
+      flush_overflow(j);
+      ssf_thread_mutex_unlock(&peers[j].send_mutex);
+    }
+  }
+
+  // poll the rings round-robin, and then the off-node transport
+  for(int k=0; k<nlocal; k++) {
+    int j = (nextpoll+k)%nlocal;
+    if(localrank[j] == Universe::args_rank) continue;
+    int size = ring_pop(peers[j].inring, buf, bufsiz);
+    if(size >= 0) {
+      nextpoll = (j+1)%nlocal;
+      *source = localrank[j];
+      return size;
+    }
+  }
+  if(nlocal < Universe::args_nmachs)
+    return offnode->poll_batch(buf, bufsiz, source);
+  else return -1;
+}
+
+int ShmTransport::recv_batch(char* buf, int bufsiz, int* source)
+{
+  // the rings can't be waited on; we poll and take a nap after a
+  // while if nothing arrives
+  for(int spin=0;; spin++) {
+    if(interrupted) {
+      interrupted = false;
+      *source = Universe::args_rank;
+      return 0;
+    }
+    int size = poll_batch(buf, bufsiz, source);
+    if(size >= 0) return size;
+    if(spin >= SHM_SPIN_COUNT) {
+      struct timespec ts;
+      ts.tv_sec = 0;
+      ts.tv_nsec = SHM_NAP_NSEC;
+      nanosleep(&ts, 0);
+    }
+  }
+}
+
+}; /*namespace minissf*/
+
+#endif /*SSF_TRANSPORT_SHM*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
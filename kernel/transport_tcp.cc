@@ -0,0 +1,543 @@
+#include <assert.h>
+#include <errno.h>
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "kernel/transport.h"
+#include "kernel/universe.h"
+
+#ifdef SSF_TRANSPORT_TCP
+#include <sys/epoll.h>
+
+/* The initial size of the reassembly buffer for each peer; it grows
+   on demand if a larger frame arrives. */
+#define TCP_RBUF_SIZE (64*1024)
+
+/* The max number of epoll events handled at one time. */
+#define TCP_MAX_EVENTS 64
+
+/* Without mpi, the machines meet at machine 0 to exchange addresses;
+   the others keep trying to connect until machine 0 is listening. */
+#define TCP_RENDEZVOUS_RETRIES 600
+#define TCP_RENDEZVOUS_NAP_USEC 100000
+
+namespace minissf {
+
+TCPTransport::TCPTransport() :
+  peers(0), epfd(-1), interrupted(false), reduce_round(0), barrier_round(0), coll_round(0)
+{
+  ssf_thread_mutex_init(&mutex);
+  ssf_thread_cond_init(&batch_cond);
+  ssf_thread_cond_init(&coll_cond);
+
+  int nmachs = Universe::args_nmachs;
+  peers = new Peer[nmachs]; assert(peers);
+  for(int i=0; i<nmachs; i++) {
+    peers[i].fd = -1;
+    peers[i].closed = false;
+    ssf_thread_mutex_init(&peers[i].send_mutex);
+    peers[i].rbuf = 0;
+    peers[i].rbufsiz = 0;
+    peers[i].rpos = 0;
+  }
+  connect_peers();
+
+  // all sockets are polled by the progress thread
+  epfd = epoll_create(nmachs);
+  if(epfd < 0) SSF_THROW("epoll_create failed: " << strerror(errno));
+  for(int i=0; i<nmachs; i++) {
+    if(i == Universe::args_rank) continue;
+    peers[i].rbuf = new char[TCP_RBUF_SIZE]; assert(peers[i].rbuf);
+    peers[i].rbufsiz = TCP_RBUF_SIZE;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, peers[i].fd, &ev) < 0)
+      SSF_THROW("epoll_ctl failed: " << strerror(errno));
+  }
+  ssf_thread_create(&progress_thread_id, &progress_thread_start, this);
+}
+
+TCPTransport::~TCPTransport()
+{
+  // we close our sending end of all connections; the progress thread
+  // terminates once all peers have done the same
+  for(int i=0; i<Universe::args_nmachs; i++)
+    if(i != Universe::args_rank) shutdown(peers[i].fd, SHUT_WR);
+  ssf_thread_join(&progress_thread_id);
+
+  for(int i=0; i<Universe::args_nmachs; i++) {
+    if(peers[i].fd >= 0) close(peers[i].fd);
+    if(peers[i].rbuf) delete[] peers[i].rbuf;
+  }
+  delete[] peers;
+  close(epfd);
+
+  while(!batches.empty()) {
+    delete[] batches.front().data;
+    batches.pop_front();
+  }
+}
+
+void TCPTransport::connect_peers()
+{
+  int nmachs = Universe::args_nmachs;
+  int rank = Universe::args_rank;
+
+  // the address to advertise can be set via the environment;
+  // otherwise, we use the first ipv4 address of the host name
+  struct in_addr myaddr;
+  myaddr.s_addr = htonl(INADDR_LOOPBACK);
+  char* host = getenv("SSF_TCP_HOST");
+  char myhostname[256];
+  if(!host && !gethostname(myhostname, 255)) host = myhostname;
+  if(host) {
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(!getaddrinfo(host, 0, &hints, &res)) {
+      myaddr = ((struct sockaddr_in*)res->ai_addr)->sin_addr;
+      freeaddrinfo(res);
+    }
+  }
+
+  // the listening port is either assigned by the system or offset by
+  // the machine rank from the given base port; without mpi, machine 0
+  // listens at the rendezvous port
+  int baseport = 0;
+  char* portstr = getenv("SSF_TCP_PORT");
+  if(portstr) baseport = atoi(portstr)+rank;
+#ifndef HAVE_MPI_H
+  char* rdvstr = getenv("SSF_TCP_RENDEZVOUS");
+  if(!rdvstr || !strchr(rdvstr, ':'))
+    SSF_THROW("SSF_TCP_RENDEZVOUS (host:port of machine 0) must be set to use tcp without mpi");
+  if(!rank) baseport = atoi(strchr(rdvstr, ':')+1);
+#endif
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  if(lfd < 0) SSF_THROW("can't create socket: " << strerror(errno));
+  int on = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  sa.sin_port = htons(baseport);
+  if(bind(lfd, (struct sockaddr*)&sa, sizeof(sa)) < 0)
+    SSF_THROW("can't bind socket to port " << baseport << ": " << strerror(errno));
+  if(listen(lfd, nmachs) < 0)
+    SSF_THROW("can't listen on socket: " << strerror(errno));
+  socklen_t salen = sizeof(sa);
+  getsockname(lfd, (struct sockaddr*)&sa, &salen);
+
+  // exchange the addresses of all machines
+  int myinfo[2], *info = new int[2*nmachs]; assert(info);
+  myinfo[0] = (int)myaddr.s_addr;
+  myinfo[1] = (int)ntohs(sa.sin_port);
+#ifdef HAVE_MPI_H
+  ssf_mpi_allgather(myinfo, 2, MPI_INT, info, 2, MPI_INT, MPI_COMM_WORLD);
+#else
+  rendezvous(lfd, myinfo, info); // machine 0 is connected to all by now
+#endif
+
+  // connect to the machines with lower ranks (the listening backlog
+  // holds the connections until they are accepted)
+  for(int i=0; i<rank; i++) {
+    if(peers[i].fd >= 0) continue;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) SSF_THROW("can't create socket: " << strerror(errno));
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = (in_addr_t)info[2*i];
+    sa.sin_port = htons(info[2*i+1]);
+    if(connect(fd, (struct sockaddr*)&sa, sizeof(sa)) < 0)
+      SSF_THROW("can't connect to machine " << i << " at " << inet_ntoa(sa.sin_addr) <<
+		":" << info[2*i+1] << ": " << strerror(errno));
+    if(send(fd, &rank, sizeof(int), MSG_NOSIGNAL) != sizeof(int))
+      SSF_THROW("can't send rank to machine " << i);
+    peers[i].fd = fd;
+  }
+
+  // accept connections from the machines with higher ranks
+  int nwait = 0;
+  for(int i=rank+1; i<nmachs; i++)
+    if(peers[i].fd < 0) nwait++;
+  while(nwait-- > 0) {
+    int fd = accept(lfd, 0, 0);
+    if(fd < 0) SSF_THROW("can't accept connection: " << strerror(errno));
+    int r;
+    if(recv(fd, &r, sizeof(int), MSG_WAITALL) != sizeof(int) ||
+       r <= rank || r >= nmachs || peers[r].fd >= 0)
+      SSF_THROW("invalid connection request");
+    peers[r].fd = fd;
+  }
+  close(lfd);
+  delete[] info;
+
+  for(int i=0; i<nmachs; i++) {
+    if(i == rank) continue;
+    setsockopt(peers[i].fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  }
+}
+
+void TCPTransport::rendezvous(int lfd, int* myinfo, int* info)
+{
+  int nmachs = Universe::args_nmachs;
+  int rank = Universe::args_rank;
+
+  if(!rank) {
+    // machine 0 collects the addresses from all others (over the
+    // connections that are kept afterwards) and sends back the table
+    info[0] = myinfo[0]; info[1] = myinfo[1];
+    for(int k=1; k<nmachs; k++) {
+      int fd = accept(lfd, 0, 0);
+      if(fd < 0) SSF_THROW("can't accept connection: " << strerror(errno));
+      int msg[3];
+      if(recv(fd, msg, sizeof(msg), MSG_WAITALL) != sizeof(msg) ||
+	 msg[0] <= 0 || msg[0] >= nmachs || peers[msg[0]].fd >= 0)
+	SSF_THROW("invalid rendezvous request");
+      peers[msg[0]].fd = fd;
+      info[2*msg[0]] = msg[1];
+      info[2*msg[0]+1] = msg[2];
+    }
+    for(int i=1; i<nmachs; i++) {
+      if(send(peers[i].fd, info, 2*nmachs*sizeof(int), MSG_NOSIGNAL) != (ssize_t)(2*nmachs*sizeof(int)))
+	SSF_THROW("can't send addresses to machine " << i);
+    }
+  } else {
+    // the others connect to machine 0 at the rendezvous address
+    char* rdvstr = getenv("SSF_TCP_RENDEZVOUS"); assert(rdvstr);
+    STRING rdvhost(rdvstr, strchr(rdvstr, ':')-rdvstr);
+    int rdvport = atoi(strchr(rdvstr, ':')+1);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(rdvhost.c_str(), 0, &hints, &res))
+      SSF_THROW("can't resolve rendezvous host " << rdvhost);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr = ((struct sockaddr_in*)res->ai_addr)->sin_addr;
+    sa.sin_port = htons(rdvport);
+    freeaddrinfo(res);
+
+    int fd = -1;
+    for(int k=0; k<TCP_RENDEZVOUS_RETRIES; k++) {
+      fd = socket(AF_INET, SOCK_STREAM, 0);
+      if(fd < 0) SSF_THROW("can't create socket: " << strerror(errno));
+      if(!connect(fd, (struct sockaddr*)&sa, sizeof(sa))) break;
+      close(fd); fd = -1;
+      usleep(TCP_RENDEZVOUS_NAP_USEC);
+    }
+    if(fd < 0) SSF_THROW("can't connect to machine 0 at rendezvous " << rdvstr);
+    int msg[3];
+    msg[0] = rank; msg[1] = myinfo[0]; msg[2] = myinfo[1];
+    if(send(fd, msg, sizeof(msg), MSG_NOSIGNAL) != sizeof(msg))
+      SSF_THROW("can't send rendezvous request to machine 0");
+    if(recv(fd, info, 2*nmachs*sizeof(int), MSG_WAITALL) != (ssize_t)(2*nmachs*sizeof(int)))
+      SSF_THROW("can't receive addresses from machine 0");
+    peers[0].fd = fd;
+  }
+}
+
+void TCPTransport::send_frame(int rank, int type, void* buf, int size)
+{
+  assert(rank != Universe::args_rank);
+  FrameHeader hdr;
+  hdr.type = type;
+  hdr.size = size;
+
+  ssf_thread_mutex_lock(&peers[rank].send_mutex);
+  char* p = (char*)&hdr; int len = sizeof(hdr); int flags = MSG_NOSIGNAL|MSG_MORE;
+  for(int k=0; k<2; k++) {
+    while(len > 0) {
+      ssize_t n = send(peers[rank].fd, p, len, flags);
+      if(n < 0) {
+	if(errno == EINTR) continue;
+	SSF_THROW("send to machine " << rank << " failed: " << strerror(errno));
+      }
+      p += n; len -= n;
+    }
+    p = (char*)buf; len = size; flags = MSG_NOSIGNAL;
+  }
+  ssf_thread_mutex_unlock(&peers[rank].send_mutex);
+}
+
+void TCPTransport::send_batch(int rank, char* buf, int size)
+{
+  send_frame(rank, FRAME_BATCH, buf, size);
+}
+
+int TCPTransport::pop_batch(char* buf, int bufsiz, int* source)
+{
+  Batch& b = batches.front();
+  if(b.size > bufsiz) SSF_THROW("increase MPIBUF_SIZ to receive jumbo message: msgsiz=" << b.size);
+  int size = b.size;
+  *source = b.source;
+  memcpy(buf, b.data, size);
+  delete[] b.data;
+  batches.pop_front();
+  return size;
+}
+
+int TCPTransport::recv_batch(char* buf, int bufsiz, int* source)
+{
+  int size;
+  ssf_thread_mutex_lock(&mutex);
+  while(batches.empty() && !interrupted)
+    ssf_thread_cond_wait(&batch_cond, &mutex);
+  if(interrupted) {
+    interrupted = false;
+    *source = Universe::args_rank;
+    size = 0;
+  } else size = pop_batch(buf, bufsiz, source);
+  ssf_thread_mutex_unlock(&mutex);
+  return size;
+}
+
+int TCPTransport::poll_batch(char* buf, int bufsiz, int* source)
+{
+  int size = -1;
+  ssf_thread_mutex_lock(&mutex);
+  if(!batches.empty()) size = pop_batch(buf, bufsiz, source);
+  ssf_thread_mutex_unlock(&mutex);
+  return size;
+}
+
+void TCPTransport::reduce_scatter(int64* sndcnt, int64* rcvcnt)
+{
+  int64 msg[2];
+  msg[0] = ++reduce_round;
+  for(int i=0; i<Universe::args_nmachs; i++) {
+    if(i == Universe::args_rank) continue;
+    msg[1] = sndcnt[i];
+    send_frame(i, FRAME_REDUCE, msg, sizeof(msg));
+  }
+
+  ssf_thread_mutex_lock(&mutex);
+  PAIR(int,int64)* arr = &reduce_arrivals[reduce_round];
+  while(arr->first < Universe::args_nmachs-1) {
+    ssf_thread_cond_wait(&coll_cond, &mutex);
+    arr = &reduce_arrivals[reduce_round];
+  }
+  *rcvcnt = sndcnt[Universe::args_rank]+arr->second;
+  reduce_arrivals.erase(reduce_round);
+  ssf_thread_mutex_unlock(&mutex);
+}
+
+void TCPTransport::barrier()
+{
+  int64 round = ++barrier_round;
+  for(int i=0; i<Universe::args_nmachs; i++) {
+    if(i == Universe::args_rank) continue;
+    send_frame(i, FRAME_BARRIER, &round, sizeof(round));
+  }
+
+  ssf_thread_mutex_lock(&mutex);
+  while(barrier_arrivals[round] < Universe::args_nmachs-1)
+    ssf_thread_cond_wait(&coll_cond, &mutex);
+  barrier_arrivals.erase(round);
+  ssf_thread_mutex_unlock(&mutex);
+}
+
+void TCPTransport::allgather(void* sendbuf, int size, void* recvbuf)
+{
+  int nmachs = Universe::args_nmachs;
+  int* cnts = new int[3*nmachs]; assert(cnts);
+  int* sdispls = &cnts[nmachs];
+  int* rdispls = &cnts[2*nmachs];
+  for(int i=0; i<nmachs; i++) {
+    cnts[i] = size;
+    sdispls[i] = 0;
+    rdispls[i] = i*size;
+  }
+  alltoallv(sendbuf, cnts, sdispls, recvbuf, cnts, rdispls);
+  delete[] cnts;
+}
+
+void TCPTransport::alltoallv(void* sendbuf, int* sendcnts, int* sdispls,
+			     void* recvbuf, int* recvcnts, int* rdispls)
+{
+  // each block is sent in a frame led by the round number, since the
+  // blocks of the next round may arrive before we are done with this
+  int64 round = ++coll_round;
+  int rank = Universe::args_rank;
+  for(int i=0; i<Universe::args_nmachs; i++) {
+    if(i == rank) continue;
+    char* frame = new char[sizeof(int64)+sendcnts[i]]; assert(frame);
+    memcpy(frame, &round, sizeof(int64));
+    memcpy(frame+sizeof(int64), (char*)sendbuf+sdispls[i], sendcnts[i]);
+    send_frame(i, FRAME_COLL, frame, sizeof(int64)+sendcnts[i]);
+    delete[] frame;
+  }
+  if(recvcnts[rank] != sendcnts[rank])
+    SSF_THROW("unmatched block size in alltoallv: " << sendcnts[rank] << " != " << recvcnts[rank]);
+  memcpy((char*)recvbuf+rdispls[rank], (char*)sendbuf+sdispls[rank], sendcnts[rank]);
+
+  ssf_thread_mutex_lock(&mutex);
+  while((int)coll_arrivals[round].size() < Universe::args_nmachs-1)
+    ssf_thread_cond_wait(&coll_cond, &mutex);
+  MAP(int,VECTOR(char))& arr = coll_arrivals[round];
+  for(MAP(int,VECTOR(char))::iterator iter = arr.begin(); iter != arr.end(); iter++) {
+    int i = (*iter).first;
+    if((int)(*iter).second.size() != recvcnts[i])
+      SSF_THROW("unmatched block size from machine " << i << " in alltoallv: " <<
+		(*iter).second.size() << " != " << recvcnts[i]);
+    if(recvcnts[i] > 0) memcpy((char*)recvbuf+rdispls[i], &(*iter).second[0], recvcnts[i]);
+  }
+  coll_arrivals.erase(round);
+  ssf_thread_mutex_unlock(&mutex);
+}
+
+void TCPTransport::interrupt()
+{
+  ssf_thread_mutex_lock(&mutex);
+  interrupted = true;
+  ssf_thread_cond_signal(&batch_cond);
+  ssf_thread_mutex_unlock(&mutex);
+}
+
+void TCPTransport::handle_frame(int rank, FrameHeader* hdr, char* payload)
+{
+  ssf_thread_mutex_lock(&mutex);
+  switch(hdr->type) {
+  case FRAME_BATCH: {
+    Batch b;
+    b.source = rank;
+    b.size = hdr->size;
+    b.data = new char[hdr->size]; assert(b.data);
+    memcpy(b.data, payload, hdr->size);
+    batches.push_back(b);
+    ssf_thread_cond_signal(&batch_cond);
+    break;
+  }
+  case FRAME_REDUCE: {
+    assert(hdr->size == 2*sizeof(int64));
+    int64* msg = (int64*)payload;
+    PAIR(int,int64)& arr = reduce_arrivals[msg[0]];
+    arr.first++;
+    arr.second += msg[1];
+    ssf_thread_cond_broadcast(&coll_cond);
+    break;
+  }
+  case FRAME_BARRIER: {
+    assert(hdr->size == sizeof(int64));
+    barrier_arrivals[*(int64*)payload]++;
+    ssf_thread_cond_broadcast(&coll_cond);
+    break;
+  }
+  case FRAME_COLL: {
+    assert(hdr->size >= (int)sizeof(int64));
+    int64 round;
+    memcpy(&round, payload, sizeof(int64));
+    coll_arrivals[round][rank].assign(payload+sizeof(int64), payload+hdr->size);
+    ssf_thread_cond_broadcast(&coll_cond);
+    break;
+  }
+  default: SSF_THROW("unknown frame type from machine " << rank << ": " << hdr->type);
+  }
+  ssf_thread_mutex_unlock(&mutex);
+}
+
+bool TCPTransport::read_peer(int rank)
+{
+  Peer& p = peers[rank];
+  for(;;) {
+    if(p.rpos == p.rbufsiz) { // grow the buffer for a large frame
+      char* nbuf = new char[2*p.rbufsiz]; assert(nbuf);
+      memcpy(nbuf, p.rbuf, p.rpos);
+      delete[] p.rbuf;
+      p.rbuf = nbuf;
+      p.rbufsiz *= 2;
+    }
+    ssize_t n = recv(p.fd, p.rbuf+p.rpos, p.rbufsiz-p.rpos, MSG_DONTWAIT);
+    if(n == 0) return false; // the peer has closed the connection
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN || errno == EWOULDBLOCK) return true;
+      if(errno == ECONNRESET) return false;
+      SSF_THROW("recv from machine " << rank << " failed: " << strerror(errno));
+    }
+    p.rpos += n;
+
+    // handle all complete frames in the buffer
+    int pos = 0;
+    while(p.rpos-pos >= (int)sizeof(FrameHeader)) {
+      FrameHeader hdr;
+      memcpy(&hdr, p.rbuf+pos, sizeof(hdr));
+      if(p.rpos-pos < (int)sizeof(hdr)+hdr.size) break;
+      handle_frame(rank, &hdr, p.rbuf+pos+sizeof(hdr));
+      pos += sizeof(hdr)+hdr.size;
+    }
+    if(pos > 0) {
+      memmove(p.rbuf, p.rbuf+pos, p.rpos-pos);
+      p.rpos -= pos;
+    }
+  }
+}
+
+void TCPTransport::progress_thread_start(void* data)
+{
+  ((TCPTransport*)data)->progress_thread();
+}
+
+void TCPTransport::progress_thread()
+{
+  int nopen = Universe::args_nmachs-1;
+  struct epoll_event evts[TCP_MAX_EVENTS];
+  while(nopen > 0) {
+    int n = epoll_wait(epfd, evts, TCP_MAX_EVENTS, -1);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      SSF_THROW("epoll_wait failed: " << strerror(errno));
+    }
+    for(int i=0; i<n; i++) {
+      int rank = (int)evts[i].data.u32;
+      if(peers[rank].closed) continue;
+      if(!read_peer(rank)) {
+	epoll_ctl(epfd, EPOLL_CTL_DEL, peers[rank].fd, 0);
+	peers[rank].closed = true;
+	nopen--;
+      }
+    }
+  }
+}
+
+}; /*namespace minissf*/
+
+#endif /*SSF_TRANSPORT_TCP*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include "kernel/universe.h"
+#include "kernel/coroutine.h"
 #include "ssf.h"
 
 namespace minissf {
@@ -33,15 +34,18 @@ bool Universe::training_finished;
 
 Universe** Universe::parallel_universe = 0;
 int Universe::sim_state = Universe::SIM_STATE_UNINITIALIZED;
+int64 Universe::init_phase_end[Universe::INIT_PHASE_TOTAL];
 
 void Universe::global_init()
 {
   time0 = time1 = ssf_wallclock_in_nanoseconds();
+  init_resident_memory = ssf_resident_memory_in_bytes();
 
   sim_state = SIM_STATE_INITIALIZING;
   parallel_universe = new Universe*[args_nprocs];
   assert(parallel_universe);
   ssf_barrier_init();
+  ssf_thread_mutex_init(&init_mutex);
   Random::global_seed = args_seed;
 
   if(!args_rank) { // only first machine print the copyright info
@@ -62,8 +66,15 @@ void Universe::global_init()
     }
   }
 
+  // the transport between machines is set up by all machines together
+  if(args_nmachs > 1) {
+    transport = Transport::create(args_transport); 
+    assert(transport);
+  }
+
   if(!args_rank && (args_debug_mask&DEBUG_FLAG_BRIEF) != 0) {
     printf("[ TOTAL MACHINES: %d ]\n", args_nmachs);
+    if(args_nmachs > 1) printf("[ TRANSPORT: %s ]\n", transport->name());
     printf("[ TOTAL PARALLELISM: %d ]\n", ssf_total_num_processors());
     if(args_global_thresh_set)
       printf("[ GLOBAL THRESHOLD: %lg (s) ]\n", args_global_thresh.second());
@@ -87,15 +98,16 @@ void Universe::global_init()
   }
   */
 
+  if(!args_trace.empty()) open_trace();
+
   // if there are more than one machine or more than one processor on
   // this machine, we'd use switch board to redistribute events during
   // composite synchronization barrier
   if(args_nprocs > 1) {
-    switch_board = new ChannelEvent**[args_nprocs]; assert(switch_board);
-    for(int i=0; i<args_nprocs; i++) {
-      switch_board[i] = new ChannelEvent*[args_nprocs];
-      assert(switch_board[i]);
-      memset(switch_board[i], 0, sizeof(ChannelEvent*)*args_nprocs);
+    switch_board = new SwitchRing[args_nprocs*args_nprocs]; assert(switch_board);
+    for(int i=0; i<args_nprocs*args_nprocs; i++) {
+      switch_board[i].head = switch_board[i].tail = 0;
+      switch_board[i].overflow = 0;
     }
   }
 }
@@ -126,7 +138,7 @@ void Universe::local_init()
 }
 
 #define REPORT_ARRAYSIZE_1 13
-#define REPORT_ARRAYSIZE_2 7
+#define REPORT_ARRAYSIZE_2 11
 #define REPORT_ARRAYSIZE 13 // larger of the two
 
 void Universe::local_wrapup() 
@@ -143,9 +155,9 @@ void Universe::local_wrapup()
   // timelines that belong to this universe
   for(SET(Timeline*)::iterator iter = timelines.begin();
       iter != timelines.end(); iter++) {
-    for(SET(Entity*)::iterator e_iter = (*iter)->entities.begin();
+    for(VECTOR(Entity*)::iterator e_iter = (*iter)->entities.begin();
 	e_iter != (*iter)->entities.end(); e_iter++) {
-      for(SET(Process*)::iterator p_iter = (*e_iter)->processes.begin();
+      for(VECTOR(Process*)::iterator p_iter = (*e_iter)->processes.begin();
 	  p_iter != (*e_iter)->processes.end(); p_iter++) 
 	(*p_iter)->wrapup();
       (*e_iter)->wrapup();
@@ -153,6 +165,8 @@ void Universe::local_wrapup()
   }
   ssf_barrier();
 
+  if(!processor_id && !args_save_profile.empty()) save_profile();
+
   if((args_debug_mask&DEBUG_FLAG_REPORT) != 0 || (args_debug_mask&DEBUG_FLAG_BRIEF) != 0) {
     /*
     if((args_debug_mask&DEBUG_FLAG_REPORT) != 0)
@@ -209,13 +223,11 @@ void Universe::local_wrapup()
     x[11] = ssf_sum_reduction(x[11]);
     x[12] = ssf_sum_reduction(x[12]);
 
-#ifdef HAVE_MPI_H
     if(args_nmachs > 1 && !processor_id) {
       unsigned long y[REPORT_ARRAYSIZE_1];
-      ssf_mpi_reduce(x, y, REPORT_ARRAYSIZE_1, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+      transport->allreduce(x, y, REPORT_ARRAYSIZE_1, Transport::REDUCE_SUM);
       if(!ssf_total_processor_index()) memcpy(x, y, REPORT_ARRAYSIZE_1*sizeof(unsigned long));
     }
-#endif
     
     unsigned long nevts = x[0];
     if((args_debug_mask&DEBUG_FLAG_BRIEF) != 0 && !ssf_total_processor_index()) {
@@ -232,12 +244,17 @@ void Universe::local_wrapup()
       ssf_barrier();
       for(int p=0; p<args_nprocs; p++) {
 	if(p == processor_id) {
-	  if(!p) printf("[%d:0] TLCTX     PACING    IOEVT     SMSG      SBYTE     RMSG      RBYTE\n", args_rank);
-	  printf("[%d:%d] %-9lu %-9lu %-9lu", args_rank, processor_id, 
-		 stats_timeline_context_switches, stats_timeline_pacing, stats_handle_io_events);
+	  if(!p) printf("[%d:0] TLCTX     PACING    IOEVT     QPOOL     QHIGH     QDOUT     QDIN      SMSG      SBYTE     RMSG      RBYTE\n", args_rank);
+	  printf("[%d:%d] %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu", args_rank, processor_id, 
+		 stats_timeline_context_switches, stats_timeline_pacing, stats_handle_io_events,
+		 (unsigned long)qmem_poolsize, (unsigned long)qmem_highwater, qmem_drift_out, qmem_drift_in);
 	  x[0] = stats_timeline_context_switches;
 	  x[1] = stats_timeline_pacing;
 	  x[2] = stats_handle_io_events;
+	  x[3] = (unsigned long)qmem_poolsize;
+	  x[4] = (unsigned long)qmem_highwater;
+	  x[5] = qmem_drift_out;
+	  x[6] = qmem_drift_in;
 	  if(!p) printf(" %-9lu %-9lu %-9lu %-9lu\n", stats_mpi_sent_messages,
 			stats_mpi_sent_bytes, stats_mpi_rcvd_messages, stats_mpi_rcvd_bytes);
 	  else printf(" *         *         *         *\n");
@@ -247,21 +264,30 @@ void Universe::local_wrapup()
       x[0] = ssf_sum_reduction(x[0]);
       x[1] = ssf_sum_reduction(x[1]);
       x[2] = ssf_sum_reduction(x[2]);
-      x[3] = stats_mpi_sent_messages;
-      x[4] = stats_mpi_sent_bytes;
-      x[5] = stats_mpi_rcvd_messages;
-      x[6] = stats_mpi_rcvd_bytes;
+      x[3] = ssf_sum_reduction(x[3]);
+      x[4] = ssf_sum_reduction(x[4]);
+      x[5] = ssf_sum_reduction(x[5]);
+      x[6] = ssf_sum_reduction(x[6]);
+      x[7] = stats_mpi_sent_messages;
+      x[8] = stats_mpi_sent_bytes;
+      x[9] = stats_mpi_rcvd_messages;
+      x[10] = stats_mpi_rcvd_bytes;
 
-#ifdef HAVE_MPI_H
       if(args_nmachs > 1 && !processor_id) {
-	int y[REPORT_ARRAYSIZE_2];
-	ssf_mpi_reduce(x, y, REPORT_ARRAYSIZE_2, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+	unsigned long y[REPORT_ARRAYSIZE_2];
+	transport->allreduce(x, y, REPORT_ARRAYSIZE_2, Transport::REDUCE_SUM);
 	if(!ssf_total_processor_index()) memcpy(x, y, REPORT_ARRAYSIZE_2*sizeof(unsigned long));
       }
-#endif
       if(!ssf_total_processor_index()) {
-	printf("[*:*] %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu\n",
-	       x[0], x[1], x[2], x[3], x[4], x[5], x[6]);
+	printf("[*:*] %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu\n",
+	       x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7], x[8], x[9], x[10]);
+      }
+
+      // live and peak bytes of quick memory by size class
+      ssf_barrier();
+      for(int p=0; p<args_nprocs; p++) {
+	if(p == processor_id) ssf_quickmem_report(processor_id, !p);
+	ssf_barrier();
       }
     }
 
@@ -271,6 +297,16 @@ void Universe::local_wrapup()
       if(args_nprocs > 1)
 	printf("[ DECADE LENGTH (on 1st machine): %lg (s) ]\n", decade_length.second());
       printf("[ INIT TIME: %lg (s) ]\n", VirtualTime(time1-time0).second());
+      if(init_phase_end[INIT_PHASE_BUILD] > 0) { // unless ssf_start() is skipped
+	init_phase_end[INIT_PHASE_STARTUP] = time1;
+	double t[INIT_PHASE_TOTAL];
+	for(int i=0; i<INIT_PHASE_TOTAL; i++)
+	  t[i] = VirtualTime(init_phase_end[i]-(i>0?init_phase_end[i-1]:time0)).second();
+	printf("[ INIT PHASES (on 1st machine): build %lg, entity init %lg, timelines %lg, "
+	       "names %lg, wiring %lg, delays %lg, startup %lg (s) ]\n", 
+	       t[INIT_PHASE_BUILD], t[INIT_PHASE_ENTITIES], t[INIT_PHASE_TIMELINES], 
+	       t[INIT_PHASE_NAMES], t[INIT_PHASE_WIRING], t[INIT_PHASE_DELAYS], t[INIT_PHASE_STARTUP]);
+      }
       printf("[ RUN TIME: %lg (s) ]\n", VirtualTime(time2-time1).second());
       printf("[ EVENT RATE: %lg (evts/s) ]\n", nevts/VirtualTime(time2-time0).second());
     }
@@ -303,26 +339,27 @@ void Universe::global_wrapup()
   //assert(local_icmap.empty());
   local_icmap.clear();
   assert(remote_icmap.empty());
-  //assert(named_inchannels_vector.empty());
-  named_inchannels_vector.clear();
+  assert(directory_icmap.empty());
   delete[] timeline_scans; timeline_scans = 0;
   //assert(!mapreq_head && !mapreq_tail);
   MapRequest* node = mapreq_head;
   while(node) { MapRequest* req = node; node = req->next; delete req; }
-  for(MAP(int,VECTOR(PAIR(MapInport*,Stargate*))*)::iterator sm_iter = starmap.begin();
+  for(MAP(int,VECTOR(MapStarport)*)::iterator sm_iter = starmap.begin();
       sm_iter != starmap.end(); sm_iter++) {
-    VECTOR(PAIR(MapInport*,Stargate*))* vec = (*sm_iter).second; assert(vec);
-    for(int i=0; i<(int)vec->size(); i++) delete vec->at(i).first;
+    VECTOR(MapStarport)* vec = (*sm_iter).second; assert(vec);
+    for(int i=0; i<(int)vec->size(); i++) delete vec->at(i).inport;
     delete vec;
   }
   starmap.clear();
   delete[] parallel_universe;
   sim_state = SIM_STATE_FINISHED;
 
-  if(switch_board) { // the 2D array should be empty (not checked)
-    for(int i=0; i<args_nprocs; i++) delete[] switch_board[i];
-    delete[] switch_board;
-  }
+  if(switch_board) delete[] switch_board; // the rings should be empty (not checked)
+  if(transport) { delete transport; transport = 0; }
+  if(!args_trace.empty()) close_trace();
+
+  // all entities, channels, and mappings are gone by now
+  ssf_arena_release();
 }
 
 void Universe::run(VirtualTime t, double s)
@@ -332,63 +369,183 @@ void Universe::run(VirtualTime t, double s)
 
   args_endtime = t;
   args_speedup = s;
+  end_init_phase(INIT_PHASE_BUILD);
+
+  // now run in parallel with other processors (which initialize the
+  // model together first)
+  run();
+}
+
+void Universe::initialize_model()
+{
+  if(!processor_id && !args_load_model.empty()) open_model_snapshot();
 
   // go for rounds until all entities are created, their init()
   // methods and their processes' init() methods will be called
-  while(!created_entities.empty()) {
-    // copy all the entities into a separate array
-    int sz = created_entities.size(); assert(sz > 0);	
-    Entity** ents = new Entity*[sz]; assert(ents);
-    register int i;
-    for(i=0; i<sz; i++) ents[i] = created_entities[i];
-    created_entities.clear();
-    for(i=0; i<sz; i++) ents[i]->init();
-    delete[] ents;
+  for(;;) {
+    if(!processor_id) {
+      merge_staged_entities(); // those created in the previous round
+      init_entities.clear();
+      init_entities.swap(created_entities);
+      if(snapshot_enabled()) add_snapshot_entities();
+      if(args_parallel_init || profile_enabled()) {
+	for(VECTOR(Entity*)::iterator e_iter = init_entities.begin();
+	    e_iter != init_entities.end(); e_iter++)
+	  entity_births.insert(MAKE_PAIR(*e_iter, (int)entity_births.size()));
+      }
+      if(args_parallel_init) 
+	init_concurrent = (args_nprocs > 1 && !init_entities.empty());
+    }
+    ssf_barrier();
+    if(init_entities.empty()) break;
+    if(args_parallel_init) {
+      // each processor takes a block of the entities
+      int sz = init_entities.size();
+      int lo = (int)((int64)sz*processor_id/args_nprocs);
+      int hi = (int)((int64)sz*(processor_id+1)/args_nprocs);
+      for(int i=lo; i<hi; i++) {
+	if(snapshot_enabled()) serialize_entity(i);
+	init_entities[i]->init();
+      }
+    } else if(!processor_id) {
+      int sz = init_entities.size();
+      for(int i=0; i<sz; i++) {
+	if(snapshot_enabled()) serialize_entity(i);
+	init_entities[i]->init();
+      }
+    }
+    ssf_barrier();
+  }
+
+  if(!processor_id) {
+    end_init_phase(INIT_PHASE_ENTITIES);
+
+    // if the model is loaded from a snapshot, the alignment and the
+    // channel mappings are restored rather than settled again
+    if(!args_load_model.empty()) restore_timelines();
+    else settle_timelines();
+    end_init_phase(INIT_PHASE_TIMELINES);
+
+    if(args_load_model.empty()) {
+      synchronize_inchannel_names();
+      resolve_inchannel_names();
+    }
+    end_init_phase(INIT_PHASE_NAMES);
+
+    distribute_mappings();
+    init_concurrent = (args_nprocs > 1);
   }
+  ssf_barrier();
+
+  // wire up the channel mappings in parallel
+  wire_up_local_channels();
+  ssf_barrier();
+
+  if(!processor_id) {
+    init_concurrent = false;
+    if(!args_load_model.empty()) restore_channels();
+    else wire_up_remote_channels();
+    if(!args_save_model.empty()) save_model_snapshot();
+    end_init_phase(INIT_PHASE_WIRING);
 
+    // find the training thresholds
+    enumerate_channel_delays();
+    end_init_phase(INIT_PHASE_DELAYS);
+
+    if((args_debug_mask&DEBUG_FLAG_BRIEF) != 0) report_model_footprint();
+  }
+}
+
+void Universe::merge_staged_entities()
+{
+  // the entities and mapping requests are appended in the order of
+  // the processors, each of which has called init() for a block of
+  // the entities in order; the result is as if init() were called
+  // sequentially
+  for(int p=0; p<args_nprocs; p++) {
+    Universe* univ = parallel_universe[p]; assert(univ);
+    created_entities.insert(created_entities.end(), 
+			    univ->staged_entities.begin(), univ->staged_entities.end());
+    univ->staged_entities.clear();
+    if(univ->staged_mapreq_head) {
+      if(!mapreq_head) mapreq_head = univ->staged_mapreq_head;
+      else mapreq_tail->next = univ->staged_mapreq_head;
+      mapreq_tail = univ->staged_mapreq_tail;
+      univ->staged_mapreq_head = univ->staged_mapreq_tail = 0;
+    }
+  }
+}
+
+void Universe::list_created_timelines(VECTOR(Timeline*)& tmlns)
+{
+  tmlns.clear();
+  if(!args_parallel_init) {
+    tmlns.assign(created_timelines.begin(), created_timelines.end());
+    return;
+  }
+
+  // if init() is called in parallel, the order in which the entities
+  // and timelines are allocated is not deterministic; we order the
+  // entities of each timeline, and the timelines themselves, by the
+  // order in which the entities are created
+  VECTOR(PAIR(int,Timeline*)) tvec;
+  for(SET(Timeline*)::iterator tmln_iter = created_timelines.begin();
+      tmln_iter != created_timelines.end(); tmln_iter++) {
+    Timeline* tmln = *tmln_iter;
+    assert(!tmln->entities.empty());
+    VECTOR(PAIR(int,Entity*)) evec;
+    for(VECTOR(Entity*)::iterator e_iter = tmln->entities.begin();
+	e_iter != tmln->entities.end(); e_iter++) {
+      UNORDERED_MAP(Entity*,int)::iterator b_iter = entity_births.find(*e_iter);
+      assert(b_iter != entity_births.end());
+      evec.push_back(MAKE_PAIR((*b_iter).second, *e_iter));
+    }
+    std::sort(evec.begin(), evec.end());
+    for(int i=0; i<(int)evec.size(); i++) tmln->entities[i] = evec[i].second;
+    tvec.push_back(MAKE_PAIR(evec[0].first, tmln));
+  }
+  std::sort(tvec.begin(), tvec.end());
+  for(VECTOR(PAIR(int,Timeline*))::iterator t_iter = tvec.begin();
+      t_iter != tvec.end(); t_iter++) tmlns.push_back((*t_iter).second);
+}
+
+void Universe::settle_timelines()
+{
   // create timelines for orphan entities
-  for(SET(Entity*)::iterator ent_iter = orphan_entities.begin();
-      ent_iter != orphan_entities.end(); ent_iter++) {
-    Timeline* tmln = create_timeline();
-    tmln->add_entity(*ent_iter);
+  if(args_parallel_init) {
+    VECTOR(PAIR(int,Entity*)) evec;
+    for(SET(Entity*)::iterator ent_iter = orphan_entities.begin();
+	ent_iter != orphan_entities.end(); ent_iter++) {
+      UNORDERED_MAP(Entity*,int)::iterator b_iter = entity_births.find(*ent_iter);
+      assert(b_iter != entity_births.end());
+      evec.push_back(MAKE_PAIR((*b_iter).second, *ent_iter));
+    }
+    std::sort(evec.begin(), evec.end());
+    for(VECTOR(PAIR(int,Entity*))::iterator e_iter = evec.begin();
+	e_iter != evec.end(); e_iter++) {
+      Timeline* tmln = create_timeline();
+      tmln->add_entity((*e_iter).second);
+    }
+  } else {
+    for(SET(Entity*)::iterator ent_iter = orphan_entities.begin();
+	ent_iter != orphan_entities.end(); ent_iter++) {
+      Timeline* tmln = create_timeline();
+      tmln->add_entity(*ent_iter);
+    }
   }
   orphan_entities.clear();
 
+  VECTOR(Timeline*) tmlns;
+
   // auto-alignment kicks in
   if(0 < args_naligns && args_naligns < (int)created_timelines.size()) {
-    metis_graph_t* graph = new metis_graph_t();
-
-    // first create the graph nodes
-    for(SET(Timeline*)::iterator tmln_iter = created_timelines.begin();
-	tmln_iter != created_timelines.end(); tmln_iter++) {
-      // this is temporary!!!
-      (*tmln_iter)->serialno = 
-	graph->add_node((*tmln_iter)->entities.size(), *tmln_iter);
-    }
-
-    // next connect the graph nodes
-    MapRequest* req = mapreq_head;
-    while(req) {
-      if(req->ic) { // direct mapping
-	if(req->oc->owner()->timeline != req->ic->owner()->timeline) {
-	  graph->add_link(req->oc->owner()->timeline->serialno,
-			  req->ic->owner()->timeline->serialno, 
-			  req->oc->channel_delay+req->delay);
-	}
-      } else {
-	MAP(STRING,inChannel*)::iterator iciter = local_icmap.find(req->icname);
-	if(iciter != local_icmap.end() &&
-	   req->oc->owner()->timeline != (*iciter).second->owner()->timeline) {
-	  graph->add_link(req->oc->owner()->timeline->serialno,
-			  (*iciter).second->owner()->timeline->serialno, 
-			  req->oc->channel_delay+req->delay);
-	}
-      }
-      req = req->next;
-    }
+    list_created_timelines(tmlns);
+    metis_graph_t* graph = build_timeline_graph(tmlns);
 
     // partition using metis
     graph->partition(args_naligns);
+    if(!args_rank && (args_debug_mask&DEBUG_FLAG_BRIEF) != 0)
+      report_partition("ALIGNMENT", graph, args_naligns);
 
     Timeline** tm = new Timeline*[args_naligns]; assert(tm);
     memset(tm, 0, args_naligns*sizeof(Timeline*));
@@ -411,21 +568,16 @@ void Universe::run(VirtualTime t, double s)
   ns[0] = 0; // number of entities
   ns[1] = 0; // number of output ports
   ns[2] = created_timelines.size(); // number of timelines
-  SET(Timeline*)::iterator tmln_iter;
-  for(tmln_iter = created_timelines.begin();
-      tmln_iter != created_timelines.end(); tmln_iter++) {
+  list_created_timelines(tmlns);
+  VECTOR(Timeline*)::iterator tmln_iter;
+  for(tmln_iter = tmlns.begin(); tmln_iter != tmlns.end(); tmln_iter++) {
     ns[0] += (*tmln_iter)->get_serialno_space();
     ns[1] += (*tmln_iter)->get_portno_space();
   }
   int* scans = new int[args_nmachs*3]; assert(scans);
   timeline_scans = new int[args_nmachs]; assert(timeline_scans);
-#ifdef HAVE_MPI_H
-  ssf_mpi_allgather(ns, 3, MPI_INT, scans, 3, MPI_INT, MPI_COMM_WORLD);
-#else
-  scans[0] = ns[0]; 
-  scans[1] = ns[1];
-  scans[2] = ns[2];
-#endif
+  if(args_nmachs > 1) transport->allgather(ns, 3*sizeof(int), scans);
+  else memcpy(scans, ns, 3*sizeof(int));
   int partial_sum0 = 0, partial_sum1 = 0, partial_sum2 = 0;
   for(int i=0; i<args_nmachs; i++) {
     partial_sum0 += scans[i*3];
@@ -441,29 +593,152 @@ void Universe::run(VirtualTime t, double s)
   //printf("[%d] ne=%d, np=%d, nt=%d\n", args_rank, startne, startnp, startnt);
   delete[] scans;
 
+  // the timelines that communicate the most are placed on the same
+  // processor; they are numbered in order of the processors
+  VECTOR(int) owners;
+  if(args_nprocs > 1 && args_nprocs < (int)tmlns.size()) {
+    metis_graph_t* graph = build_timeline_graph(tmlns);
+    graph->partition(args_nprocs);
+    if(!args_rank && (args_debug_mask&DEBUG_FLAG_BRIEF) != 0)
+      report_partition("ASSIGNMENT", graph, args_nprocs);
+    VECTOR(PAIR(int,int)) pvec; // (processor, index in tmlns)
+    for(int i=0; i<(int)tmlns.size(); i++) 
+      pvec.push_back(MAKE_PAIR(graph->nodes[i]->part, i));
+    delete graph;
+    std::sort(pvec.begin(), pvec.end());
+    VECTOR(Timeline*) tvec;
+    for(VECTOR(PAIR(int,int))::iterator p_iter = pvec.begin(); p_iter != pvec.end(); p_iter++) {
+      tvec.push_back(tmlns[(*p_iter).second]);
+      owners.push_back((*p_iter).first);
+    }
+    tmlns.swap(tvec);
+  }
+
   int tid = 0;
-  for(tmln_iter = created_timelines.begin();
-      tmln_iter != created_timelines.end(); tmln_iter++, tid++) {
-    int x = BLOCK_OWNER(tid,args_nprocs,ns[2]);
-    parallel_universe[x]->assign_timeline(*tmln_iter);
+  for(tmln_iter = tmlns.begin(); tmln_iter != tmlns.end(); tmln_iter++, tid++) {
     startne = (*tmln_iter)->settle_serialno(startnt+tid, startne);
     startnp = (*tmln_iter)->settle_portno(startnp);
+  }
+  distribute_timelines(tmlns, owners.empty() ? 0 : &owners);
+  created_timelines.clear();
+  if(args_save_profile.empty()) entity_births.clear(); // the profile refers to entities in order
+}
+
+metis_graph_t* Universe::build_timeline_graph(const VECTOR(Timeline*)& tmlns)
+{
+  metis_graph_t* graph = new metis_graph_t(); assert(graph);
+
+  // first create the graph nodes
+  for(VECTOR(Timeline*)::const_iterator tmln_iter = tmlns.begin();
+      tmln_iter != tmlns.end(); tmln_iter++) {
+    // this is temporary!!!
+    (*tmln_iter)->serialno = 
+      graph->add_node((*tmln_iter)->entities.size(), *tmln_iter);
+
+    // the memory is estimated by the number of model elements
+    metis_node_t* node = graph->nodes[(*tmln_iter)->serialno];
+    node->memory = 0;
+    for(VECTOR(Entity*)::const_iterator e_iter = (*tmln_iter)->entities.begin();
+	e_iter != (*tmln_iter)->entities.end(); e_iter++) {
+      node->memory += 1+(*e_iter)->getInChannels().size()+
+	(*e_iter)->getOutChannels().size()+(*e_iter)->getProcesses().size();
+    }
+  }
+
+  // next connect the graph nodes
+  MapRequest* req = mapreq_head;
+  while(req) {
+    graph->nodes[req->oc->owner()->timeline->serialno]->memory++;
+    if(req->ic) { // direct mapping
+      if(req->oc->owner()->timeline != req->ic->owner()->timeline) {
+	graph->add_link(req->oc->owner()->timeline->serialno,
+			req->ic->owner()->timeline->serialno, 
+			req->oc->channel_delay+req->delay);
+      }
+    } else {
+      UNORDERED_MAP(STRING,inChannel*)::iterator iciter = local_icmap.find(req->icname);
+      if(iciter != local_icmap.end() &&
+	 req->oc->owner()->timeline != (*iciter).second->owner()->timeline) {
+	graph->add_link(req->oc->owner()->timeline->serialno,
+			(*iciter).second->owner()->timeline->serialno, 
+			req->oc->channel_delay+req->delay);
+      }
+    }
+    req = req->next;
+  }
+
+  // weigh the nodes and links with the measurements of a previous run
+  if(!args_load_profile.empty()) apply_profile(graph);
+  return graph;
+}
+
+void Universe::report_partition(const char* what, metis_graph_t* graph, int nparts)
+{
+  printf("[ %s (on 1st machine): %d timelines into %d, %d links cut, min delay cut %lg (s) ]\n",
+	 what, (int)graph->nodes.size(), nparts, graph->cut_links,
+	 graph->cut_links ? VirtualTime(graph->cut_delay).second() : VirtualTime(VirtualTime::INFINITY).second());
+}
+
+void Universe::distribute_timelines(const VECTOR(Timeline*)& tmlns, const VECTOR(int)* owners)
+{
+  int nt = tmlns.size();
+  for(int tid=0; tid<nt; tid++) {
+    int x = owners ? (*owners)[tid] : BLOCK_OWNER(tid,args_nprocs,nt);
+    parallel_universe[x]->assign_timeline(tmlns[tid]);
     if((args_debug_mask&DEBUG_FLAG_LPSCHED) != 0) {
       printf("[%d] assign timeline %d to universe %d (i=%d,p=%d,n=%d)\n",
-	     args_rank, (*tmln_iter)->serialno, x, tid, args_nprocs, ns[2]);
+	     args_rank, tmlns[tid]->serialno, x, tid, args_nprocs, nt);
     }
   }
-  created_timelines.clear();
+}
 
-  // wire up the channel mappings
-  synchronize_inchannel_names();
-  wire_up_channels();
+void Universe::report_model_footprint()
+{
+  // count the model elements on this machine (the timelines have
+  // all been assigned to the universes by now)
+  unsigned long x[7]; memset(x, 0, 7*sizeof(unsigned long));
+  for(int p=0; p<args_nprocs; p++) {
+    Universe* univ = parallel_universe[p]; assert(univ);
+    for(SET(Timeline*)::iterator tmln_iter = univ->timelines.begin();
+	tmln_iter != univ->timelines.end(); tmln_iter++) {
+      const VECTOR(Entity*)& ents = (*tmln_iter)->get_entities();
+      x[0] += ents.size();
+      for(VECTOR(Entity*)::const_iterator e_iter = ents.begin();
+	  e_iter != ents.end(); e_iter++) {
+	Entity* ent = *e_iter;
+	x[1] += ent->inchannels.size();
+	x[2] += ent->outchannels.size();
+	x[3] += ent->processes.size();
+	for(VECTOR(outChannel*)::iterator oc_iter = ent->outchannels.begin();
+	    oc_iter != ent->outchannels.end(); oc_iter++) {
+	  for(MapOutport* outport = (*oc_iter)->outports; outport; outport = outport->next) {
+	    x[4]++;
+	    for(MapInport* inport = outport->inport; inport; inport = inport->next) x[4]++;
+	  }
+	}
+      }
+    }
+  }
+  x[5] = (unsigned long)ssf_arena_size();
+  int64 rss = ssf_resident_memory_in_bytes();
+  x[6] = (rss > init_resident_memory) ? (unsigned long)(rss-init_resident_memory) : 0;
 
-  // find the training thresholds
-  enumerate_channel_delays();
+  if(args_nmachs > 1) {
+    unsigned long y[7];
+    transport->allreduce(x, y, 7, Transport::REDUCE_SUM);
+    if(!args_rank) memcpy(x, y, 7*sizeof(unsigned long));
+  }
 
-  // now run in parallel with other processors
-  run();
+  if(!args_rank) {
+    printf("[ MODEL SIZE: %lu entities, %lu inchannels, %lu outchannels, %lu processes, %lu mapping records ]\n",
+	   x[0], x[1], x[2], x[3], x[4]);
+    if(x[0] > 0) {
+      if(x[6] > 0)
+	printf("[ MEMORY PER ENTITY: %.1lf bytes resident, %.1lf bytes in init arena ]\n",
+	       (double)x[6]/x[0], (double)x[5]/x[0]);
+      else printf("[ MEMORY PER ENTITY: %.1lf bytes in init arena ]\n", (double)x[5]/x[0]);
+    }
+  }
 }
 
 void Universe::enumerate_channel_delays()
@@ -497,13 +772,12 @@ void Universe::enumerate_channel_delays()
   }						
   //printf("--->%d %d\n", (int)global_distinct_delays.size(), (int)local_distinct_delays.size());
 
-#ifdef HAVE_MPI_H
   // find all distinct global delays among all machines
   if(!args_global_thresh_set && args_nmachs > 1) {
     // collect all sizes
     int nn = global_distinct_delays.size();
     int* nc = new int[args_nmachs]; assert(nc);
-    ssf_mpi_allgather(&nn, 1, MPI_INT, nc, 1, MPI_INT, MPI_COMM_WORLD);
+    transport->allgather(&nn, sizeof(int), nc);
     int n = 0;
     for(int i=0; i<args_nmachs; i++) n += nc[i];
     //printf("total = %d\n", n);
@@ -529,13 +803,19 @@ void Universe::enumerate_channel_delays()
       int64* ts = new int64[n]; assert(ts);
       int* ns = new int[n]; assert(ns);
       int* displs = new int[args_nmachs]; assert(displs);
+      int* bytes = new int[args_nmachs]; assert(bytes);
       int acc = 0;
-      for(int i=0; i<args_nmachs; i++) {
-	displs[i] = acc;
+      for(int i=0; i<args_nmachs; i++) { // in bytes for the delays first
+	displs[i] = acc*sizeof(int64);
+	bytes[i] = nc[i]*sizeof(int64);
 	acc += nc[i];
       }
-      ssf_mpi_allgatherv(myts, nn, MPI_LONG_LONG_INT, ts, nc, displs, MPI_LONG_LONG_INT, MPI_COMM_WORLD);
-      ssf_mpi_allgatherv(myns, nn, MPI_INT, ns, nc, displs, MPI_INT, MPI_COMM_WORLD);
+      transport->allgatherv(myts, nn*sizeof(int64), ts, bytes, displs);
+      for(int i=0; i<args_nmachs; i++) { // then for the counts
+	displs[i] = displs[i]/sizeof(int64)*sizeof(int);
+	bytes[i] = nc[i]*sizeof(int);
+      }
+      transport->allgatherv(myns, nn*sizeof(int), ns, bytes, displs);
 
       // reconstruct the global distinct delays from gather results
       global_distinct_delays.clear();
@@ -553,9 +833,9 @@ void Universe::enumerate_channel_delays()
       delete[] ts; 
       delete[] ns; 
       delete[] displs;
+      delete[] bytes;
     }
   }
-#endif
 
   // trimming down distinct delays
   if(!args_local_thresh_set && local_distinct_delays.size() > 0) 
@@ -565,13 +845,11 @@ void Universe::enumerate_channel_delays()
     local_training_round = local_training_thresholds[sz-1];
     local_training_length = local_training_round*sz;
   } else local_training_length = local_training_round = 0;
-#ifdef HAVE_MPI_H
   if(args_nmachs > 1) {
     int64 x = local_training_length.get_ticks(), y;
-    ssf_mpi_allreduce(&x, &y, 1, MPI_LONG_LONG_INT, MPI_MAX, MPI_COMM_WORLD);
+    transport->allreduce(&x, &y, 1, Transport::REDUCE_MAX);
     local_training_length.set_ticks(y);
   }
-#endif
   if(!args_global_thresh_set && global_distinct_delays.size() > 0)
     trim_channel_delays(global_distinct_delays, global_training_thresholds, 
 			MAX_GLOBAL_TRAINING_ROUNDS);
@@ -665,7 +943,6 @@ int Universe::classify_global_channels(VirtualTime t, VirtualTime now, bool trai
   if(training) epoch_length = t;
   else epoch_length = VirtualTime::INFINITY;
 
-#ifdef HAVE_MPI_H
   for(MAP(PAIR(int,int),Stargate*)::iterator sg_iter = created_stargates.begin();
       sg_iter != created_stargates.end(); sg_iter++) {
     VirtualTime mt = (*sg_iter).second->min_delay;
@@ -694,14 +971,23 @@ int Universe::classify_global_channels(VirtualTime t, VirtualTime now, bool trai
     }
   }
 
+  // a checkpoint can only be taken at a global synchronization point
+  if(!training && !args_checkpoint.empty() && args_nmachs > 1 &&
+     args_checkpoint_interval < epoch_length)
+    epoch_length = args_checkpoint_interval;
+
+  // the threshold is re-evaluated at a global synchronization point
+  if(!training && args_nmachs > 1 && retune_enabled() &&
+     args_retune_interval < epoch_length)
+    epoch_length = args_retune_interval;
+
   if(!training && args_nmachs > 1) {
     int64 myepoch = epoch_length.get_ticks(), yourepoch;
-    ssf_mpi_allreduce(&myepoch, &yourepoch, 1, MPI_LONG_LONG_INT, MPI_MIN, MPI_COMM_WORLD);
+    transport->allreduce(&myepoch, &yourepoch, 1, Transport::REDUCE_MIN);
     epoch_length.set_ticks(yourepoch);
     int new_nlinks_sync = nlinks_sync;
-    ssf_mpi_allreduce(&new_nlinks_sync, &nlinks_sync, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    transport->allreduce(&new_nlinks_sync, &nlinks_sync, 1, Transport::REDUCE_SUM);
   }
-#endif
 
   if((args_debug_mask&DEBUG_FLAG_LPSCHED) != 0) {
     printf("[%d] classify global(%lg): epoch_length=%lg, sync_links=%d\n", 
@@ -745,6 +1031,16 @@ int Universe::classify_local_channels(VirtualTime t, VirtualTime now, bool train
     }
   }
 
+  // a checkpoint can only be taken at a synchronization point
+  if(!training && !args_checkpoint.empty() && args_nmachs == 1 &&
+     args_checkpoint_interval < decade_length)
+    decade_length = args_checkpoint_interval;
+
+  // the threshold is re-evaluated at a synchronization point
+  if(!training && args_nmachs == 1 && retune_enabled() &&
+     args_retune_interval < decade_length)
+    decade_length = args_retune_interval;
+
   if((args_debug_mask&DEBUG_FLAG_LPSCHED) != 0) {
     printf("[%d] classify local(%lg): decade_length=%lg, sync_links=%d\n", 
 	   args_rank, t.second(), decade_length.second(), nlinks_sync);
@@ -762,10 +1058,17 @@ void Universe::classify_timeline_channels()
 }
 
 Universe::Universe(int id) : 
-  qmem_chunklist(0), qmem_poolsize(0), qmem_poolbegin(0), 
-  qmem_poolend(0), qmem_freelist(0), processor_id(id), 
+  qmem_chunklist(0), qmem_poolsize(0), qmem_partial(0), qmem_idle(0), 
+  qmem_released(0), qmem_nidle(0), qmem_live(0), qmem_peak(0), qmem_remotefree(0), 
+  qmem_inuse(0), qmem_highwater(0), qmem_drift_out(0), qmem_drift_in(0),
+  staged_mapreq_head(0), staged_mapreq_tail(0), staged_rmap_head(0), staged_rmap_tail(0),
+  staged_seqno(0), 
+  retune_sync_wait(0), retune_block_wait(0), 
+  retune_windows(0), retune_busy_windows(0),
+  trace_buffer(0), tracer(0), processor_id(id), 
+  switch_rounds(0), switch_done(0),
   synpoint(0), next_decade(0), next_epoch(0), 
-  global_binque(0), local_binque(0), 
+  global_binque(0), local_binque(0), blocked_timelines(0),
   mailbox(0), mailbox_tail(0),
   stats_timeline_context_switches(0),
   stats_timeline_pacing(0),
@@ -776,6 +1079,13 @@ Universe::Universe(int id) :
   ssf_thread_cond_init(&mailbox_cond);
 
   ssf_quickmem_init(processor_id);
+
+  switch_done = new bool[args_nprocs]; assert(switch_done);
+
+  if(!args_trace.empty()) {
+    trace_buffer = new TraceBuffer(processor_id); 
+    assert(trace_buffer);
+  }
 }
 
 Universe::~Universe() 
@@ -791,10 +1101,14 @@ Universe::~Universe()
   while(mailbox) {
     ChainedEvent* evt = mailbox;
     mailbox = mailbox->get_next_event();
-    delete evt;
+    if(!evt->is_null_message()) delete evt; // null messages are owned by stargates
   }
   mailbox_tail = 0;
 
+  if(trace_buffer) delete trace_buffer;
+  delete[] switch_done;
+
+  ssf_coroutine_wrapup(this);
   ssf_quickmem_wrapup(processor_id);
   parallel_universe[processor_id] = 0;
 }
@@ -9,11 +9,18 @@
 #include "kernel/ssfmachine.h"
 #include "evtlist/simevent.h"
 #include "kernel/binque.h"
+#include "kernel/transport.h"
+#include "kernel/trace.h"
 
 namespace minissf {
 
 typedef BinaryHeap<VirtualTime> TimelineQueue;
 
+class metis_graph_t;
+
+// the number of event pointers in each ring of the switch board
+#define SWITCH_RING_SIZE 256
+
 class Universe {
   friend class Timeline;
   friend class Stargate;
@@ -36,6 +43,21 @@ class Universe {
     OPTION_SET_LOCAL_THRESH,
     OPTION_SET_TRAINING_LEN,
     OPTION_TIMESLICE,
+    OPTION_TRANSPORT,
+    OPTION_PARALLEL_UNPACK,
+    OPTION_QMEM_HUGEPAGE,
+    OPTION_STACKFUL,
+    OPTION_STACK_SIZE,
+    OPTION_PARALLEL_INIT,
+    OPTION_SAVE_MODEL,
+    OPTION_LOAD_MODEL,
+    OPTION_CHECKPOINT,
+    OPTION_RESTART,
+    OPTION_SAVE_PROFILE,
+    OPTION_LOAD_PROFILE,
+    OPTION_RETUNE,
+    OPTION_TRACE,
+    OPTION_TRACE_WINDOW,
     OPTION_TOTAL // total number of options
   };
   struct CommandLineOptionStruct {
@@ -75,6 +97,23 @@ class Universe {
   static VirtualTime args_endtime; // set by ssf_start()
   static double args_speedup; // simtime/realtime; set by ssf_start()
   static VirtualTime args_time_slice;
+  static int args_transport; // type of transport between machines
+  static bool args_parallel_unpack; // let each universe unpack the events from remote machines
+  static bool args_qmem_hugepage; // back quick memory chunks with huge pages
+  static bool args_stackful; // run processes on their own stacks by default
+  static long args_stack_size; // size of the stack for each stackful process (in bytes)
+  static bool args_parallel_init; // call the init() methods of entities in parallel
+  static STRING args_save_model; // file to save the model snapshot (with machine rank appended)
+  static STRING args_load_model; // file to load the model snapshot (with machine rank appended)
+  static STRING args_checkpoint; // file to save the checkpoints (with machine rank appended)
+  static VirtualTime args_checkpoint_interval; // simulation time between checkpoints
+  static STRING args_restart; // file of the checkpoint to restart from (with machine rank appended)
+  static STRING args_save_profile; // file to save the alignment profile (with machine rank appended)
+  static STRING args_load_profile; // file to load the alignment profile (with machine rank appended)
+  static VirtualTime args_retune_interval; // simulation time between re-evaluations of the thresholds (0 if never)
+  static STRING args_trace; // file to save the trace records (with machine rank appended)
+  static VirtualTime args_trace_start; // start of the simulation time to be traced
+  static VirtualTime args_trace_end; // end of the simulation time to be traced
 
   static int total_num_procs; // this is to cache the total number of processors for all machines
 
@@ -87,11 +126,29 @@ class Universe {
   /****** quick memory: quick_memory.cc ******/
 
  public:
-  char* qmem_chunklist;
-  long qmem_poolsize; // the watermark of quick memory
-  char* qmem_poolbegin;
-  char* qmem_poolend;
-  void** qmem_freelist;
+  char* qmem_chunklist; // all memory chunks owned by this universe
+  long qmem_poolsize; // bytes of memory chunks resident in memory
+  void** qmem_partial; // for each size class, the chunks with free blocks
+  char* qmem_idle; // chunks with no live blocks (still resident)
+  char* qmem_released; // chunks with no live blocks and given back to the system
+  int qmem_nidle; // number of idle chunks
+  long* qmem_live; // for each size class, bytes of live blocks
+  long* qmem_peak; // for each size class, the high watermark of live bytes
+
+  // memory blocks owned by this universe but freed by other
+  // universes are pushed onto this lock-free stack; the owner drains
+  // the whole stack at once when it runs out of free blocks
+  void* qmem_remotefree;
+
+  long qmem_inuse; // bytes of quick memory handed out from this pool
+  long qmem_highwater; // the high watermark of qmem_inuse
+  unsigned long qmem_drift_out; // number of blocks freed here but owned by other universes
+  unsigned long qmem_drift_in; // number of blocks returned by other universes
+
+  /****** stacks of stackful processes: coroutine.cc ******/
+
+ public:
+  VECTOR(char*) stack_pool; // free stacks (each with a guard page below)
 
   /****** mapping and alignment: universe_mapping.cc ******/
 
@@ -102,28 +159,50 @@ class Universe {
     inChannel* ic;
     STRING icname;
     VirtualTime delay;
+    int seqno; // the order of the request (for merging those wired in parallel)
     MapRequest* next;
     MapRequest(outChannel* myoc, inChannel* myic, VirtualTime mydelay) :
-      oc(myoc), ic(myic), delay(mydelay), next(0) {}
+      oc(myoc), ic(myic), delay(mydelay), seqno(0), next(0) {}
     MapRequest(outChannel* myoc, STRING myicname, VirtualTime mydelay) :
-      oc(myoc), ic(0), icname(myicname), delay(mydelay), next(0) {}
+      oc(myoc), ic(0), icname(myicname), delay(mydelay), seqno(0), next(0) {}
   };
 
   SET(Timeline*) timelines; // timelines belonging to this universe
 
+  // when the universes initialize the model concurrently, the
+  // entities, mapping requests and stargates created by each universe
+  // are staged here and merged afterwards in the same order as if
+  // they were created sequentially
+  VECTOR(Entity*) staged_entities; // entities created by init() called at this universe
+  MapRequest* staged_mapreq_head; // mapping requests made or to be wired by this universe
+  MapRequest* staged_mapreq_tail;
+  MapRequest* staged_rmap_head; // mapping requests to remote machines wired by this universe
+  MapRequest* staged_rmap_tail;
+  MAP(PAIR(int,int),PAIR(int,Stargate*)) staged_stargates; // stargates created (and the mapping requests creating them)
+  int staged_seqno; // the mapping request being wired
+
   static SET(Timeline*) created_timelines; // all timelines that have already been created
   static MAP(PAIR(int,int),Stargate*) created_stargates; // all stargates that have already been created
   static SET(Entity*) orphan_entities; // entities that haven't been aligned
   static VECTOR(Entity*) created_entities; // entities created during the last round
-  static MAP(STRING,inChannel*) local_icmap; // public named inchannel on this machine
-  static MAP(STRING,int) remote_icmap; // public named inchannel from remote machine
-  static VECTOR(inChannel*) named_inchannels_vector; // used temporarily 
+  static UNORDERED_MAP(STRING,inChannel*) local_icmap; // public named inchannel on this machine
+  static UNORDERED_MAP(STRING,int) remote_icmap; // public named inchannel from remote machine (only those mapped to)
+  static UNORDERED_MAP(STRING,int) directory_icmap; // public named inchannels whose names hash to this machine
   static int* timeline_scans; // ranges of timeline serial numbers
   static MapRequest* mapreq_head; // outChannel::mapto requests are stored here
   static MapRequest* mapreq_tail; // as a linked list
-  static MAP(int,VECTOR(PAIR(MapInport*,Stargate*))*) starmap; // a mapping from outport id to receiving elements
+  static MAP(int,VECTOR(MapStarport)*) starmap; // a mapping from outport id to receiving elements
+
+  static bool init_concurrent; // true if the universes are initializing the model concurrently
+  static ssf_thread_mutex_t init_mutex; // protects the kernel data structures when initializing concurrently
+  static VECTOR(Entity*) init_entities; // entities whose init() methods are called in the current round
+  static UNORDERED_MAP(Entity*,int) entity_births; // the order of entities (only for parallel init or profiling)
 
  public:
+  // lock the kernel data structures only when initializing concurrently
+  static void init_lock() { if(init_concurrent) ssf_thread_mutex_lock(&init_mutex); }
+  static void init_unlock() { if(init_concurrent) ssf_thread_mutex_unlock(&init_mutex); }
+
   void assign_timeline(Timeline* tmln); // add a timeline to this universe
 
   static Timeline* create_timeline(); // create a timeline
@@ -132,16 +211,100 @@ class Universe {
   static Stargate* find_stargate(int srcid, int tgtid); // return the stargate already created if there is
   static void register_orphan_entity(Entity* ent); // entities are created as orphan
   static void deregister_orphan_entity(Entity* ent); // no longer orphan when the entity is aligned
-  static void register_named_inchannel(inChannel* ic); // all named inchannel must register
+  static void register_named_inchannel(inChannel* ic, const char* name); // all named inchannel must register
   static void add_mapping(outChannel* oc, inChannel* ic, VirtualTime delay);
   static void add_mapping(outChannel* oc, STRING icname, VirtualTime delay);
-  static void synchronize_inchannel_names(); // distribute public inchannel names
-  static void wire_up_channels(); // settle all channel mapping requests
+  static void append_mapping(MapRequest* req); // queue the mapping request in the order it's made
+  static void synchronize_inchannel_names(); // distribute public inchannel names to the directory
+  static void resolve_inchannel_names(); // look up the remote inchannels mapped to in the directory
+  static void distribute_mappings(); // hand the mapping requests to the universes owning the outchannels
+  void wire_up_local_channels(); // settle the mapping requests from this universe (called in parallel)
+  static void wire_up_remote_channels(); // merge the results and settle the mappings among machines
 
   static int timeline_to_machine(int sno); // map from timeline serial number to where it's located
   static void map_local_local(outChannel* oc, inChannel* ic, VirtualTime delay);
   static void map_local_remote(outChannel* oc, int timelineno, VirtualTime& delay); // the delay becomes extra delay afterwards
   static void map_remote_local(int tmlnid, int outportno, inChannel* ic, VirtualTime xdelay);
+  static void settle_remote_outports(outChannel* oc); // choose the outports carrying events to remote machines
+  static void settle_starmap(); // calculate the offsets for fanning out events from remote machines
+
+  /****** model snapshot: universe_snapshot.cc ******/
+
+ protected:
+  static VECTOR(Entity*) snapshot_entities; // all entities in the order their init() methods are called
+  static VECTOR(STRING) snapshot_states; // the entity states to be saved (in the same order)
+  static VECTOR(PAIR(const char*,int)) snapshot_blobs; // the entity states in the loaded snapshot
+  static VECTOR(Timeline*) snapshot_timelines; // the timelines restored from the snapshot (in order)
+
+ public:
+  static bool snapshot_enabled() { return !args_save_model.empty() || !args_load_model.empty(); }
+  static void open_model_snapshot(); // map the snapshot file into memory and read the entity states
+  static void add_snapshot_entities(); // append the entities whose init() are called in this round
+  static void serialize_entity(int idx); // let the entity (of this round) save or restore its state
+  static void restore_timelines(); // create, number, and assign timelines as in the snapshot
+  static void restore_channels(); // recreate the stargates and channel mappings from the snapshot
+  static void save_model_snapshot(); // write the wired-up model to the snapshot file
+
+  /****** checkpoint and restart: universe_checkpoint.cc ******/
+
+ protected:
+  static VirtualTime checkpoint_time; // time of the next checkpoint
+  static bool checkpoint_skipped; // a processor can't be checkpointed at this time (set by processor 0)
+  bool checkpoint_refused; // this universe can't be checkpointed at this time (set at each checkpoint)
+  static int checkpoint_generation; // the checkpoint files are written alternately in two generations
+  static VirtualTime restart_time; // time of the checkpoint restarted from (0 if not restarting)
+  static VirtualTime restart_local_thresh; // local threshold in effect at the checkpoint
+  static VirtualTime restart_global_thresh; // global threshold in effect at the checkpoint
+
+  // an inport is identified in the checkpoint by the outport number
+  // of the chain it belongs to and its position in the chain
+  static MAP(PAIR(int,int),MapInport*) checkpoint_chains; // (outport number, target timeline id) to inport chain
+  static UNORDERED_MAP(MapInport*,PAIR(int,int)) checkpoint_inports; // inport to (outport number, position)
+
+ public:
+  static void index_checkpoint_inports(); // find all inport chains on this machine (by processor 0)
+  static void open_checkpoint(); // read the checkpoint index and check it against the simulation
+  bool checkpoint_due(); // whether to take a checkpoint at this synchronization point
+  bool restartable(); // whether the processes and events of this universe can be restarted from a checkpoint
+  void save_checkpoint(VirtualTime l_thresh, VirtualTime g_thresh); // write the state of this universe
+  void commit_checkpoint(VirtualTime l_thresh, VirtualTime g_thresh); // make the new checkpoint visible (by processor 0)
+  void restore_checkpoint(); // replace the initial state of this universe with that in the checkpoint
+
+  /****** alignment profile: universe_profile.cc ******/
+
+ public:
+  static bool profile_enabled() { return !args_save_profile.empty() || !args_load_profile.empty(); }
+  static void save_profile(); // write the events and traffic of the timelines on this machine (by processor 0)
+  static void apply_profile(metis_graph_t* graph); // weigh the auto-alignment graph with the loaded profile
+
+  /****** online retuning of thresholds: universe_retune.cc ******/
+
+ public:
+  static bool retune_enabled(); // whether the thresholds found by training are re-evaluated during simulation
+  static bool retune_changed; // whether a different threshold is to be tried at this synchronization point
+  void retune_thresholds(VirtualTime l_opt, VirtualTime g_opt); // re-evaluate at a synchronization point (by processor 0)
+  void retune_apply(VirtualTime& l_opt, VirtualTime& g_opt); // reclassify the channels with the new threshold (by processor 0)
+
+  // measured by each universe for retuning
+  int64 retune_sync_wait; // wall-clock time spent at synchronization points (in nanoseconds)
+  int64 retune_block_wait; // wall-clock time blocked for lbts to advance (in nanoseconds)
+  unsigned long retune_windows; // number of synchronization windows
+  unsigned long retune_busy_windows; // number of windows in which the simulation clock advanced
+
+  /****** event tracing: universe_trace.cc ******/
+
+ public:
+  static void open_trace(); // open the trace file and create the buffers of the transport (by processor 0)
+  static void close_trace(); // write out the buffers of the transport and close the trace file
+  void set_trace_window(VirtualTime from, VirtualTime to); // trace the window if it overlaps with the time to be traced
+
+  TraceBuffer* trace_buffer; // the records of this universe (if tracing)
+  TraceBuffer* tracer; // same as trace_buffer if the current window is traced, otherwise null
+  static TraceBuffer* send_trace_buffer; // the records of the transport sending batches
+  static TraceBuffer* recv_trace_buffer; // the records of the transport receiving batches
+  static bool trace_transport; // whether the current window of processor 0 is traced (read by the transport)
+  static TraceBuffer* transport_tracer(TraceBuffer* buf) { 
+    return __atomic_load_n(&trace_transport, __ATOMIC_RELAXED) ? buf : 0; }
 
   /******* parallel universe: universe.cc ******/
 
@@ -167,6 +330,28 @@ class Universe {
   void local_init();
   void local_wrapup();
   void run(VirtualTime t, double s);
+  void initialize_model(); // call init() of entities and wire up channels (by all universes)
+  static void merge_staged_entities(); // collect entities and mapping requests made by init() in parallel
+  static void settle_timelines(); // create, align, and number timelines, and assign them to universes
+  static void list_created_timelines(VECTOR(Timeline*)& tmlns); // in a deterministic order
+  static metis_graph_t* build_timeline_graph(const VECTOR(Timeline*)& tmlns); // connect the timelines by the mapping requests
+  static void report_partition(const char* what, metis_graph_t* graph, int nparts); // print the links cut by the partitioning
+  static void distribute_timelines(const VECTOR(Timeline*)& tmlns, const VECTOR(int)* owners = 0); // assign them to universes (in blocks by default)
+  static void report_model_footprint(); // print model size and memory per entity after init
+
+  // the phases of model initialization (whose wall clock time is reported)
+  enum {
+    INIT_PHASE_BUILD     = 0, // from ssf_init() to ssf_start()
+    INIT_PHASE_ENTITIES  = 1, // calling init() of entities
+    INIT_PHASE_TIMELINES = 2, // creating, aligning, and numbering timelines
+    INIT_PHASE_NAMES     = 3, // exchanging public inchannel names
+    INIT_PHASE_WIRING    = 4, // settling channel mappings
+    INIT_PHASE_DELAYS    = 5, // finding channel delays for training thresholds
+    INIT_PHASE_STARTUP   = 6, // scheduling init events and starting up
+    INIT_PHASE_TOTAL     = 7
+  };
+  static int64 init_phase_end[INIT_PHASE_TOTAL]; // wall clock time at the end of each phase
+  static void end_init_phase(int phase) { init_phase_end[phase] = ssf_wallclock_in_nanoseconds(); }
 
   // return the stage of the simulation
   static bool is_uninitialized() { return sim_state == SIM_STATE_UNINITIALIZED; }
@@ -180,10 +365,31 @@ class Universe {
  protected:
   static int64 start_wallclock_time;
   static int64 time0, time1, time2;
+  static int64 init_resident_memory; // resident memory before the model is built
 
   static VirtualTime epoch_length; // global synchronization window size
   static VirtualTime decade_length; // local synchronization window size
-  static ChannelEvent*** switch_board; // for exchanging synchronous events between universes
+
+  // the switch board is for exchanging synchronous events between
+  // universes at the local window edge: there's a single-producer
+  // single-consumer ring of event pointers for each pair of universes
+  // (switch_board[i*args_nprocs+j] from universe i to universe j), so
+  // that a universe can take the events sent to it while the others
+  // are still sending; head and tail are the total number of events
+  // taken and put in the ring; the events that can't fit are chained
+  // in the overflow list, which is taken only after the producer is
+  // done with the round
+  struct SwitchRing {
+    int64 head; // written only by the consumer
+    char head_padding[SSF_CACHE_LINE_SIZE];
+    int64 tail; // written only by the producer
+    ChannelEvent* overflow; // written only by the producer (before it's done)
+    char tail_padding[SSF_CACHE_LINE_SIZE];
+    ChannelEvent* slots[SWITCH_RING_SIZE];
+  };
+  static SwitchRing* switch_board;
+  int64 switch_rounds; // number of rounds this universe is done sending events via the switch board
+  bool* switch_done; // which producers are done in the current round (allocated once, for all rounds)
   VirtualTime synpoint; // lower bound of the current synchronization window
   VirtualTime next_decade, next_epoch; // upper bounds of the current local and global synchronization windows
   bool decade_sync, epoch_sync; // indicate whether the window is in a sync boundary
@@ -196,7 +402,7 @@ class Universe {
 
   TimelineQueue runnable_timelines;
   TimelineQueue paced_timelines;
-  SET(Timeline*) blocked_timelines;
+  int blocked_timelines; // number of timelines in STATE_WAITING (the state tells membership)
   
   // each processor (other than processor 0) maintains a mailbox to
   // store the channel events sent from remote machines, which are
@@ -208,7 +414,6 @@ class Universe {
   ChainedEvent* mailbox;
   ChainedEvent* mailbox_tail;
 
-#ifdef HAVE_MPI_H
   static ssf_thread_mutex_t remote_mailbox_mutex;
   static ssf_thread_cond_t remote_mailbox_cond;
   static ChainedEvent* remote_mailbox;
@@ -219,7 +424,8 @@ class Universe {
   //static bool irecv_posted;
   //static MPI_Request irecv_request;
   static char* recvbuf;
-#endif
+  static int* splitpos; // the packing position of the split batch for each universe
+  static char** splitbuf; // the split batch for each universe
 
  public:
   // the main timeline dispatching loop
@@ -267,21 +473,25 @@ class Universe {
   // insert an emulated event at the designated timeline
   static void insert_emulated_event(Timeline* tmln, EmulatedEvent* evt);
 
-#ifdef HAVE_MPI_H
   void transport_message(ChannelEvent* evt); // transport event from one machine to another; get it to writer thread
   void transport_reduce_message(); // wait until all transient messages are done with
-  void transport_barrier_message(); // do a global barrier
   void transport_terminal_message(); // send special event to inform the writer thread to terminate
 
-  static int* rscnt; // used by reduce scatter
-  static int64** sndcnt; // sndcnt[i][j]: the number of channel events sent from processor i to machine j
-  static int64 rcvcnt; // the total number of channel events received by the reader thread
-  static int64 rcvcnt_target; // the number of channel events to be received before signaling the conditional variable
+  // each batch starts with the epoch round in which its events were
+  // sent; the writer (or r/w) thread moves on to the next round when
+  // it comes across the epoch marker left in the remote mailbox, and
+  // the receiver counts events separately for the current and the
+  // next round (a machine can't be more than one round ahead, since
+  // the reduce scatter needs everyone)
+  static Transport* transport; // carries event batches between machines
+  static int64** sndcnt; // sndcnt[i][j]: the number of channel events sent from processor i to machine j in this round
+  static int send_round; // the round of the batches being sent out
+  static int recv_round; // the round processor 0 is waiting to complete
+  static int64 rcvcnt[2]; // the number of channel events received for (even and odd) rounds
+  static int64 rcvcnt_target; // the number of channel events to be received in recv_round (-1 if not yet known)
   static ssf_thread_mutex_t rcvcnt_mutex;
   static ssf_thread_cond_t rcvcnt_cond;
-  static ssf_thread_cond_t bar_cond;
   static bool scatter_reduce_carry_on;
-  static bool barrier_carry_on;
 
   // either one thread for both sending and receiving events; or a
   // separate thread for sending and receiving events
@@ -294,8 +504,13 @@ class Universe {
   static void writer_thread();
 
   static void handle_incoming_events(int rbfsz);
+  static int split_incoming_events(int pos, int rbfsz); // start after the round number; return the number of events in the batch
+  static void deliver_incoming_event(ChannelEvent* evt, Universe* univ);
+  static void deliver_incoming_null(int outportno, Timestamp ts, Universe* univ);
+  static bool is_incoming_target(Stargate* sg, Universe* univ);
+  void unpack_channel_batch(ChannelBatchEvent* batch);
   static bool handle_outgoing_events(ChannelEvent* evt);
-#endif
+  static void pack_outgoing_event(ChannelEvent* evt, SET(int)& rankset);
 
   // send and receive external events (emulation events or events from
   // other processors or machines)
@@ -303,6 +518,8 @@ class Universe {
 
   // called within main sync loop
   void synchronize_events();
+  void dispatch_local_events(ChannelEvent* evts); // deliver events from local binque to other processors
+  void dispatch_global_events(ChannelEvent* evts); // deliver events from global binque to remote machines
 
  public:
   //  collect statistics
@@ -330,13 +547,15 @@ class metis_node_t {
  public:
   metis_node_t(int id, int size, Timeline* tm);
   ~metis_node_t();
-  void add_link(metis_node_t* node, double delay);
+  bool add_link(metis_node_t* node, double delay); // return true if it's a new link
 
   int id;
-  int size;
+  int size; // the load, balanced among the partitions
+  int memory; // the number of model elements, also balanced
   Timeline* timeline; // maintains a context pointer for referencing
   int part;
   MAP(metis_node_t*,double) links;
+  MAP(metis_node_t*,int) traffic; // link weights from the profile (if weighted)
 };
 
 class metis_graph_t {
@@ -348,10 +567,13 @@ class metis_graph_t {
   void add_link(int idfrom, int idto, double delay);
   void partition(int numparts);
   void minmax_delays();
-  int fx(double delay);
+  int cost(double delay); // the weight of a link if it's cut (higher for smaller delay)
 
   int nlinks;
-  double min_delay, max_delay;
+  double min_delay, max_delay; // min_delay is the smallest positive delay
+  bool weighted; // if true, the node sizes and link traffic come from the profile
+  int cut_links; // number of linked node pairs in different partitions
+  double cut_delay; // min delay of the links between partitions (1e38 if none)
   VECTOR(metis_node_t*) nodes;
 };
 
@@ -2,6 +2,9 @@
 #include "ssf.h"
 
 #define METIS_USE_RECURSIVE
+#define METIS_MAX_EDGE_WEIGHT 16384 // weight of the link with the smallest delay
+#define METIS_MAX_TOTAL_WEIGHT 1e9 // keep the sum of link weights within an int
+#define METIS_IMBALANCE 1.05 // load imbalance tolerated for each constraint
 extern "C" {
 #include "kernel/metis/metis.h"
 }
@@ -9,19 +12,20 @@ extern "C" {
 namespace minissf {
 
 metis_node_t::metis_node_t(int _id, int _size, Timeline* tm) : 
-  id(_id), size(_size), timeline(tm), part(0) {}
+  id(_id), size(_size), memory(_size), timeline(tm), part(0) {}
 
 metis_node_t::~metis_node_t() { links.clear(); }
 
-void metis_node_t::add_link(metis_node_t* tnode, double delay) 
+bool metis_node_t::add_link(metis_node_t* tnode, double delay) 
 {
   MAP(metis_node_t*,double)::iterator iter = links.find(tnode);
-  if(iter == links.end()) links.insert(MAKE_PAIR(tnode, delay));
-  else if(delay < (*iter).second) (*iter).second = delay;
+  if(iter == links.end()) { links.insert(MAKE_PAIR(tnode, delay)); return true; }
+  if(delay < (*iter).second) (*iter).second = delay;
+  return false;
 }
 
 metis_graph_t::metis_graph_t() : 
-  nlinks(0), min_delay(1e38), max_delay(0) {}
+  nlinks(0), min_delay(1e38), max_delay(0), weighted(false), cut_links(0), cut_delay(1e38) {}
 
 metis_graph_t::~metis_graph_t() 
 {
@@ -43,8 +47,7 @@ void metis_graph_t::add_link(int idfrom, int idto, double delay)
   assert(0 <= idfrom && idfrom < (int)nodes.size());
   assert(0 <= idto && idto < (int)nodes.size());
   assert(idfrom != idto);
-  nodes[idfrom]->add_link(nodes[idto], delay);
-  nlinks++;
+  if(nodes[idfrom]->add_link(nodes[idto], delay)) nlinks++; // duplicates are merged
 }
 
 void metis_graph_t::minmax_delays() 
@@ -53,22 +56,21 @@ void metis_graph_t::minmax_delays()
       niter != nodes.end(); niter++) {
     for(MAP(metis_node_t*,double)::iterator liter = (*niter)->links.begin();
 	liter != (*niter)->links.end(); liter++) {
-      if(min_delay > (*liter).second) min_delay = (*liter).second;
+      // zero-delay links are left out; they get the maximum weight anyway
+      if((*liter).second > 0 && min_delay > (*liter).second) min_delay = (*liter).second;
       if(max_delay < (*liter).second) max_delay = (*liter).second;
     }
   }
 }
 
-int metis_graph_t::fx(double delay) 
+int metis_graph_t::cost(double delay) 
 {
-  int ret;
-  if(max_delay == min_delay) ret = 0;
-  else {
-    double x = (max_delay-delay)/(max_delay-min_delay); x += 1.0;
-    x = pow(x, 0.25); // make it favorable to large delays
-    ret = (int)(x*16384);
-  }
-  return ret;
+  // cutting a link caps the synchronization window at its delay, and
+  // the number of windows (thus barriers) grows with the inverse of
+  // the window; the link with the smallest delay costs the most, and
+  // a link with no delay costs as much (it's never worth cutting)
+  if(delay <= 0 || min_delay > delay) return 1+METIS_MAX_EDGE_WEIGHT;
+  return 1+(int)(METIS_MAX_EDGE_WEIGHT*min_delay/delay);
 }
 
 void metis_graph_t::partition(int nparts) 
@@ -76,61 +78,85 @@ void metis_graph_t::partition(int nparts)
   minmax_delays();
 
   int i, n = nodes.size(); 
+  cut_links = 0;
+  cut_delay = 1e38;
+  for(i=0; i<n; i++) nodes[i]->part = 0;
+  if(nparts == 1) return; // we don't do anything since the graph is initialized this way
+
+  // metis requires a symmetric adjacency: the weights of the links in
+  // both directions between two nodes are added up
+  VECTOR(MAP(int,double)) adj(n);
+  double total = 0;
+  for(i=0; i<n; i++) {
+    metis_node_t* node = nodes[i];
+    for(MAP(metis_node_t*,double)::iterator f_iter = node->links.begin();
+	f_iter != node->links.end(); f_iter++) {
+      double w;
+      if(weighted) {
+	MAP(metis_node_t*,int)::iterator t_iter = node->traffic.find((*f_iter).first);
+	w = (t_iter != node->traffic.end()) ? (*t_iter).second : 1;
+      } else w = cost((*f_iter).second);
+      adj[i][(*f_iter).first->id] += w;
+      adj[(*f_iter).first->id][i] += w;
+      total += 2*w;
+    }
+  }
+  double scale = (total > METIS_MAX_TOTAL_WEIGHT) ? METIS_MAX_TOTAL_WEIGHT/total : 1;
+
+  int x = 0;
+  for(i=0; i<n; i++) x += adj[i].size();
   idxtype *xadj = new idxtype[n+1];
-  xadj[0] = 0;
-  idxtype* adjncy = nlinks ? new idxtype[nlinks] : 0;
-  idxtype* adjwgt = nlinks ? new idxtype[nlinks] : 0;
-  int wgtflag = 3;
+  idxtype* adjncy = x ? new idxtype[x] : 0;
+  idxtype* adjwgt = x ? new idxtype[x] : 0;
+  xadj[0] = x = 0;
+  for(i=0; i<n; i++) {
+    for(MAP(int,double)::iterator a_iter = adj[i].begin(); a_iter != adj[i].end(); a_iter++) {
+      adjncy[x] = (*a_iter).first;
+      adjwgt[x] = 1+(idxtype)((*a_iter).second*scale);
+      x++;
+    }
+    xadj[i+1] = x;
+  }
+
+  // two constraints are balanced: the load (the size of the node),
+  // and the memory (the number of model elements)
+  int ncon = 2;
+  idxtype* vwgt = new idxtype[n*ncon];
+  for(i=0; i<n; i++) {
+    vwgt[i*ncon] = nodes[i]->size;
+    vwgt[i*ncon+1] = nodes[i]->memory;
+  }
+  int wgtflag = x ? 3 : 2;
   int numflag = 0;
   int options[5]; options[0] = 0;
   int edgecut;
-  idxtype* vwgt = new idxtype[n];
   idxtype* part = new idxtype[n];
 
-  float* tpwgts = new float[nparts];
-  for(i=0; i<nparts; i++) tpwgts[i] = 1.0/nparts;
-
   // partition among the machines
-  if(nparts == 1) {
-    // we don't do anything since the graph is initialized this way
+  if(nparts <= 8) {
+    METIS_mCPartGraphRecursive(&n, &ncon, xadj, adjncy, vwgt, adjwgt, &wgtflag,
+			       &numflag, &nparts, options, &edgecut, part);
   } else {
-    int x = 0;
-    VECTOR(metis_node_t*)::iterator iter;
-    for(iter = nodes.begin(), i=0; iter != nodes.end(); iter++, i++) {
-      metis_node_t* node = (*iter);
-      vwgt[i] = node->size;
-      if(min_delay < max_delay) {
-	for(MAP(metis_node_t*,double)::iterator f_iter = node->links.begin();
-	    f_iter != node->links.end(); f_iter++) {
-	  idxtype edge = (idxtype)fx((*f_iter).second);
-	  adjncy[x] = (*f_iter).first->id;
-	  adjwgt[x] = edge;
-	  x++;
-	}
-      }
-      xadj[i+1] = x;
-    }
-    assert(x == 0 || x == nlinks);
-    
-    if(x == 0) wgtflag = 2;
-    if(nparts <= 8) {
-      METIS_WPartGraphRecursive(&n, xadj, x>0?adjncy:0, vwgt, x>0?adjwgt:0, &wgtflag,
-				&numflag, &nparts, tpwgts, options, &edgecut, part);
-    } else {
-      METIS_WPartGraphKway(&n, xadj, x>0?adjncy:0, vwgt, x>0?adjwgt:0, &wgtflag,
-			   &numflag, &nparts, tpwgts, options, &edgecut, part);
-    }
-    
-    i = 0;
-    for(iter = nodes.begin(); iter != nodes.end(); iter++) {
-      (*iter)->part = part[i++];
+    float ubvec[2] = { METIS_IMBALANCE, METIS_IMBALANCE };
+    METIS_mCPartGraphKway(&n, &ncon, xadj, adjncy, vwgt, adjwgt, &wgtflag,
+			  &numflag, &nparts, ubvec, options, &edgecut, part);
+  }
+  for(i=0; i<n; i++) nodes[i]->part = part[i];
+
+  // report how well the lookahead is kept within the partitions
+  for(i=0; i<n; i++) {
+    for(MAP(int,double)::iterator a_iter = adj[i].begin(); a_iter != adj[i].end(); a_iter++)
+      if(i < (*a_iter).first && part[i] != part[(*a_iter).first]) cut_links++;
+    for(MAP(metis_node_t*,double)::iterator f_iter = nodes[i]->links.begin();
+	f_iter != nodes[i]->links.end(); f_iter++) {
+      if(part[i] != (*f_iter).first->part && (*f_iter).second < cut_delay)
+	cut_delay = (*f_iter).second;
     }
   }
 
   delete[] xadj;
   if(adjncy) delete[] adjncy;
   if(adjwgt) delete[] adjwgt;
-  delete[] tpwgts;
   delete[] vwgt;
   delete[] part;
 }
@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel/universe.h"
+#include "ssf.h"
+
+namespace minissf {
+
+// a checkpoint is taken at a synchronization barrier, where all
+// timelines have processed the events before the barrier; the events
+// kept in the binques and the stargate mailboxes are first delivered
+// to the target timelines, so that the state of the simulation
+// consists only of the state of the entities and the channel events
+// in the event lists of the timelines (the processes are started over
+// at restart, so the checkpoint is skipped unless they are all waiting
+// on inchannels and no timer is running); the checkpoint is saved in
+// binary files in the native byte order (to be restarted on the same
+// platform), one for each processor and an index for each machine:
+//   1) the index has the magic string, format version, number of
+//      machines, machine rank, number of processors, the time of the
+//      checkpoint, the local and global thresholds, and the
+//      generation of the processor files;
+//   2) each processor file has the magic string, format version,
+//      machine rank, processor id, the time of the checkpoint, and
+//      the number of timelines; for each timeline (in order of serial
+//      numbers), its serial number, number of entities, and for each
+//      entity, the serial number, the next event id, and the state
+//      (as length and bytes), followed by the channel events (in
+//      timestamp order), each with the timestamp, the inport (as the
+//      outport number of the chain and the position in the chain),
+//      and the event (as class id, length, and bytes).
+// the processor files are written alternately in two generations,
+// so that the previous checkpoint remains intact until the index is
+// replaced with the new one
+#define CHECKPOINT_MAGIC "MSSFCKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_EVTSIZ 65536 // max size of a packed event
+
+VirtualTime Universe::checkpoint_time(0);
+bool Universe::checkpoint_skipped = false;
+int Universe::checkpoint_generation = 0;
+VirtualTime Universe::restart_time(0);
+VirtualTime Universe::restart_local_thresh(0);
+VirtualTime Universe::restart_global_thresh(0);
+MAP(PAIR(int,int),MapInport*) Universe::checkpoint_chains;
+UNORDERED_MAP(MapInport*,PAIR(int,int)) Universe::checkpoint_inports;
+
+static void put_bytes(FILE* fptr, const void* p, size_t n, const STRING& fname)
+{
+  if(fwrite(p, 1, n, fptr) != n) SSF_THROW("can't write checkpoint: " << fname);
+}
+
+static void put_int(FILE* fptr, int x, const STRING& fname) { put_bytes(fptr, &x, sizeof(int), fname); }
+
+static void put_time(FILE* fptr, VirtualTime t, const STRING& fname)
+{
+  int64 x = t.get_ticks();
+  put_bytes(fptr, &x, sizeof(int64), fname);
+}
+
+static void get_bytes(FILE* fptr, void* p, size_t n, const STRING& fname)
+{
+  if(fread(p, 1, n, fptr) != n)
+    SSF_THROW("corrupted checkpoint: unexpected end of file: " << fname);
+}
+
+static int get_int(FILE* fptr, const STRING& fname) { int x; get_bytes(fptr, &x, sizeof(int), fname); return x; }
+
+static VirtualTime get_time(FILE* fptr, const STRING& fname)
+{
+  int64 x; get_bytes(fptr, &x, sizeof(int64), fname);
+  VirtualTime t; t.set_ticks(x); return t;
+}
+
+// the file name of the processor of the given generation
+static STRING checkpoint_file(const STRING& fname, int gen, int pid)
+{
+  std::stringstream ss(std::stringstream::in | std::stringstream::out);
+  ss << fname << "." << gen << "." << pid;
+  return ss.str();
+}
+
+void Universe::index_checkpoint_inports()
+{
+  // the mappings are fixed once the model is wired up
+  if(!checkpoint_inports.empty()) return;
+
+  // the inport chains from the outchannels on this machine
+  for(int i=0; i<args_nprocs; i++) {
+    Universe* univ = parallel_universe[i];
+    for(SET(Timeline*)::iterator tmln_iter = univ->timelines.begin();
+	tmln_iter != univ->timelines.end(); tmln_iter++) {
+      Timeline* tmln = *tmln_iter;
+      for(VECTOR(Entity*)::iterator ent_iter = tmln->entities.begin();
+	  ent_iter != tmln->entities.end(); ent_iter++) {
+	for(VECTOR(outChannel*)::iterator oc_iter = (*ent_iter)->outchannels.begin();
+	    oc_iter != (*ent_iter)->outchannels.end(); oc_iter++) {
+	  outChannel* oc = *oc_iter;
+	  for(MapOutport* op = oc->outports; op; op = op->next) {
+	    if(!op->inport) continue; // to a remote machine
+	    Timeline* target = op->stargate ? op->stargate->target_timeline : tmln;
+	    assert(target);
+	    PAIR(int,int) key = MAKE_PAIR(oc->portno, target->serialno);
+	    if(!checkpoint_chains.insert(MAKE_PAIR(key, op->inport)).second) assert(0);
+	    int pos = 0;
+	    for(MapInport* p = op->inport; p; p = p->next)
+	      checkpoint_inports[p] = MAKE_PAIR(oc->portno, pos++);
+	  }
+	}
+      }
+    }
+  }
+
+  // the inport chains from the outchannels on remote machines
+  for(MAP(int,VECTOR(MapStarport)*)::iterator iter = starmap.begin();
+      iter != starmap.end(); iter++) {
+    VECTOR(MapStarport)* vec = (*iter).second; assert(vec);
+    for(VECTOR(MapStarport)::iterator s_iter = vec->begin(); s_iter != vec->end(); s_iter++) {
+      if(!(*s_iter).inport) continue;
+      assert((*s_iter).stargate && (*s_iter).stargate->target_timeline);
+      PAIR(int,int) key = MAKE_PAIR((*iter).first, (*s_iter).stargate->target_timeline->serialno);
+      if(!checkpoint_chains.insert(MAKE_PAIR(key, (*s_iter).inport)).second) assert(0);
+      int pos = 0;
+      for(MapInport* p = (*s_iter).inport; p; p = p->next)
+	checkpoint_inports[p] = MAKE_PAIR((*iter).first, pos++);
+    }
+  }
+}
+
+bool Universe::checkpoint_due()
+{
+  // on more than one machine, only the global synchronization
+  // barrier is shared by all processors
+  return !args_checkpoint.empty() && training_finished &&
+    checkpoint_time <= synpoint && synpoint < args_endtime &&
+    (args_nmachs == 1 || epoch_sync);
+}
+
+bool Universe::restartable()
+{
+  // the processes are started over at restart, which is only right
+  // if they are waiting for events on the inchannels (or haven't run
+  // yet); a timer, a timed wait or a semaphore wait would be lost
+  for(SET(Timeline*)::iterator tmln_iter = timelines.begin();
+      tmln_iter != timelines.end(); tmln_iter++) {
+    Timeline* tmln = *tmln_iter;
+    for(KernelEvent* e = (KernelEvent*)tmln->evtlist.getMin(); e;
+	e = (KernelEvent*)tmln->evtlist.getNext(e))
+      if(!e->is_channel_event() && !e->is_recreated()) return false;
+    for(VECTOR(Entity*)::iterator ent_iter = tmln->entities.begin();
+	ent_iter != tmln->entities.end(); ent_iter++) {
+      for(VECTOR(Process*)::iterator p_iter = (*ent_iter)->processes.begin();
+	  p_iter != (*ent_iter)->processes.end(); p_iter++) {
+	Process* p = *p_iter;
+	if(p->process_state == Process::PROCESS_STATE_CREATING) continue;
+	if(p->process_state == Process::PROCESS_STATE_WAITING && !p->hold_event &&
+	   (p->waiton_count || p->static_sensitivity)) continue;
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+void Universe::save_checkpoint(VirtualTime l_thresh, VirtualTime g_thresh)
+{
+  // the checkpoint is skipped (rather than aborting the run) unless
+  // all processors on all machines can be restarted from it; the
+  // events in the binques are all channel events, so the timelines
+  // can be checked before the events are delivered
+  checkpoint_refused = !restartable();
+  ssf_barrier();
+  if(!processor_id) {
+    int refused = 0;
+    for(int i=0; i<args_nprocs; i++)
+      if(parallel_universe[i]->checkpoint_refused) refused = 1;
+    if(args_nmachs > 1) {
+      int x = refused;
+      transport->allreduce(&x, &refused, 1, Transport::REDUCE_MAX);
+    }
+    checkpoint_skipped = (refused != 0);
+    if(checkpoint_skipped) {
+      if(!args_rank)
+	fprintf(stderr, "WARNING: checkpoint at %lg (s) skipped: timers, timed waits or "
+		"semaphore waits are pending\n", synpoint.second());
+      while(checkpoint_time <= synpoint) checkpoint_time += args_checkpoint_interval;
+    }
+  }
+  ssf_barrier();
+  if(checkpoint_skipped) return;
+
+  // the events in the binques are delivered ahead of time; the target
+  // timelines won't process them until they reach the time
+  if(local_binque) dispatch_local_events(local_binque->retrieve_all_events());
+  if(global_binque) dispatch_global_events(global_binque->retrieve_all_events());
+
+  // so are the events waiting in the mailboxes of the stargates (once
+  // all processors have passed the barrier)
+  ssf_barrier();
+  for(SET(Timeline*)::iterator tmln_iter = timelines.begin();
+      tmln_iter != timelines.end(); tmln_iter++) {
+    Timeline* tmln = *tmln_iter;
+    for(VECTOR(Stargate*)::iterator sg_iter = tmln->inbound.begin();
+	sg_iter != tmln->inbound.end(); sg_iter++)
+      (*sg_iter)->receive_messages();
+  }
+  if(!processor_id) index_checkpoint_inports();
+  ssf_barrier();
+
+  STRING fname = checkpoint_file(args_checkpoint, checkpoint_generation, processor_id);
+  FILE* fptr = fopen(fname.c_str(), "wb");
+  if(!fptr) SSF_THROW("can't open checkpoint: " << fname);
+  put_bytes(fptr, CHECKPOINT_MAGIC, 8, fname);
+  put_int(fptr, CHECKPOINT_VERSION, fname);
+  put_int(fptr, args_rank, fname);
+  put_int(fptr, processor_id, fname);
+  put_time(fptr, synpoint, fname);
+
+  MAP(int,Timeline*) tmlns; // in order of serial numbers
+  for(SET(Timeline*)::iterator tmln_iter = timelines.begin();
+      tmln_iter != timelines.end(); tmln_iter++)
+    tmlns.insert(MAKE_PAIR((*tmln_iter)->serialno, *tmln_iter));
+  put_int(fptr, (int)tmlns.size(), fname);
+
+  char* buf = new char[CHECKPOINT_EVTSIZ]; assert(buf);
+  for(MAP(int,Timeline*)::iterator tmln_iter = tmlns.begin();
+      tmln_iter != tmlns.end(); tmln_iter++) {
+    Timeline* tmln = (*tmln_iter).second;
+    put_int(fptr, tmln->serialno, fname);
+    put_int(fptr, (int)tmln->entities.size(), fname);
+    for(VECTOR(Entity*)::iterator ent_iter = tmln->entities.begin();
+	ent_iter != tmln->entities.end(); ent_iter++) {
+      Entity* ent = *ent_iter;
+      STRING state;
+      Snapshot snapshot(&state, true);
+      ent->serialize(&snapshot);
+      put_int(fptr, ent->serialno, fname);
+      put_int(fptr, ent->nxtevtid, fname);
+      put_int(fptr, (int)state.length(), fname);
+      put_bytes(fptr, state.data(), state.length(), fname);
+    }
+
+    // the event list is walked in order without taking out the events
+    for(KernelEvent* e = (KernelEvent*)tmln->evtlist.getMin(); e;
+	e = (KernelEvent*)tmln->evtlist.getNext(e)) {
+      if(!e->is_channel_event()) continue;
+      ChannelEvent* chevt = (ChannelEvent*)e;
+      Event* evt = chevt->get_event(); assert(evt);
+      UNORDERED_MAP(MapInport*,PAIR(int,int))::iterator ip_iter = checkpoint_inports.find(chevt->get_inport());
+      assert(ip_iter != checkpoint_inports.end());
+      int siz = evt->pack(buf, CHECKPOINT_EVTSIZ);
+      if(siz < 0 || siz > CHECKPOINT_EVTSIZ)
+	SSF_THROW("event too large for checkpoint: " << siz << " bytes");
+      Timestamp ts = chevt->time();
+      put_int(fptr, 1, fname); // more event
+      put_bytes(fptr, &ts.key1, sizeof(int64), fname);
+      put_bytes(fptr, &ts.key2, sizeof(uint32), fname);
+      put_bytes(fptr, &ts.key3, sizeof(uint32), fname);
+      put_int(fptr, (*ip_iter).second.first, fname);
+      put_int(fptr, (*ip_iter).second.second, fname);
+      put_int(fptr, evt->event_class_ident(), fname);
+      put_int(fptr, siz, fname);
+      put_bytes(fptr, buf, siz, fname);
+    }
+    put_int(fptr, 0, fname); // end of events
+  }
+  delete[] buf;
+  if(fclose(fptr)) SSF_THROW("can't write checkpoint: " << fname);
+
+  ssf_barrier();
+  if(!processor_id) commit_checkpoint(l_thresh, g_thresh);
+  ssf_barrier();
+}
+
+void Universe::commit_checkpoint(VirtualTime l_thresh, VirtualTime g_thresh)
+{
+  assert(!processor_id);
+
+  // the index is replaced only after all machines have written the
+  // processor files of the new checkpoint
+  if(args_nmachs > 1) transport->barrier();
+
+  STRING tmpname = args_checkpoint+".tmp";
+  FILE* fptr = fopen(tmpname.c_str(), "wb");
+  if(!fptr) SSF_THROW("can't open checkpoint: " << tmpname);
+  put_bytes(fptr, CHECKPOINT_MAGIC, 8, tmpname);
+  put_int(fptr, CHECKPOINT_VERSION, tmpname);
+  put_int(fptr, args_nmachs, tmpname);
+  put_int(fptr, args_rank, tmpname);
+  put_int(fptr, args_nprocs, tmpname);
+  put_time(fptr, synpoint, tmpname);
+  put_time(fptr, l_thresh, tmpname);
+  put_time(fptr, g_thresh, tmpname);
+  put_int(fptr, checkpoint_generation, tmpname);
+  if(fclose(fptr)) SSF_THROW("can't write checkpoint: " << tmpname);
+  if(rename(tmpname.c_str(), args_checkpoint.c_str()))
+    SSF_THROW("can't write checkpoint: " << args_checkpoint);
+
+  if(!args_rank && (args_debug_mask&DEBUG_FLAG_BRIEF) != 0)
+    printf("[ CHECKPOINT: %lg (s) ]\n", synpoint.second());
+  checkpoint_generation = 1-checkpoint_generation;
+  while(checkpoint_time <= synpoint) checkpoint_time += args_checkpoint_interval;
+}
+
+void Universe::open_checkpoint()
+{
+  FILE* fptr = fopen(args_restart.c_str(), "rb");
+  if(!fptr) SSF_THROW("can't open checkpoint: " << args_restart);
+  char magic[8];
+  get_bytes(fptr, magic, 8, args_restart);
+  if(memcmp(magic, CHECKPOINT_MAGIC, 8) || get_int(fptr, args_restart) != CHECKPOINT_VERSION)
+    SSF_THROW("not a checkpoint: " << args_restart);
+  int nmachs = get_int(fptr, args_restart);
+  int rank = get_int(fptr, args_restart);
+  int nprocs = get_int(fptr, args_restart);
+  if(nmachs != args_nmachs || rank != args_rank || nprocs != args_nprocs)
+    SSF_THROW("checkpoint " << args_restart << " is for machine " << rank << " of " << nmachs
+	      << " with " << nprocs << " processors");
+  restart_time = get_time(fptr, args_restart);
+  restart_local_thresh = get_time(fptr, args_restart);
+  restart_global_thresh = get_time(fptr, args_restart);
+  int gen = get_int(fptr, args_restart);
+  fclose(fptr);
+  if(restart_time <= 0 || restart_time >= args_endtime)
+    SSF_THROW("checkpoint " << args_restart << " at " << restart_time.second()
+	      << " is beyond the simulation end time");
+  if(gen != 0 && gen != 1) SSF_THROW("corrupted checkpoint: " << args_restart);
+
+  // all machines must restart from the same checkpoint
+  if(args_nmachs > 1) {
+    int64 t[2], u[2];
+    t[0] = restart_time.get_ticks(); t[1] = -t[0];
+    transport->allreduce(t, u, 2, Transport::REDUCE_MIN);
+    if(u[0] != -u[1]) SSF_THROW("checkpoints of the machines are taken at different times");
+  }
+
+  // the new checkpoints won't overwrite the one restarted from
+  checkpoint_generation = 1-gen;
+}
+
+void Universe::restore_checkpoint()
+{
+  if(!processor_id) {
+    open_checkpoint();
+    index_checkpoint_inports();
+  }
+  ssf_barrier();
+
+  STRING fname = checkpoint_file(args_restart, 1-checkpoint_generation, processor_id);
+  FILE* fptr = fopen(fname.c_str(), "rb");
+  if(!fptr) SSF_THROW("can't open checkpoint: " << fname);
+  char magic[8];
+  get_bytes(fptr, magic, 8, fname);
+  if(memcmp(magic, CHECKPOINT_MAGIC, 8) || get_int(fptr, fname) != CHECKPOINT_VERSION)
+    SSF_THROW("not a checkpoint: " << fname);
+  int rank = get_int(fptr, fname);
+  int pid = get_int(fptr, fname);
+  VirtualTime t = get_time(fptr, fname);
+  if(rank != args_rank || pid != processor_id || t != restart_time)
+    SSF_THROW("checkpoint " << fname << " does not match the index");
+
+  MAP(int,Timeline*) tmlns; // by serial numbers
+  for(SET(Timeline*)::iterator tmln_iter = timelines.begin();
+      tmln_iter != timelines.end(); tmln_iter++)
+    tmlns.insert(MAKE_PAIR((*tmln_iter)->serialno, *tmln_iter));
+  if(get_int(fptr, fname) != (int)tmlns.size())
+    SSF_THROW("checkpoint does not match the model: different number of timelines");
+
+  VECTOR(char) buf;
+  for(int i=0; i<(int)tmlns.size(); i++) {
+    MAP(int,Timeline*)::iterator tmln_iter = tmlns.find(get_int(fptr, fname));
+    if(tmln_iter == tmlns.end())
+      SSF_THROW("checkpoint does not match the model: unknown timeline");
+    Timeline* tmln = (*tmln_iter).second;
+    if(get_int(fptr, fname) != (int)tmln->entities.size())
+      SSF_THROW("checkpoint does not match the model: different entities on timeline " << tmln->serialno);
+
+    // the timeline starts over from the time of the checkpoint (the
+    // events scheduled before are kept by the entities at this point)
+    tmln->evtlist.clear();
+    tmln->simclock = tmln->lbts = restart_time;
+    if(args_progress_interval > 0) {
+      int64 intv = args_progress_interval.get_ticks();
+      VirtualTime tick; tick.set_ticks((restart_time.get_ticks()+intv-1)/intv*intv);
+      if(tick < args_endtime) tmln->insert_event(new TickEvent(tick));
+    }
+
+    for(VECTOR(Entity*)::iterator ent_iter = tmln->entities.begin();
+	ent_iter != tmln->entities.end(); ent_iter++) {
+      Entity* ent = *ent_iter;
+      if(get_int(fptr, fname) != ent->serialno)
+	SSF_THROW("checkpoint does not match the model: different entities on timeline " << tmln->serialno);
+      int nxtevtid = get_int(fptr, fname);
+      int len = get_int(fptr, fname);
+      if(len < 0) SSF_THROW("corrupted checkpoint: " << fname);
+      buf.resize(len+1);
+      get_bytes(fptr, &buf[0], len, fname);
+
+      // the events scheduled and the writes made by init() are
+      // dropped, and the processes are started over
+      if(ent->init_state) {
+	for(VECTOR(KernelEvent*)::iterator e_iter = ent->init_state->events.begin();
+	    e_iter != ent->init_state->events.end(); e_iter++) {
+	  (*e_iter)->discard();
+	  delete *e_iter;
+	}
+	for(VECTOR(EmulatedEvent*)::iterator ee_iter = ent->init_state->emu_events.begin();
+	    ee_iter != ent->init_state->emu_events.end(); ee_iter++)
+	  delete *ee_iter;
+	for(VECTOR(Entity::InitWrite)::iterator w_iter = ent->init_state->writes.begin();
+	    w_iter != ent->init_state->writes.end(); w_iter++)
+	  Event::release_event((*w_iter).evt);
+	delete ent->init_state; ent->init_state = 0;
+      }
+      for(VECTOR(Process*)::iterator p_iter = ent->processes.begin();
+	  p_iter != ent->processes.end(); p_iter++) {
+	ProcessEvent* pevt = new ProcessEvent(*p_iter); assert(pevt);
+	pevt->setTime(Timestamp(restart_time, 0, 0)); // ahead of other events at the same time
+	tmln->insert_event(pevt);
+      }
+      ent->nxtevtid = nxtevtid;
+      Snapshot snapshot(&buf[0], len, true);
+      ent->serialize(&snapshot);
+    }
+
+    while(get_int(fptr, fname)) {
+      Timestamp ts;
+      get_bytes(fptr, &ts.key1, sizeof(int64), fname);
+      get_bytes(fptr, &ts.key2, sizeof(uint32), fname);
+      get_bytes(fptr, &ts.key3, sizeof(uint32), fname);
+      int portno = get_int(fptr, fname);
+      int pos = get_int(fptr, fname);
+      int ident = get_int(fptr, fname);
+      int siz = get_int(fptr, fname);
+      if(siz < 0) SSF_THROW("corrupted checkpoint: " << fname);
+      buf.resize(siz+1);
+      get_bytes(fptr, &buf[0], siz, fname);
+
+      MAP(PAIR(int,int),MapInport*)::iterator c_iter =
+	checkpoint_chains.find(MAKE_PAIR(portno, tmln->serialno));
+      if(c_iter == checkpoint_chains.end())
+	SSF_THROW("checkpoint does not match the model: unknown mapping to timeline " << tmln->serialno);
+      MapInport* inport = (*c_iter).second;
+      for(int k=0; k<pos && inport; k++) inport = inport->next;
+      if(!inport) SSF_THROW("checkpoint does not match the model: unknown mapping to timeline " << tmln->serialno);
+      Event* evt = Event::create_registered_event(ident, &buf[0], siz);
+      if(!evt) SSF_THROW("can't create event of class " << ident << " from checkpoint");
+      ChannelEvent* chevt = new ChannelEvent(ts, evt, inport); assert(chevt);
+      tmln->insert_event(chevt);
+    }
+  }
+  fclose(fptr);
+}
+
+}; /*namespace minissf*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
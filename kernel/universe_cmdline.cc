@@ -25,6 +25,23 @@ VirtualTime Universe::args_progress_interval;
 VirtualTime Universe::args_endtime;
 double Universe::args_speedup;
 VirtualTime Universe::args_time_slice;
+int Universe::args_transport;
+bool Universe::args_parallel_unpack;
+bool Universe::args_qmem_hugepage;
+bool Universe::args_stackful;
+long Universe::args_stack_size;
+bool Universe::args_parallel_init;
+STRING Universe::args_save_model;
+STRING Universe::args_load_model;
+STRING Universe::args_checkpoint;
+VirtualTime Universe::args_checkpoint_interval;
+STRING Universe::args_restart;
+STRING Universe::args_save_profile;
+STRING Universe::args_load_profile;
+VirtualTime Universe::args_retune_interval;
+STRING Universe::args_trace;
+VirtualTime Universe::args_trace_start;
+VirtualTime Universe::args_trace_end;
 
 int Universe::total_num_procs = 0;
 
@@ -53,6 +70,36 @@ Universe::CommandLineOptionStruct Universe::command_option_array[] = {
     "--set-training-len <L> : set min threshold training duration (default is 5% of simulation time)" },
   { Universe::OPTION_TIMESLICE, "-e",
     "-e <E> : set time slice for scheduling timelines" },
+  { Universe::OPTION_TRANSPORT, "--transport",
+    "--transport <X> : set transport between machines (X=mpi, tcp, or shm; by default, X=mpi)" },
+  { Universe::OPTION_PARALLEL_UNPACK, "--parallel-unpack",
+    "--parallel-unpack : let each processor unpack its own events received from remote machines" },
+  { Universe::OPTION_QMEM_HUGEPAGE, "--qmem-hugepage",
+    "--qmem-hugepage : back quick memory with huge pages (memory is then not returned to system until the end)" },
+  { Universe::OPTION_STACKFUL, "--stackful",
+    "--stackful : run processes on their own stacks by default (no need for source code translation)" },
+  { Universe::OPTION_STACK_SIZE, "--stack-size",
+    "--stack-size <K> : set stack size of each stackful process in KB (by default, K=128)" },
+  { Universe::OPTION_PARALLEL_INIT, "--parallel-init",
+    "--parallel-init : call init() of entities on all processors in parallel (init() must be thread-safe)" },
+  { Universe::OPTION_SAVE_MODEL, "--save-model",
+    "--save-model <F> : save a snapshot of the model to file once it's initialized and wired up" },
+  { Universe::OPTION_LOAD_MODEL, "--load-model",
+    "--load-model <F> : restore the alignment and channel mappings of the model from a snapshot file" },
+  { Universe::OPTION_CHECKPOINT, "--checkpoint",
+    "--checkpoint <F> <T> : save a checkpoint of the simulation to file every T seconds of simulation time" },
+  { Universe::OPTION_RESTART, "--restart",
+    "--restart <F> : restart the simulation from the checkpoint saved in the file" },
+  { Universe::OPTION_SAVE_PROFILE, "--save-profile",
+    "--save-profile <F> : save the events and traffic of the timelines to file at the end for auto-alignment" },
+  { Universe::OPTION_LOAD_PROFILE, "--load-profile",
+    "--load-profile <F> : weigh auto-alignment with the events and traffic in the profile of a previous run" },
+  { Universe::OPTION_RETUNE, "--retune",
+    "--retune <T> : re-evaluate the synchronization thresholds every T seconds of simulation time after training" },
+  { Universe::OPTION_TRACE, "--trace",
+    "--trace <F> : save binary trace records of timeline scheduling and synchronization to file (see bin/trace2json.pl)" },
+  { Universe::OPTION_TRACE_WINDOW, "--trace-window",
+    "--trace-window <S> <E> : trace only the synchronization windows between S and E seconds of simulation time" },
   { Universe::OPTION_ENDOFOPT, "--",
     "-- : end of parsing minissf command-line (after which user options may start without conflicts)" },
   { Universe::OPTION_NONE, 0, "" }
@@ -80,6 +127,27 @@ int Universe::parse_command_line(int& argc, char**& argv)
   VirtualTime a_l = 0; // training length
   int a_a = 1; // auto alignment
   VirtualTime a_e = VirtualTime::INFINITY; // time slice
+#ifdef HAVE_MPI_H
+  int a_x = Transport::TRANSPORT_MPI; // transport type
+#else
+  int a_x = Transport::TRANSPORT_TCP; // transport type
+#endif
+  bool a_p = false; // parallel unpack
+  bool a_h = false; // quick memory in huge pages
+  bool a_c = false; // stackful processes
+  bool a_z = false; // parallel entity initialization
+  STRING a_w; // model snapshot to be saved
+  STRING a_r; // model snapshot to be loaded
+  STRING a_cf; // checkpoint file
+  VirtualTime a_ci = 0; // checkpoint interval
+  STRING a_rf; // checkpoint to restart from
+  STRING a_ps; // alignment profile to be saved
+  STRING a_pl; // alignment profile to be loaded
+  VirtualTime a_rt = 0; // retuning interval
+  STRING a_tf; // trace file
+  VirtualTime a_ts = 0; // start of traced simulation time
+  VirtualTime a_te = VirtualTime::INFINITY; // end of traced simulation time
+  long a_k = 128; // stack size in KB
 
   for(i=1; i<argc; i++) {
     CommandLineOptionStruct* p;
@@ -190,6 +258,103 @@ int Universe::parse_command_line(int& argc, char**& argv)
       OPTCHECK(a_e>0, "invalid time slice");
       break;
     }
+    case OPTION_TRANSPORT: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      if(!strcmp(argv[i], "mpi")) a_x = Transport::TRANSPORT_MPI;
+      else if(!strcmp(argv[i], "tcp")) a_x = Transport::TRANSPORT_TCP;
+      else if(!strcmp(argv[i], "shm")) a_x = Transport::TRANSPORT_SHM;
+      else OPTCHECK(0, "unknown transport");
+      break;
+    }
+    case OPTION_PARALLEL_UNPACK: {
+      a_p = true;
+      break;
+    }
+    case OPTION_QMEM_HUGEPAGE: {
+      a_h = true;
+      break;
+    }
+    case OPTION_STACKFUL: {
+      a_c = true;
+      break;
+    }
+    case OPTION_STACK_SIZE: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      OPTCHECK(ISINT(argv[i]), "invalid argument");
+      a_k = atol(argv[i]);
+      OPTCHECK(a_k>=16, "stack size too small");
+      break;
+    }
+    case OPTION_PARALLEL_INIT: {
+      a_z = true;
+      break;
+    }
+    case OPTION_SAVE_MODEL: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_w = argv[i];
+      break;
+    }
+    case OPTION_LOAD_MODEL: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_r = argv[i];
+      break;
+    }
+    case OPTION_CHECKPOINT: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_cf = argv[i];
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_ci.fromString(argv[i]);
+      OPTCHECK(a_ci>0, "invalid checkpoint interval");
+      break;
+    }
+    case OPTION_RESTART: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_rf = argv[i];
+      break;
+    }
+    case OPTION_SAVE_PROFILE: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_ps = argv[i];
+      break;
+    }
+    case OPTION_LOAD_PROFILE: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_pl = argv[i];
+      break;
+    }
+    case OPTION_RETUNE: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_rt.fromString(argv[i]);
+      OPTCHECK(a_rt>0, "invalid retuning interval");
+      break;
+    }
+    case OPTION_TRACE: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_tf = argv[i];
+      break;
+    }
+    case OPTION_TRACE_WINDOW: {
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_ts.fromString(argv[i]);
+      OPTCHECK(a_ts>=0, "invalid start of trace window");
+      ++i;
+      OPTCHECK(i<argc, "argument missing");
+      a_te.fromString(argv[i]);
+      OPTCHECK(a_te>a_ts, "invalid end of trace window");
+      break;
+    }
     case OPTION_ENDOFOPT: {
       ++i;
       goto stop;
@@ -211,7 +376,15 @@ int Universe::parse_command_line(int& argc, char**& argv)
   ssf_mpi_comm_size(MPI_COMM_WORLD, &args_nmachs);
   ssf_mpi_comm_rank(MPI_COMM_WORLD, &args_rank);
 #else
+  // without mpi, the machines are started separately, each told the
+  // number of machines and its own rank through the environment
   args_nmachs = 1; args_rank = 0;
+  char* nmachs_str = getenv("SSF_NMACHS");
+  char* rank_str = getenv("SSF_RANK");
+  if(nmachs_str) args_nmachs = atoi(nmachs_str);
+  if(rank_str) args_rank = atoi(rank_str);
+  if(args_nmachs < 1 || args_rank < 0 || args_rank >= args_nmachs)
+    SSF_THROW("bad environment: SSF_NMACHS=" << args_nmachs << ", SSF_RANK=" << args_rank);
 #endif
   args_mach_nprocs = new int[args_nmachs]; 
   assert(args_mach_nprocs);
@@ -250,6 +423,61 @@ int Universe::parse_command_line(int& argc, char**& argv)
   args_progress_interval = a_i;
   args_outfile = a_f;
   args_time_slice = a_e;
+  args_transport = a_x;
+  args_parallel_unpack = a_p;
+  args_qmem_hugepage = a_h;
+  args_stackful = a_c;
+  long pgsz = sysconf(_SC_PAGESIZE);
+  args_stack_size = (a_k*1024+pgsz-1)/pgsz*pgsz; // multiple of pages
+  args_parallel_init = a_z;
+
+  // like the output file, each machine has its own model snapshot
+  if(!a_w.empty()) {
+    std::stringstream ss(std::stringstream::in | std::stringstream::out);
+    ss << a_w;
+    if(args_nmachs > 1) ss << "-" << args_rank;
+    args_save_model = ss.str();
+  }
+  if(!a_r.empty()) {
+    std::stringstream ss(std::stringstream::in | std::stringstream::out);
+    ss << a_r;
+    if(args_nmachs > 1) ss << "-" << args_rank;
+    args_load_model = ss.str();
+  }
+  if(!a_cf.empty()) {
+    std::stringstream ss(std::stringstream::in | std::stringstream::out);
+    ss << a_cf;
+    if(args_nmachs > 1) ss << "-" << args_rank;
+    args_checkpoint = ss.str();
+  }
+  args_checkpoint_interval = a_ci;
+  if(!a_rf.empty()) {
+    std::stringstream ss(std::stringstream::in | std::stringstream::out);
+    ss << a_rf;
+    if(args_nmachs > 1) ss << "-" << args_rank;
+    args_restart = ss.str();
+  }
+  if(!a_ps.empty()) {
+    std::stringstream ss(std::stringstream::in | std::stringstream::out);
+    ss << a_ps;
+    if(args_nmachs > 1) ss << "-" << args_rank;
+    args_save_profile = ss.str();
+  }
+  if(!a_pl.empty()) {
+    std::stringstream ss(std::stringstream::in | std::stringstream::out);
+    ss << a_pl;
+    if(args_nmachs > 1) ss << "-" << args_rank;
+    args_load_profile = ss.str();
+  }
+  args_retune_interval = a_rt;
+  if(!a_tf.empty()) {
+    std::stringstream ss(std::stringstream::in | std::stringstream::out);
+    ss << a_tf;
+    if(args_nmachs > 1) ss << "-" << args_rank;
+    args_trace = ss.str();
+  }
+  args_trace_start = a_ts;
+  args_trace_end = a_te;
 
   if(!args_outfile.empty()) {
     std::stringstream ss(std::stringstream::in | std::stringstream::out);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <ctype.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -9,20 +10,23 @@
 namespace minissf {
 
 #define MAX_MPI_BUFSIZ 4096
-#define MAX_MPI_NNAMES 100
 #define MAX_MPI_NMAPS 100
 
 SET(Timeline*) Universe::created_timelines;
 MAP(PAIR(int,int),Stargate*) Universe::created_stargates;
 SET(Entity*) Universe::orphan_entities;
 VECTOR(Entity*) Universe::created_entities;
-MAP(STRING,inChannel*) Universe::local_icmap;
-MAP(STRING,int) Universe::remote_icmap;
-VECTOR(inChannel*) Universe::named_inchannels_vector;
+UNORDERED_MAP(STRING,inChannel*) Universe::local_icmap;
+UNORDERED_MAP(STRING,int) Universe::remote_icmap;
+UNORDERED_MAP(STRING,int) Universe::directory_icmap;
 int* Universe::timeline_scans = 0;
 Universe::MapRequest* Universe::mapreq_head = 0;
 Universe::MapRequest* Universe::mapreq_tail = 0;
-MAP(int,VECTOR(PAIR(MapInport*,Stargate*))*) Universe::starmap;
+MAP(int,VECTOR(MapStarport)*) Universe::starmap;
+bool Universe::init_concurrent = false;
+ssf_thread_mutex_t Universe::init_mutex;
+VECTOR(Entity*) Universe::init_entities;
+UNORDERED_MAP(Entity*,int) Universe::entity_births;
 
 void Universe::assign_timeline(Timeline* tmln) {
   timelines.insert(tmln);
@@ -41,28 +45,53 @@ void Universe::delete_timeline(Timeline* timeline) {
 }
 
 void Universe::register_stargate(Stargate* sg) {
-  created_stargates.insert(MAKE_PAIR(MAKE_PAIR(sg->source_timeline_id, sg->target_timeline_id), sg));
+  if(init_concurrent) {
+    // the stargate is created by the universe owning the source
+    // timeline; it's staged there with the mapping request creating it
+    Universe* univ = parallel_universe[ssf_processor_index()];
+    univ->staged_stargates.insert(MAKE_PAIR(MAKE_PAIR(sg->source_timeline_id, sg->target_timeline_id), 
+					    MAKE_PAIR(univ->staged_seqno, sg)));
+  } else
+    created_stargates.insert(MAKE_PAIR(MAKE_PAIR(sg->source_timeline_id, sg->target_timeline_id), sg));
 }
 
 Stargate* Universe::find_stargate(int src, int tgt) {
+  if(init_concurrent) {
+    // only the universe owning the source timeline could have created it
+    Universe* univ = parallel_universe[ssf_processor_index()];
+    MAP(PAIR(int,int),PAIR(int,Stargate*))::iterator iter = 
+      univ->staged_stargates.find(MAKE_PAIR(src,tgt));
+    if(iter != univ->staged_stargates.end()) return (*iter).second.second;
+  }
   MAP(PAIR(int,int),Stargate*)::iterator iter = created_stargates.find(MAKE_PAIR(src,tgt));
   if(iter != created_stargates.end()) return (*iter).second;
   else return 0;
 }
 
 void Universe::register_orphan_entity(Entity* ent) {
-  orphan_entities.insert(ent);
-  created_entities.push_back(ent);
+  if(init_concurrent) {
+    // created by init() called in parallel; staged to keep the order
+    parallel_universe[ssf_processor_index()]->staged_entities.push_back(ent);
+    init_lock();
+    orphan_entities.insert(ent);
+    init_unlock();
+  } else {
+    orphan_entities.insert(ent);
+    created_entities.push_back(ent);
+  }
 }
 
 void Universe::deregister_orphan_entity(Entity* ent) {
   orphan_entities.erase(ent);
 }
 
-void Universe::register_named_inchannel(inChannel* ic) {
-  if(!local_icmap.insert(MAKE_PAIR(ic->name, ic)).second)
-    SSF_THROW("duplicate inchannel name: " << ic->name);
-  named_inchannels_vector.push_back(ic);
+void Universe::register_named_inchannel(inChannel* ic, const char* name) {
+  // the name is kept only here (the inchannel itself doesn't need it
+  // once it's wired up)
+  init_lock();
+  bool inserted = local_icmap.insert(MAKE_PAIR(STRING(name), ic)).second;
+  init_unlock();
+  if(!inserted) SSF_THROW("duplicate inchannel name: " << name);
 }
 
 int Universe::timeline_to_machine(int sno) {
@@ -75,175 +104,313 @@ int Universe::timeline_to_machine(int sno) {
 
 void Universe::add_mapping(outChannel* oc, inChannel* ic, VirtualTime delay)
 {
-  MapRequest* req = new MapRequest(oc, ic, delay);
-  if(!mapreq_head) mapreq_head = mapreq_tail = req;
-  else { mapreq_tail->next = req; mapreq_tail = req; }
+  append_mapping(new MapRequest(oc, ic, delay));
 }
 
 void Universe::add_mapping(outChannel* oc, STRING icname, VirtualTime delay)
 {
-  MapRequest* req = new MapRequest(oc, icname, delay);
-  if(!mapreq_head) mapreq_head = mapreq_tail = req;
-  else { mapreq_tail->next = req; mapreq_tail = req; }
+  append_mapping(new MapRequest(oc, icname, delay));
 }
 
-void Universe::synchronize_inchannel_names()
+void Universe::append_mapping(MapRequest* req)
 {
-  if(args_nmachs == 1) { // nothing nneds to be done really if sequential
-    named_inchannels_vector.clear();
-    return; 
+  assert(req);
+  if(!args_load_model.empty()) {
+    // the mappings will be restored from the model snapshot
+    delete req;
+    return;
+  }
+  if(init_concurrent) {
+    // made by init() called in parallel; staged to keep the order
+    Universe* univ = parallel_universe[ssf_processor_index()];
+    if(!univ->staged_mapreq_head) univ->staged_mapreq_head = univ->staged_mapreq_tail = req;
+    else { univ->staged_mapreq_tail->next = req; univ->staged_mapreq_tail = req; }
+  } else {
+    if(!mapreq_head) mapreq_head = mapreq_tail = req;
+    else { mapreq_tail->next = req; mapreq_tail = req; }
   }
+}
 
-#ifdef HAVE_MPI_H
-  int nnames = named_inchannels_vector.size();
-  /*
-  if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
-    printf(">> [%d] synchronize %d ic names\n", args_rank, nnames);
-    for(int h=0; h<nnames; h++)
-      printf(">>  %d => %s\n", h, named_inchannels_vector[h]->name.c_str());
+// the directory of public inchannel names is partitioned among the
+// machines by hashing the names (fnv-1a, which must be the same on
+// all machines)
+static int inchannel_directory(const STRING& name, int nmachs)
+{
+  unsigned int h = 2166136261u;
+  for(STRING::const_iterator iter = name.begin(); iter != name.end(); iter++) {
+    h ^= (unsigned char)*iter;
+    h *= 16777619u;
   }
-  */
-  int maxnnames;
-  ssf_mpi_allreduce(&nnames, &maxnnames, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-  /*
-  if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) 
-    printf(">>  max names = %d\n", maxnnames);
-  */
-  if(maxnnames == 0) return;
+  return (int)(h%nmachs);
+}
+
+// append a packed string (and possibly an integer) to the buffer
+// going to a machine; the buffer grows as needed
+static void pack_name(VECTOR(char)& buf, int& pos, const STRING& name, int* sn = 0)
+{
+  int icnamelen = (int)name.length();
+  int need = pos+icnamelen+4*sizeof(int);
+  if((int)buf.size() < need) buf.resize(need > 2*(int)buf.size() ? need : 2*buf.size());
+  ssf_pack(&icnamelen, sizeof(icnamelen), &buf[0], buf.size(), &pos);
+  ssf_pack((char*)name.c_str(), icnamelen, &buf[0], buf.size(), &pos);
+  if(sn) ssf_pack(sn, sizeof(*sn), &buf[0], buf.size(), &pos);
+}
+
+static STRING unpack_name(char* buf, int bufsiz, int& pos)
+{
+  int icnamelen;
+  ssf_unpack(buf, bufsiz, &pos, &icnamelen, sizeof(icnamelen));
+  STRING name(icnamelen, 0);
+  if(icnamelen > 0)
+    ssf_unpack(buf, bufsiz, &pos, &name[0], icnamelen);
+  return name;
+}
+
+// send a buffer to each machine (including itself) and receive one
+// from each; returns the receive buffer (to be reclaimed by caller)
+// with the size and the offset of the data from each machine
+static char* exchange_buffers(VECTOR(char)* sbufs, int* sendcnt, int* recvcnt, int* rdisp, int nmachs)
+{
+  int* sdisp = new int[nmachs]; assert(sdisp);
+  int ssize = 0;
+  for(int i=0; i<nmachs; i++) { sdisp[i] = ssize; ssize += sendcnt[i]; }
+  char* sendbuf = new char[ssize+1]; assert(sendbuf);
+  for(int i=0; i<nmachs; i++)
+    if(sendcnt[i] > 0) memcpy(&sendbuf[sdisp[i]], &sbufs[i][0], sendcnt[i]);
+
+  Universe::transport->alltoall(sendcnt, sizeof(int), recvcnt);
+  int rsize = 0;
+  for(int i=0; i<nmachs; i++) { rdisp[i] = rsize; rsize += recvcnt[i]; }
+  char* recvbuf = new char[rsize+1]; assert(recvbuf);
+  Universe::transport->alltoallv(sendbuf, sendcnt, sdisp, recvbuf, recvcnt, rdisp);
+
+  delete[] sendbuf;
+  delete[] sdisp;
+  return recvbuf;
+}
+
+void Universe::synchronize_inchannel_names()
+{
+  if(args_nmachs == 1) return; // nothing needs to be done really if sequential
 
-  char* sendbuf = new char[MAX_MPI_BUFSIZ]; assert(sendbuf);
-  int* rcnts = new int[args_nmachs]; assert(rcnts);
+  // each public name is sent only to the machine keeping its part of
+  // the directory, rather than to all machines
+  VECTOR(char)* sbufs = new VECTOR(char)[args_nmachs]; assert(sbufs);
+  int* sendcnt = new int[args_nmachs]; assert(sendcnt);
+  int* recvcnt = new int[args_nmachs]; assert(recvcnt);
   int* rdisp = new int[args_nmachs]; assert(rdisp);
-  register int i, j, k;
-
-  // pack and send MAX_MPI_NNAMES names at a time
-  for(k=0; k<maxnnames; k+=MAX_MPI_NNAMES) {
-    int sendpos = 0;
-    int nn = k<nnames ? nnames-k : 0; if(nn > MAX_MPI_NNAMES) nn = MAX_MPI_NNAMES;
-    ssf_mpi_pack(&nn, 1, MPI_INT, sendbuf, MAX_MPI_BUFSIZ, &sendpos, MPI_COMM_WORLD);
-    if(nn > 0) {
-      for(i=k; i<k+nn; i++) {	
-	int icnamelen = (int)named_inchannels_vector[i]->name.length();
-	int sn = named_inchannels_vector[i]->entity_owner->timeline->serialno;
-	ssf_mpi_pack(&icnamelen, 1, MPI_INT, sendbuf, MAX_MPI_BUFSIZ, &sendpos, MPI_COMM_WORLD);
-	ssf_mpi_pack((char*)named_inchannels_vector[i]->name.c_str(), icnamelen, MPI_UNSIGNED_CHAR, 
-		     sendbuf, MAX_MPI_BUFSIZ, &sendpos, MPI_COMM_WORLD);
-	ssf_mpi_pack(&sn, 1, MPI_INT, sendbuf, MAX_MPI_BUFSIZ, &sendpos, MPI_COMM_WORLD);
-      }
-    }
-    ssf_mpi_allgather(&sendpos, 1, MPI_INT, rcnts, 1, MPI_INT, MPI_COMM_WORLD);
-    rdisp[0] = 0;
-    for(i=1; i<args_nmachs; i++)
-      rdisp[i] = rdisp[i-1]+rcnts[i-1];
-    int rsize = rdisp[args_nmachs-1]+rcnts[args_nmachs-1];
-    /*
-    if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
-      printf(">> [%d] sendpos=%d\n", args_rank, sendpos);
-      for(i=0; i<args_nmachs; i++)
-	printf(">> [%d] rcnts[%d]=%d, rdisp[%d]=%d\n", args_rank,
-	       i, rcnts[i], i, rdisp[i]);
-      //printf("%d: send data:\n", args_rank);
-      //for(i=0; i<sendpos; i++) printf("%02x ", unsigned(sendbuf[i]&0xff)); 
-      //printf("\n");
+  memset(sendcnt, 0, args_nmachs*sizeof(int));
+
+  for(UNORDERED_MAP(STRING,inChannel*)::iterator iter = local_icmap.begin();
+      iter != local_icmap.end(); iter++) {
+    int mach = inchannel_directory((*iter).first, args_nmachs);
+    int sn = (*iter).second->entity_owner->timeline->serialno;
+    pack_name(sbufs[mach], sendcnt[mach], (*iter).first, &sn);
+  }
+  char* recvbuf = exchange_buffers(sbufs, sendcnt, recvcnt, rdisp, args_nmachs);
+  delete[] sbufs;
+
+  for(int i=0; i<args_nmachs; i++) {
+    char* buf = &recvbuf[rdisp[i]];
+    int bufsiz = recvcnt[i];
+    int pos = 0;
+    while(pos < bufsiz) {
+      STRING icname = unpack_name(buf, bufsiz, pos);
+      int sn;
+      ssf_unpack(buf, bufsiz, &pos, &sn, sizeof(sn));
+      assert(timeline_to_machine(sn) == i);
+      // names are unique on each machine; a duplicate can only come
+      // from another machine
+      if(!directory_icmap.insert(MAKE_PAIR(icname, sn)).second)
+	SSF_THROW("duplicate inchannel name: " << icname);
     }
-    */
-    char* recvbuf = new char[rsize]; assert(recvbuf);
-    ssf_mpi_allgatherv(sendbuf, sendpos, MPI_PACKED,
-		       recvbuf, rcnts, rdisp, MPI_PACKED, MPI_COMM_WORLD);
-    //if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
-    //  printf("%d: recv data:\n", args_rank);
-    //  for(i=0; i<rsize; i++) printf("%02x ", unsigned(recvbuf[i]&0xff));
-    //  printf("\n");
-    //}
+  }
 
-    for(i=0; i<args_nmachs; i++) {
-      if(i == args_rank) continue;
-      char* buf = &recvbuf[rdisp[i]];
-      int bufsiz = rcnts[i];
-      int pos = 0;
-      int nnames;
-      ssf_mpi_unpack(buf, bufsiz, &pos, &nnames, 1, MPI_INT, MPI_COMM_WORLD);
-      /*
-      if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
-	printf(">> [%d] got %d public names from %d\n", args_rank, nnames, i);
-      }
-      */
-      for(j=0; j<nnames; j++) {
-	int icnamelen;
-	ssf_mpi_unpack(buf, bufsiz, &pos, &icnamelen, 1, MPI_INT, MPI_COMM_WORLD);
-	char* icname = new char[icnamelen+1]; assert(icname);
-	int sn;
-	ssf_mpi_unpack(buf, bufsiz, &pos, icname, icnamelen, MPI_UNSIGNED_CHAR, MPI_COMM_WORLD);
-	ssf_mpi_unpack(buf, bufsiz, &pos, &sn, 1, MPI_INT, MPI_COMM_WORLD);
-	icname[icnamelen] = 0;
+  delete[] recvbuf;
+  delete[] sendcnt;
+  delete[] recvcnt;
+  delete[] rdisp;
+}
 
-	if(!remote_icmap.insert(std::make_pair(icname, sn)).second)
-	  SSF_THROW("duplicate inchannel name: " << icname);
-	assert(timeline_to_machine(sn) == i);
-	/*
-	if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
-	  printf(">>   %d: %s => %d\n", j, icname, sn);
-	}
-	*/
-	delete[] icname;
-      }
+void Universe::resolve_inchannel_names()
+{
+  if(args_nmachs == 1) return;
+
+  // ask the directory only for the names mapped to, which are not
+  // local, each name once
+  VECTOR(char)* sbufs = new VECTOR(char)[args_nmachs]; assert(sbufs);
+  VECTOR(int*)* queries = new VECTOR(int*)[args_nmachs]; assert(queries);
+  int* sendcnt = new int[args_nmachs]; assert(sendcnt);
+  int* recvcnt = new int[args_nmachs]; assert(recvcnt);
+  int* rdisp = new int[args_nmachs]; assert(rdisp);
+  memset(sendcnt, 0, args_nmachs*sizeof(int));
+
+  for(MapRequest* req = mapreq_head; req; req = req->next) {
+    if(req->ic || local_icmap.find(req->icname) != local_icmap.end()) continue;
+    PAIR(UNORDERED_MAP(STRING,int)::iterator,bool) ret = 
+      remote_icmap.insert(MAKE_PAIR(req->icname, -1));
+    if(ret.second) {
+      int mach = inchannel_directory(req->icname, args_nmachs);
+      pack_name(sbufs[mach], sendcnt[mach], req->icname);
+      queries[mach].push_back(&(*ret.first).second); // the answer comes back in the same order
     }
-    delete[] recvbuf;
   }
-  named_inchannels_vector.clear();
+  char* recvbuf = exchange_buffers(sbufs, sendcnt, recvcnt, rdisp, args_nmachs);
+
+  // answer the queries from the directory (-1 if unknown)
+  memset(sendcnt, 0, args_nmachs*sizeof(int));
+  for(int i=0; i<args_nmachs; i++) {
+    sbufs[i].clear();
+    char* buf = &recvbuf[rdisp[i]];
+    int bufsiz = recvcnt[i];
+    int pos = 0;
+    while(pos < bufsiz) {
+      STRING icname = unpack_name(buf, bufsiz, pos);
+      UNORDERED_MAP(STRING,int)::iterator iter = directory_icmap.find(icname);
+      int sn = (iter != directory_icmap.end()) ? (*iter).second : -1;
+      if((int)sbufs[i].size() < sendcnt[i]+(int)sizeof(int)*2) 
+	sbufs[i].resize(2*sbufs[i].size()+sizeof(int)*2);
+      ssf_pack(&sn, sizeof(sn), &sbufs[i][0], sbufs[i].size(), &sendcnt[i]);
+    }
+  }
+  delete[] recvbuf;
+  directory_icmap.clear();
+  recvbuf = exchange_buffers(sbufs, sendcnt, recvcnt, rdisp, args_nmachs);
+  delete[] sbufs;
+
+  for(int i=0; i<args_nmachs; i++) {
+    char* buf = &recvbuf[rdisp[i]];
+    int bufsiz = recvcnt[i];
+    int pos = 0;
+    for(VECTOR(int*)::iterator iter = queries[i].begin(); 
+	iter != queries[i].end(); iter++)
+      ssf_unpack(buf, bufsiz, &pos, *iter, sizeof(**iter));
+    assert(pos == bufsiz);
+  }
 
-  delete[] sendbuf;
-  delete[] rcnts;
+  delete[] recvbuf;
+  delete[] queries;
+  delete[] sendcnt;
+  delete[] recvcnt;
   delete[] rdisp;
-#endif
 }
 
-void Universe::wire_up_channels()
+void Universe::distribute_mappings()
 {
-  int rmap_cnt = 0;
-  MapRequest* rmap_head = 0;
-  MapRequest* rmap_tail = 0;
-
+  // each mapping request is wired by the universe owning the
+  // outchannel, in the order the requests were made
+  int seqno = 0;
   MapRequest* node = mapreq_head;
   while(node) {
     MapRequest* req = node;
     node = req->next;
+    req->seqno = seqno++;
+    req->next = 0;
+    Universe* univ = req->oc->entity_owner->timeline->universe; assert(univ);
+    if(!univ->staged_mapreq_head) univ->staged_mapreq_head = univ->staged_mapreq_tail = req;
+    else { univ->staged_mapreq_tail->next = req; univ->staged_mapreq_tail = req; }
+  }
+  mapreq_head = mapreq_tail = 0;
+}
+
+void Universe::wire_up_local_channels()
+{
+  // the outports of the outchannels and the stargates from the
+  // timelines of this universe are created here; the maps are read
+  // only at this point
+  MapRequest* node = staged_mapreq_head;
+  staged_mapreq_head = staged_mapreq_tail = 0;
+  while(node) {
+    MapRequest* req = node;
+    node = req->next;
+    staged_seqno = req->seqno;
     if(req->ic) { 
       map_local_local(req->oc, req->ic, req->delay); 
       delete req;
     } else {
-      MAP(STRING,inChannel*)::iterator iter = local_icmap.find(req->icname);
+      UNORDERED_MAP(STRING,inChannel*)::iterator iter = local_icmap.find(req->icname);
       if(iter != local_icmap.end()) {
 	map_local_local(req->oc, (*iter).second, req->delay);
 	delete req;
       } else {
-	MAP(STRING,int)::iterator iter = remote_icmap.find(req->icname);
-	if(iter == remote_icmap.end()) 
+	UNORDERED_MAP(STRING,int)::iterator iter = remote_icmap.find(req->icname);
+	if(iter == remote_icmap.end() || (*iter).second < 0) 
 	  SSF_THROW("mapto unknown inchannel: " << req->icname);
 	// delay becomes initial min delay or extra delay!!!
 	map_local_remote(req->oc, (*iter).second, req->delay); 
 
 	// add to the link for further operations
-	rmap_cnt++;
 	req->next = 0;
-	if(!rmap_head) rmap_head = rmap_tail = req;
-	else { rmap_tail->next = req; rmap_tail = req; }
+	if(!staged_rmap_head) staged_rmap_head = staged_rmap_tail = req;
+	else { staged_rmap_tail->next = req; staged_rmap_tail = req; }
       }
     }
   }
-  mapreq_head = mapreq_tail = 0;
+
+  // now that the min_offsets are settled, decide which outport
+  // carries the events to each remote machine
+  SET(outChannel*) rmap_ocs;
+  for(node = staged_rmap_head; node; node = node->next) rmap_ocs.insert(node->oc);
+  for(SET(outChannel*)::iterator oc_iter = rmap_ocs.begin(); 
+      oc_iter != rmap_ocs.end(); oc_iter++)
+    settle_remote_outports(*oc_iter);
+}
+
+void Universe::wire_up_remote_channels()
+{
+  // the stargates created in parallel are made known to the target
+  // timelines in the order they would have been created sequentially
+  VECTOR(PAIR(int,Stargate*)) sgs;
+  for(int p=0; p<args_nprocs; p++) {
+    Universe* univ = parallel_universe[p]; assert(univ);
+    for(MAP(PAIR(int,int),PAIR(int,Stargate*))::iterator iter = univ->staged_stargates.begin();
+	iter != univ->staged_stargates.end(); iter++)
+      sgs.push_back((*iter).second);
+    univ->staged_stargates.clear();
+  }
+  std::sort(sgs.begin(), sgs.end());
+  for(VECTOR(PAIR(int,Stargate*))::iterator iter = sgs.begin(); iter != sgs.end(); iter++) {
+    Stargate* sg = (*iter).second;
+    if(sg->target_timeline) sg->target_timeline->add_inbound_stargate(sg);
+    register_stargate(sg);
+  }
+
+  // merge the mapping requests to remote machines (again in order)
+  int rmap_cnt = 0;
+  MapRequest* rmap_head = 0;
+  MapRequest* rmap_tail = 0;
+  for(;;) {
+    Universe* next = 0;
+    for(int p=0; p<args_nprocs; p++) {
+      Universe* univ = parallel_universe[p];
+      if(univ->staged_rmap_head && (!next || 
+	 univ->staged_rmap_head->seqno < next->staged_rmap_head->seqno)) next = univ;
+    }
+    if(!next) break;
+    MapRequest* req = next->staged_rmap_head;
+    next->staged_rmap_head = req->next;
+    req->next = 0;
+    if(!rmap_head) rmap_head = rmap_tail = req;
+    else { rmap_tail->next = req; rmap_tail = req; }
+    rmap_cnt++;
+  }
+  for(int p=0; p<args_nprocs; p++) parallel_universe[p]->staged_rmap_tail = 0;
+
   if(args_nmachs == 1) {
     assert(!rmap_cnt);
     local_icmap.clear();
     return;
   }
 
-#ifdef HAVE_MPI_H
   register int i, k;
 
   int maxmaps;
-  ssf_mpi_allreduce(&rmap_cnt, &maxmaps, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-  if(maxmaps == 0) return;
+  transport->allreduce(&rmap_cnt, &maxmaps, 1, Transport::REDUCE_MAX);
+  if(maxmaps == 0) {
+    local_icmap.clear();
+    remote_icmap.clear();
+    return;
+  }
 
   char* sendbuf = new char[args_nmachs*MAX_MPI_BUFSIZ]; assert(sendbuf);
   char** sbuf = new char*[args_nmachs]; assert(sbuf);
@@ -267,7 +434,7 @@ void Universe::wire_up_channels()
       nn++;
 
       int sn = 0;
-      MAP(STRING,int)::iterator iter = remote_icmap.find(req->icname);
+      UNORDERED_MAP(STRING,int)::iterator iter = remote_icmap.find(req->icname);
       if(iter != remote_icmap.end()) sn = (*iter).second;
       else assert(0);
 
@@ -277,25 +444,22 @@ void Universe::wire_up_channels()
       int icnamelen = (int)req->icname.length();
       int64 mytime = (int64)req->delay; // extra delay here!
 
-      ssf_mpi_pack(&tmlnid, 1, MPI_INT, sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach], MPI_COMM_WORLD);
-      ssf_mpi_pack(&outport, 1, MPI_INT, sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach], MPI_COMM_WORLD);
-      ssf_mpi_pack(&mytime, 1, MPI_LONG_LONG_INT, sbuf[mach], MAX_MPI_BUFSIZ, 
-		   &sendcnt[mach], MPI_COMM_WORLD);
-      ssf_mpi_pack(&icnamelen, 1, MPI_INT, sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach], MPI_COMM_WORLD);
-      ssf_mpi_pack((char*)req->icname.c_str(), icnamelen, MPI_UNSIGNED_CHAR, 
-		   sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach], MPI_COMM_WORLD);
+      ssf_pack(&tmlnid, sizeof(tmlnid), sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach]);
+      ssf_pack(&outport, sizeof(outport), sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach]);
+      ssf_pack(&mytime, sizeof(mytime), sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach]);
+      ssf_pack(&icnamelen, sizeof(icnamelen), sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach]);
+      ssf_pack((char*)req->icname.c_str(), icnamelen, sbuf[mach], MAX_MPI_BUFSIZ, &sendcnt[mach]);
       delete req;
     }
     
-    ssf_mpi_alltoall(sendcnt, 1, MPI_INT, recvcnt, 1, MPI_INT, MPI_COMM_WORLD);
+    transport->alltoall(sendcnt, sizeof(int), recvcnt);
 
     rdisp[0] = 0;
     for(i=1; i<args_nmachs; i++)
       rdisp[i] = rdisp[i-1]+recvcnt[i-1];
     int rsize = rdisp[args_nmachs-1]+recvcnt[args_nmachs-1];
     char* recvbuf = new char[rsize]; assert(recvbuf);
-    ssf_mpi_alltoallv(sendbuf, sendcnt, sdisp, MPI_PACKED,
-		      recvbuf, recvcnt, rdisp, MPI_PACKED, MPI_COMM_WORLD);
+    transport->alltoallv(sendbuf, sendcnt, sdisp, recvbuf, recvcnt, rdisp);
 
     for(i=0; i<args_nmachs; i++) {
       if(i == args_rank) continue;
@@ -308,16 +472,16 @@ void Universe::wire_up_channels()
 	int tmlnid, outport, icnamelen;
 	int64 mytime;
 
-	ssf_mpi_unpack(rbuf, bufsiz, &pos, &tmlnid, 1, MPI_INT, MPI_COMM_WORLD);
-	ssf_mpi_unpack(rbuf, bufsiz, &pos, &outport, 1, MPI_INT, MPI_COMM_WORLD);
-	ssf_mpi_unpack(rbuf, bufsiz, &pos, &mytime, 1, MPI_LONG_LONG_INT, MPI_COMM_WORLD);
-	ssf_mpi_unpack(rbuf, bufsiz, &pos, &icnamelen, 1, MPI_INT, MPI_COMM_WORLD);
+	ssf_unpack(rbuf, bufsiz, &pos, &tmlnid, sizeof(tmlnid));
+	ssf_unpack(rbuf, bufsiz, &pos, &outport, sizeof(outport));
+	ssf_unpack(rbuf, bufsiz, &pos, &mytime, sizeof(mytime));
+	ssf_unpack(rbuf, bufsiz, &pos, &icnamelen, sizeof(icnamelen));
 
 	char* icname = new char[icnamelen+1]; assert(icname);
-	ssf_mpi_unpack(rbuf, bufsiz, &pos, icname, icnamelen, MPI_UNSIGNED_CHAR, MPI_COMM_WORLD);
+	ssf_unpack(rbuf, bufsiz, &pos, icname, icnamelen);
 	icname[icnamelen] = 0;
 
-	MAP(STRING,inChannel*)::iterator iter = local_icmap.find(icname);
+	UNORDERED_MAP(STRING,inChannel*)::iterator iter = local_icmap.find(icname);
 	if(iter == local_icmap.end()) SSF_THROW("can't find inchannel: " << icname);
 	map_remote_local(tmlnid, outport, (*iter).second, mytime);
 
@@ -326,6 +490,7 @@ void Universe::wire_up_channels()
     }
     delete[] recvbuf;
   }
+  settle_starmap();
 
   delete[] sendbuf;
   delete[] sbuf;
@@ -336,7 +501,6 @@ void Universe::wire_up_channels()
 
   local_icmap.clear();
   remote_icmap.clear();
-#endif
 }
 
 void Universe::map_local_local(outChannel* oc, inChannel* ic, VirtualTime delay)
@@ -352,17 +516,15 @@ void Universe::map_local_local(outChannel* oc, inChannel* ic, VirtualTime delay)
   */
 
   // try find an existing outport at oc
-  DEQUE(MapOutport*)::iterator iter;
-  for(iter = oc->outports.begin(); iter != oc->outports.end(); iter++) {
-    if(!(*iter)->stargate && // no stargate means it's on the same timeline
+  MapOutport** tail = &oc->outports;
+  MapOutport* outport;
+  for(outport = oc->outports; outport; tail = &outport->next, outport = outport->next) {
+    if(!outport->stargate && // no stargate means it's on the same timeline
        oc->entity_owner->timeline == ic->entity_owner->timeline) break;
-    else if((*iter)->stargate &&  // stargate to another timeline on the same machine
-	    (*iter)->stargate->target_timeline &&
-	    (*iter)->stargate->target_timeline == ic->entity_owner->timeline) break;
+    else if(outport->stargate &&  // stargate to another timeline on the same machine
+	    outport->stargate->target_timeline &&
+	    outport->stargate->target_timeline == ic->entity_owner->timeline) break;
   }
-  MapOutport* outport;
-  if(iter != oc->outports.end()) outport = *iter;
-  else outport = 0;
 
   if(!outport) { // if outport does not exist, create one
     if(oc->entity_owner->timeline == ic->entity_owner->timeline) {
@@ -379,7 +541,7 @@ void Universe::map_local_local(outChannel* oc, inChannel* ic, VirtualTime delay)
       outport = new MapOutport(sg, inport, delay); assert(outport);
     }
     assert(outport);
-    oc->outports.push_back(outport);
+    *tail = outport; // append to the list
   } else { // if the outport exists, adjust min delay and insert at right place
     VirtualTime x = delay - outport->min_offset;
     if(delay < outport->min_offset) {
@@ -410,14 +572,12 @@ void Universe::map_local_remote(outChannel* oc, int timelineno, VirtualTime& del
   */
 
   // try find an existing outport at oc
-  DEQUE(MapOutport*)::iterator iter;
-  for(iter = oc->outports.begin(); iter != oc->outports.end(); iter++) {
-    if((*iter)->stargate && !(*iter)->stargate->target_timeline &&
-       (*iter)->stargate->target_timeline_id == timelineno) break;
-  }
+  MapOutport** tail = &oc->outports;
   MapOutport* outport;
-  if(iter != oc->outports.end()) outport = *iter;
-  else outport = 0;
+  for(outport = oc->outports; outport; tail = &outport->next, outport = outport->next) {
+    if(outport->stargate && !outport->stargate->target_timeline &&
+       outport->stargate->target_timeline_id == timelineno) break;
+  }
 
   if(!outport) { // if outport does not exist, create one
     Stargate* sg = find_stargate(oc->entity_owner->timeline->serialno, timelineno);
@@ -427,7 +587,7 @@ void Universe::map_local_remote(outChannel* oc, int timelineno, VirtualTime& del
     }
     outport = new MapOutport(sg, 0, delay); assert(outport);
     sg->set_delay(delay);
-    oc->outports.push_back(outport);
+    *tail = outport; // append to the list
     // the first channel map, delay is the initial min delay!
   } else { // if outport exists, adjust min delay
     assert(outport->stargate);
@@ -449,33 +609,26 @@ void Universe::map_remote_local(int tmlnid, int outport, inChannel* ic, VirtualT
   }
   */
 
-  MAP(int,VECTOR(PAIR(MapInport*,Stargate*))*)::iterator iter = 
-    starmap.find(outport);
+  VECTOR(MapStarport)* vec;
+  MAP(int,VECTOR(MapStarport)*)::iterator iter = starmap.find(outport);
   if(iter == starmap.end()) { // if we can't find an existing map
-    VECTOR(PAIR(MapInport*,Stargate*))* vec = 
-      new VECTOR(PAIR(MapInport*,Stargate*));
-    assert(vec);
-    Stargate* sg = find_stargate(tmlnid, ic->entity_owner->timeline->serialno);
-    if(!sg) {
-      sg = new Stargate(tmlnid, outport, ic->entity_owner->timeline); 
-      assert(sg);
-    }
-    sg->set_delay(xdelay); // first time, xdelay is min_delay (not extra)
-    MapInport* inport = new MapInport(ic);
-    vec->push_back(MAKE_PAIR(inport,sg));
+    vec = new VECTOR(MapStarport); assert(vec);
     starmap.insert(MAKE_PAIR(outport,vec));
   } else {
-    VECTOR(PAIR(MapInport*,Stargate*))* vec = (*iter).second;
-    assert(vec);
+    vec = (*iter).second; assert(vec);
     for(int i=0; i<(int)vec->size(); i++) {
-      Stargate* sg = vec->at(i).second; assert(sg);
+      Stargate* sg = vec->at(i).stargate; assert(sg);
       if(sg->target_timeline == ic->entity_owner->timeline) {
 	// found the existing mapping
 	if(xdelay < 0) {
-	  sg->set_delay(sg->min_delay-xdelay); // subsequent times, xdelay is the extra
+	  // subsequent times, xdelay is the extra delay; the mappings
+	  // arrive in the same order as they were made at the sender,
+	  // so we can track the outport's min_offset
+	  vec->at(i).offset += xdelay;
+	  sg->set_delay(vec->at(i).offset);
 	}
 	MapInport* inport = new MapInport(ic);
-	MapInport** p = &vec->at(i).first;
+	MapInport** p = &vec->at(i).inport;
 	while((*p) && (*p)->extra_delay < xdelay) {
 	  xdelay -= (*p)->extra_delay;
 	  p = &(*p)->next;
@@ -486,15 +639,61 @@ void Universe::map_remote_local(int tmlnid, int outport, inChannel* ic, VirtualT
 	return;
       }
     }
-    // if no such target timeline is found
-    Stargate* sg = find_stargate(tmlnid, ic->entity_owner->timeline->serialno);
-    if(!sg) {
-      sg = new Stargate(tmlnid, outport, ic->entity_owner->timeline); 
-      assert(sg);
+  }
+
+  // if no such target timeline is found
+  Stargate* sg = find_stargate(tmlnid, ic->entity_owner->timeline->serialno);
+  if(!sg) {
+    sg = new Stargate(tmlnid, outport, ic->entity_owner->timeline); 
+    assert(sg);
+  }
+  sg->set_delay(xdelay); // first time, xdelay is min_delay (not extra)
+  MapInport* inport = new MapInport(ic);
+  vec->push_back(MapStarport(inport, sg, xdelay)); // the offset is min_offset for now
+}
+
+void Universe::settle_remote_outports(outChannel* oc)
+{
+  // the outports to timelines on the same remote machine are chained
+  // together from the one with the smallest min_offset, which carries
+  // the events for all of them
+  MAP(int,MapOutport*) leads; // machine rank => outport carrying the events
+  for(MapOutport* outport = oc->outports; outport; outport = outport->next) {
+    if(outport->inport) continue; // on the same machine
+    assert(outport->stargate && !outport->stargate->target_timeline);
+    int rank = timeline_to_machine(outport->stargate->target_timeline_id);
+    outport->colocated = 0;
+    outport->carried = false;
+    MAP(int,MapOutport*)::iterator liter = leads.find(rank);
+    if(liter == leads.end()) leads.insert(MAKE_PAIR(rank,outport));
+    else {
+      MapOutport* lead = (*liter).second;
+      if(outport->min_offset < lead->min_offset) {
+	outport->colocated = lead;
+	lead->carried = true;
+	(*liter).second = outport;
+      } else {
+	outport->colocated = lead->colocated;
+	lead->colocated = outport;
+	outport->carried = true;
+      }
     }
-    sg->set_delay(xdelay); // first time, xdelay is min_delay (not extra)
-    MapInport* inport = new MapInport(ic);
-    vec->push_back(MAKE_PAIR(inport,sg));
+  }
+}
+
+void Universe::settle_starmap()
+{
+  // the event from a remote machine is sent with the smallest
+  // min_offset of all target timelines on this machine; each target
+  // timeline needs to add the difference
+  for(MAP(int,VECTOR(MapStarport)*)::iterator iter = starmap.begin();
+      iter != starmap.end(); iter++) {
+    VECTOR(MapStarport)* vec = (*iter).second; assert(vec);
+    VirtualTime min_offset = vec->at(0).offset;
+    for(int i=1; i<(int)vec->size(); i++)
+      if(vec->at(i).offset < min_offset) min_offset = vec->at(i).offset;
+    for(int i=0; i<(int)vec->size(); i++)
+      vec->at(i).offset -= min_offset;
   }
 }
 
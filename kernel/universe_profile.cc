@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel/universe.h"
+#include "ssf.h"
+
+namespace minissf {
+
+// the alignment profile is a text file (one for each machine) that
+// records what has been measured in a run, so that a later run of
+// the same model can weigh auto-alignment with the actual load:
+//   1) magic string, format version, number of machines, machine rank;
+//   2) number of timelines; for each timeline (in order of serial
+//      numbers), the number of events processed, the number of
+//      entities, and the order in which each entity was initialized;
+//   3) number of links; for each stargate between two timelines on
+//      this machine, the source and target timelines (as the index in
+//      the list above), and the number of events sent through it.
+// the entities are identified by their order of initialization,
+// since the timelines and serial numbers change with the alignment
+#define PROFILE_MAGIC "MSSFPROF"
+#define PROFILE_VERSION 1
+
+#define PROFILE_MAX_TRAFFIC 16384 // largest link weight (as from metis_graph_t::cost)
+#define PROFILE_MAX_LOAD (1<<30) // limit of the total node weight
+
+void Universe::save_profile()
+{
+  // all timelines on this machine, in order of serial numbers
+  VECTOR(PAIR(int,Timeline*)) tvec;
+  for(int p=0; p<args_nprocs; p++) {
+    Universe* univ = parallel_universe[p]; assert(univ);
+    for(SET(Timeline*)::iterator tmln_iter = univ->timelines.begin();
+	tmln_iter != univ->timelines.end(); tmln_iter++)
+      tvec.push_back(MAKE_PAIR((*tmln_iter)->serialno, *tmln_iter));
+  }
+  std::sort(tvec.begin(), tvec.end());
+
+  FILE* fptr = fopen(args_save_profile.c_str(), "w");
+  if(!fptr) SSF_THROW("can't open profile: " << args_save_profile);
+  fprintf(fptr, "%s %d %d %d\n", PROFILE_MAGIC, PROFILE_VERSION, args_nmachs, args_rank);
+
+  UNORDERED_MAP(Timeline*,int) tidx;
+  fprintf(fptr, "%d\n", (int)tvec.size());
+  for(int i=0; i<(int)tvec.size(); i++) {
+    Timeline* tmln = tvec[i].second;
+    tidx.insert(MAKE_PAIR(tmln, i));
+    fprintf(fptr, "%lu %d", tmln->stats_processed_events, (int)tmln->entities.size());
+    for(VECTOR(Entity*)::iterator e_iter = tmln->entities.begin();
+	e_iter != tmln->entities.end(); e_iter++) {
+      UNORDERED_MAP(Entity*,int)::iterator b_iter = entity_births.find(*e_iter);
+      fprintf(fptr, " %d", (b_iter != entity_births.end()) ? (*b_iter).second : -1);
+    }
+    fprintf(fptr, "\n");
+  }
+
+  // only the stargates between timelines on this machine count
+  VECTOR(Stargate*) svec;
+  for(MAP(PAIR(int,int),Stargate*)::iterator sg_iter = created_stargates.begin();
+      sg_iter != created_stargates.end(); sg_iter++) {
+    Stargate* sg = (*sg_iter).second;
+    if(sg->source_timeline && sg->target_timeline) svec.push_back(sg);
+  }
+  fprintf(fptr, "%d\n", (int)svec.size());
+  for(VECTOR(Stargate*)::iterator s_iter = svec.begin(); s_iter != svec.end(); s_iter++) {
+    fprintf(fptr, "%d %d %lu\n", tidx[(*s_iter)->source_timeline], 
+	    tidx[(*s_iter)->target_timeline], (*s_iter)->stats_messages);
+  }
+
+  if(fclose(fptr)) SSF_THROW("can't write profile: " << args_save_profile);
+  entity_births.clear();
+}
+
+// the profile loaded is kept for weighing the graph of the timelines
+// both when they are merged and when they are assigned to processors
+static bool profile_loaded = false;
+static VECTOR(double) profile_loads; // events per entity of each profiled timeline
+static VECTOR(int) profile_owners; // profiled timeline of each entity (-1 if unknown)
+static MAP(PAIR(int,int),double) profile_traffic; // events between the profiled timelines
+static double profile_avg_load; // events per entity on average
+
+static void load_profile(const STRING& fname)
+{
+  FILE* fptr = fopen(fname.c_str(), "r");
+  if(!fptr) SSF_THROW("can't open profile: " << fname);
+
+  char magic[16];
+  int version, nmachs, rank;
+  if(fscanf(fptr, "%15s %d %d %d", magic, &version, &nmachs, &rank) != 4 ||
+     strcmp(magic, PROFILE_MAGIC) || version != PROFILE_VERSION) {
+    fclose(fptr);
+    SSF_THROW("not a profile: " << fname);
+  }
+  if(nmachs != Universe::args_nmachs || rank != Universe::args_rank) {
+    fclose(fptr);
+    SSF_THROW("profile " << fname << " is for machine " << rank << " of " << nmachs);
+  }
+
+  // the events of each profiled timeline are shared evenly by its
+  // entities, which are indexed by the order of initialization
+  int nt;
+  if(fscanf(fptr, "%d", &nt) != 1 || nt < 0) {
+    fclose(fptr);
+    SSF_THROW("corrupted profile: bad number of timelines");
+  }
+  profile_loads.assign(nt, 0);
+  double total_load = 0; 
+  int total_ents = 0;
+  for(int t=0; t<nt; t++) {
+    unsigned long nevts; int ne;
+    if(fscanf(fptr, "%lu %d", &nevts, &ne) != 2 || ne <= 0) {
+      fclose(fptr);
+      SSF_THROW("corrupted profile: bad timeline");
+    }
+    profile_loads[t] = double(nevts)/ne;
+    total_load += nevts; total_ents += ne;
+    for(int j=0; j<ne; j++) {
+      int b;
+      if(fscanf(fptr, "%d", &b) != 1) {
+	fclose(fptr);
+	SSF_THROW("corrupted profile: bad entity");
+      }
+      if(b < 0) continue;
+      if(b >= (int)profile_owners.size()) profile_owners.resize(b+1, -1);
+      profile_owners[b] = t;
+    }
+  }
+  // the entities unknown to the profile are given the average load
+  profile_avg_load = total_ents > 0 ? total_load/total_ents : 1;
+
+  int nl;
+  if(fscanf(fptr, "%d", &nl) != 1 || nl < 0) {
+    fclose(fptr);
+    SSF_THROW("corrupted profile: bad number of links");
+  }
+  for(int l=0; l<nl; l++) {
+    int src, tgt; unsigned long nmsgs;
+    if(fscanf(fptr, "%d %d %lu", &src, &tgt, &nmsgs) != 3 ||
+       src < 0 || src >= nt || tgt < 0 || tgt >= nt) {
+      fclose(fptr);
+      SSF_THROW("corrupted profile: bad link");
+    }
+    profile_traffic[MAKE_PAIR(src, tgt)] += nmsgs;
+  }
+  fclose(fptr);
+
+  if((Universe::args_debug_mask&Universe::DEBUG_FLAG_BRIEF) != 0 && !Universe::args_rank) {
+    printf("[ ALIGNMENT PROFILE: %d timelines, %d links, %lg events ]\n", 
+	   nt, nl, total_load);
+  }
+}
+
+void Universe::apply_profile(metis_graph_t* graph)
+{
+  if(!profile_loaded) {
+    load_profile(args_load_profile);
+    profile_loaded = true;
+  }
+
+  int n = graph->nodes.size();
+  VECTOR(double) weights(n, 0);
+  VECTOR(int) origins(n, -1); // profiled timeline of the node (by its first entity)
+  double sum_weights = 0;
+  for(int i=0; i<n; i++) {
+    Timeline* tmln = graph->nodes[i]->timeline;
+    for(VECTOR(Entity*)::iterator e_iter = tmln->entities.begin();
+	e_iter != tmln->entities.end(); e_iter++) {
+      UNORDERED_MAP(Entity*,int)::iterator b_iter = entity_births.find(*e_iter);
+      assert(b_iter != entity_births.end());
+      int b = (*b_iter).second;
+      if(b < (int)profile_owners.size() && profile_owners[b] >= 0) {
+	weights[i] += profile_loads[profile_owners[b]];
+	if(origins[i] < 0) origins[i] = profile_owners[b];
+      } else weights[i] += profile_avg_load;
+    }
+    sum_weights += weights[i];
+  }
+  double scale = (sum_weights > PROFILE_MAX_LOAD) ? PROFILE_MAX_LOAD/sum_weights : 1;
+  for(int i=0; i<n; i++) graph->nodes[i]->size = 1+int(weights[i]*scale);
+
+  // the traffic between two profiled timelines is divided among the
+  // links between the nodes originated from them; the links within
+  // the same profiled timeline are not measured
+  MAP(PAIR(int,int),int) nshares;
+  for(int i=0; i<n; i++) {
+    metis_node_t* node = graph->nodes[i];
+    for(MAP(metis_node_t*,double)::iterator l_iter = node->links.begin();
+	l_iter != node->links.end(); l_iter++) {
+      int j = (*l_iter).first->id;
+      if(origins[i] >= 0 && origins[j] >= 0 && origins[i] != origins[j])
+	nshares[MAKE_PAIR(origins[i], origins[j])]++;
+    }
+  }
+  double max_traffic = 0;
+  for(MAP(PAIR(int,int),int)::iterator s_iter = nshares.begin();
+      s_iter != nshares.end(); s_iter++) {
+    double x = profile_traffic[(*s_iter).first]/(*s_iter).second;
+    if(x > max_traffic) max_traffic = x;
+  }
+  for(int i=0; i<n; i++) {
+    metis_node_t* node = graph->nodes[i];
+    for(MAP(metis_node_t*,double)::iterator l_iter = node->links.begin();
+	l_iter != node->links.end(); l_iter++) {
+      int j = (*l_iter).first->id;
+      int w = 1;
+      if(max_traffic > 0 && origins[i] >= 0 && origins[j] >= 0 && origins[i] != origins[j]) {
+	PAIR(int,int) key = MAKE_PAIR(origins[i], origins[j]);
+	w += int(profile_traffic[key]/nshares[key]/max_traffic*PROFILE_MAX_TRAFFIC);
+      }
+      node->traffic[(*l_iter).first] = w;
+    }
+  }
+  graph->weighted = true;
+}
+
+}; /*namespace minissf*/
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
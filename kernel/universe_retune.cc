@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <stdio.h>
+
+#include "kernel/universe.h"
+#include "ssf.h"
+
+namespace minissf {
+
+// after training, the synchronization threshold (the global one if
+// there are multiple machines, or the local one otherwise) is
+// re-evaluated at the synchronization points periodically, since the
+// traffic may change as the simulation goes on; the cost of each
+// interval (wall-clock time per unit of simulation time) is measured,
+// and the measures of synchronization overhead tell which direction
+// to go: long waits at the barriers with mostly idle windows call for
+// a larger threshold (so that more channels are asynchronous and the
+// windows are larger), while long waits for lbts with many null
+// messages call for a smaller one; a neighboring threshold (among
+// those used for training) is then tried for one interval and it's
+// kept only if it reduces the cost noticeably, otherwise we go back
+// and hold on for a number of intervals (which doubles with every
+// failed attempt), so that the threshold won't flap
+#define RETUNE_HYSTERESIS 0.1 // a new threshold must cut the cost by at least 10%
+#define RETUNE_MIN_OVERHEAD 0.05 // no need to try if less than 5% of time is spent synchronizing
+#define RETUNE_MAX_HOLD 16 // max number of intervals to hold on after a failed attempt
+
+enum { 
+  RETUNE_MEASURE_SYNC_WAIT, 
+  RETUNE_MEASURE_BLOCK_WAIT, 
+  RETUNE_MEASURE_EVENTS, 
+  RETUNE_MEASURE_NULLS, 
+  RETUNE_MEASURE_WINDOWS, 
+  RETUNE_MEASURE_BUSY_WINDOWS, 
+  RETUNE_MEASURE_WALLCLOCK, 
+  RETUNE_MEASURE_TOTAL 
+};
+
+enum { RETUNE_STATE_START, RETUNE_STATE_STEADY, RETUNE_STATE_PROBE };
+
+bool Universe::retune_changed = false;
+
+static int retune_state = RETUNE_STATE_START;
+static VirtualTime retune_time; // time of the next re-evaluation
+static VirtualTime retune_since; // start time of the current interval
+static double retune_last[RETUNE_MEASURE_TOTAL]; // the accumulated measures at the start of the interval
+static int retune_idx; // index of the current threshold (in the list of training thresholds)
+static int retune_base_idx; // index of the threshold before the attempt
+static double retune_base_cost; // cost of the interval before the attempt
+static int retune_hold; // number of intervals to hold on before another attempt
+static int retune_backoff = 1; // number of intervals to hold on after the next failed attempt
+
+bool Universe::retune_enabled()
+{
+  // the thresholds set manually are not trained and won't be retuned
+  if(args_retune_interval <= 0) return false;
+  if(args_nmachs > 1) return global_training_thresholds.size() > 1;
+  else return local_training_thresholds.size() > 1;
+}
+
+void Universe::retune_thresholds(VirtualTime l_opt, VirtualTime g_opt)
+{
+  assert(!processor_id);
+  if(synpoint < retune_time) return;
+  bool global = args_nmachs > 1;
+  VECTOR(VirtualTime)& thresholds = global ? global_training_thresholds : local_training_thresholds;
+
+  // the measures are accumulated by all universes on this machine
+  // (which are waiting at the barrier now)
+  double m[RETUNE_MEASURE_TOTAL];
+  for(int k=0; k<RETUNE_MEASURE_TOTAL; k++) m[k] = 0;
+  for(int p=0; p<args_nprocs; p++) {
+    Universe* univ = parallel_universe[p]; assert(univ);
+    m[RETUNE_MEASURE_SYNC_WAIT] += univ->retune_sync_wait;
+    m[RETUNE_MEASURE_BLOCK_WAIT] += univ->retune_block_wait;
+    m[RETUNE_MEASURE_WINDOWS] += univ->retune_windows;
+    m[RETUNE_MEASURE_BUSY_WINDOWS] += univ->retune_busy_windows;
+    for(SET(Timeline*)::iterator tmln_iter = univ->timelines.begin();
+	tmln_iter != univ->timelines.end(); tmln_iter++) {
+      Timeline* tmln = *tmln_iter;
+      m[RETUNE_MEASURE_EVENTS] += tmln->stats_processed_events;
+      m[RETUNE_MEASURE_NULLS] += tmln->stats_remote_null_messages+
+	tmln->stats_shmem_null_messages+tmln->stats_local_null_messages;
+    }
+  }
+  m[RETUNE_MEASURE_WALLCLOCK] = (double)ssf_wallclock_in_nanoseconds();
+
+  // what's happened during the last interval
+  double d[RETUNE_MEASURE_TOTAL];
+  for(int k=0; k<RETUNE_MEASURE_TOTAL; k++) {
+    d[k] = m[k]-retune_last[k];
+    retune_last[k] = m[k];
+  }
+  if(global) {
+    // all machines must come to the same decision
+    double dd[RETUNE_MEASURE_TOTAL];
+    transport->allreduce(d, dd, RETUNE_MEASURE_WALLCLOCK, Transport::REDUCE_SUM);
+    transport->allreduce(&d[RETUNE_MEASURE_WALLCLOCK], &dd[RETUNE_MEASURE_WALLCLOCK], 
+			 1, Transport::REDUCE_MAX);
+    for(int k=0; k<RETUNE_MEASURE_TOTAL; k++) d[k] = dd[k];
+  }
+  double simtime = synpoint-retune_since;
+  retune_since = synpoint;
+  retune_time = synpoint+args_retune_interval;
+
+  if(retune_state == RETUNE_STATE_START) {
+    // the measures from the beginning (including training) are discarded
+    VirtualTime t = global ? g_opt : l_opt;
+    retune_idx = std::lower_bound(thresholds.begin(), thresholds.end(), t)-thresholds.begin();
+    if(retune_idx >= (int)thresholds.size()) retune_idx = thresholds.size()-1;
+    retune_state = RETUNE_STATE_STEADY;
+    return;
+  }
+  if(simtime <= 0) return;
+
+  double cost = d[RETUNE_MEASURE_WALLCLOCK]/simtime;
+  double busy = d[RETUNE_MEASURE_WALLCLOCK]*(global ? ssf_total_num_processors() : args_nprocs);
+  double sync_wait = busy > 0 ? d[RETUNE_MEASURE_SYNC_WAIT]/busy : 0;
+  double block_wait = busy > 0 ? d[RETUNE_MEASURE_BLOCK_WAIT]/busy : 0;
+  if(sync_wait > 1) sync_wait = 1; // the waits are counted when the processors leave the barrier
+  if(block_wait > 1) block_wait = 1;
+  double nulls = d[RETUNE_MEASURE_NULLS]/(d[RETUNE_MEASURE_EVENTS] > 0 ? d[RETUNE_MEASURE_EVENTS] : 1);
+  double util = d[RETUNE_MEASURE_WINDOWS] > 0 ? d[RETUNE_MEASURE_BUSY_WINDOWS]/d[RETUNE_MEASURE_WINDOWS] : 1;
+  double sync_cost = sync_wait*(2-util); // worse if windows are mostly idle
+  double async_cost = block_wait*(1+nulls); // worse with more null messages per event
+  if((args_debug_mask&DEBUG_FLAG_LPSCHED) != 0) {
+    printf("[%d] %lg: retune %s thresh=%lg: cost=%lg, sync_wait=%lg, block_wait=%lg, "
+	   "nulls/event=%lg, window_util=%lg\n", args_rank, synpoint.second(), 
+	   global ? "global" : "local", thresholds[retune_idx].second(),
+	   cost, sync_wait, block_wait, nulls, util);
+  }
+
+  int idx = retune_idx;
+  if(retune_state == RETUNE_STATE_PROBE) {
+    retune_state = RETUNE_STATE_STEADY;
+    if(cost < retune_base_cost*(1-RETUNE_HYSTERESIS)) {
+      // the new threshold is kept
+      retune_backoff = 1;
+      if(!args_rank && (args_debug_mask&DEBUG_FLAG_BRIEF) != 0) {
+	printf("[ RETUNED %s THRESHOLD: %lg (s) at %lg (s) ]\n", global ? "GLOBAL" : "LOCAL", 
+	       thresholds[retune_idx].second(), synpoint.second());
+      }
+      return;
+    }
+    // go back to the previous threshold and hold on for a while
+    idx = retune_base_idx;
+    retune_hold = retune_backoff;
+    if(retune_backoff < RETUNE_MAX_HOLD) retune_backoff *= 2;
+  } else {
+    if(retune_hold > 0) { retune_hold--; return; }
+    if(sync_cost < RETUNE_MIN_OVERHEAD && async_cost < RETUNE_MIN_OVERHEAD) return;
+    idx = (sync_cost > async_cost) ? retune_idx+1 : retune_idx-1;
+    if(idx < 0 || idx >= (int)thresholds.size()) return;
+    retune_base_idx = retune_idx;
+    retune_base_cost = cost;
+    retune_state = RETUNE_STATE_PROBE;
+  }
+
+  retune_idx = idx;
+  retune_changed = true;
+}
+
+void Universe::retune_apply(VirtualTime& l_opt, VirtualTime& g_opt)
+{
+  assert(!processor_id && retune_changed);
+  retune_changed = false;
+  if(args_nmachs > 1) {
+    g_opt = global_training_thresholds[retune_idx];
+    classify_global_channels(g_opt, synpoint, false);
+    global_channel_reclassified = true;
+  } else {
+    l_opt = local_training_thresholds[retune_idx];
+    classify_local_channels(l_opt, synpoint, false);
+    local_channel_reclassified = true;
+  }
+}
+
+}; /*namespace minissf*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
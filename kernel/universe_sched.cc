@@ -12,11 +12,6 @@
  THAN MPIBUF_THRESHOLD, OR WE'LL HAVE BUFFER OVERFLOW!!! */
 #define MPIBUF_THRESHOLD 10240
 #define MPIBUF_SIZE (2*MPIBUF_THRESHOLD)
-#define MPIBUF_ATTACHED (64*1024*1024)
-
-/* This is the mpi tag used to send and receive events. IMPORTANT: THE
-   USER WHO ALSO USES MPI FOR COMMUNICATION MUST NOT USE THIS TAG. */
-#define CHANNEL_EVENT_TAG 100
 
 namespace minissf {
 
@@ -28,16 +23,16 @@ int64 Universe::start_wallclock_time;
 int64 Universe::time0;
 int64 Universe::time1;
 int64 Universe::time2;
+int64 Universe::init_resident_memory;
 
 /* This is the mininum of all synchronous channel link delays. */
 VirtualTime Universe::epoch_length;
 VirtualTime Universe::decade_length;
 
-/* This is a 2D array for universes on the same machine to exchange
-   their synchronous events for the next window. */
-ChannelEvent*** Universe::switch_board = 0;
+/* This is a 2D array of rings for universes on the same machine to
+   exchange their synchronous events for the next window. */
+Universe::SwitchRing* Universe::switch_board = 0;
 
-#if HAVE_MPI_H
 /* remote_mailbox is the head of a linked list containing the channel
    events to be sent out from this machine to all remote machines.
    remote_mailbox_tail points to the end of the linked list. Channel
@@ -61,15 +56,25 @@ int* Universe::sendpos = 0;
 //MPI_Request Universe::irecv_request;
 char* Universe::recvbuf = 0;
 
-int* Universe::rscnt = 0;
+/* If the received batches are to be unpacked by the universes (in
+   parallel), the reader thread only skips over the events and copies
+   them into a batch for each universe. */
+int* Universe::splitpos = 0;
+char** Universe::splitbuf = 0;
+
+/* The transport carries the batches of events between machines; it
+   is created when the machines are initialized and deleted when they
+   are wrapped up. */
+Transport* Universe::transport = 0;
+
 int64** Universe::sndcnt = 0;
-int64 Universe::rcvcnt = 0;
-int64 Universe::rcvcnt_target = 0;
+int Universe::send_round = 0;
+int Universe::recv_round = 0;
+int64 Universe::rcvcnt[2] = { 0, 0 };
+int64 Universe::rcvcnt_target = -1;
 ssf_thread_mutex_t Universe::rcvcnt_mutex;
 ssf_thread_cond_t Universe::rcvcnt_cond;
-ssf_thread_cond_t Universe::bar_cond;
 bool Universe::scatter_reduce_carry_on;
-bool Universe::barrier_carry_on;
 
 /* These are simple functions used to create the reader and writer
    thread with. They call the corresponding static methods of the
@@ -92,7 +97,6 @@ static void rw_thread_start(void* data)
 
 static void reader_thread_start(void* data) { Universe::reader_thread(); }
 static void writer_thread_start(void* data) { Universe::writer_thread(); }
-#endif
 
 void Universe::synchronize_events()
 {
@@ -101,110 +105,146 @@ void Universe::synchronize_events()
   // is right at the local window edge
   if((decade_sync || epoch_sync) && args_nprocs > 1) {
     assert(local_binque);
-    assert(switch_board);
-    // dispatch local events
     /*
     printf(">> [%d:%d] %lg: retrieve events next_decade=%lg\n", 
 	   args_rank, processor_id, synpoint.second(), next_decade.second());
     */
-    ChannelEvent* local_evts = local_binque->retrieve_events(next_decade);
-    while(local_evts) {
-      ChannelEvent* e = local_evts;
-      local_evts = (ChannelEvent*)e->get_next_event();
-      int pid = e->stargate->target_timeline->universe->processor_id;
-      assert(processor_id != pid);
-      e->stargate->source_timeline->record_stats_shmem_messages();
-      e->get_next_event() = switch_board[processor_id][pid];
-      switch_board[processor_id][pid] = e;
-    }
-    ssf_barrier();
-    for(int i=0; i<args_nprocs; i++) {
-      local_evts = switch_board[i][processor_id];
-      switch_board[i][processor_id] = 0;
-      while(local_evts) {
-	ChannelEvent* e = local_evts;
-	local_evts = (ChannelEvent*)e->get_next_event();
-	//e->get_next_event() = 0;
-	/*
-	printf("[%d:%d]   e=%lg from p%d\n", args_rank, processor_id, 
-	       VirtualTime(e->time()).second(), i);
-	*/
-	e->stargate->target_timeline->insert_event(e);
-      }
-    }
+    dispatch_local_events(local_binque->retrieve_events(next_decade));
   }
 
-#ifdef HAVE_MPI_H
   // if there are more than one machine, we do need to do global
   // barrier synchronization if the current synchronization point is
   // right at the global window edge
   if(epoch_sync && args_nmachs > 1) { 
     assert(global_binque);
-    // dispatch global events
-    ChannelEvent* evts = global_binque->retrieve_events(next_epoch);
-    //printf("%d:%d: HERE 1\n", args_rank, processor_id);
-    
-    // sent the event through the writer thread, which records the
-    // number of messages being sent
-    while(evts) {
-      ChannelEvent* e = evts;
-      evts = (ChannelEvent*)e->get_next_event();
-      assert(e->stargate && e->stargate->source_timeline);
-      assert(!e->stargate->target_timeline);
-      transport_message(e);
-    }
-    //printf("%d:%d: HERE 2\n", args_rank, processor_id);
-    ssf_barrier();
+    dispatch_global_events(global_binque->retrieve_events(next_epoch));
+  }
+}
 
-    if(!processor_id) {
-      // a global reduction so that each machine knows the number of
-      // messages expected to be received (by the reader thread)
-      // before it can continue
-      //printf("%d:%d: >> %lld %lld\n", args_rank, processor_id, sndcnt[0][0], sndcnt[0][1]);
-      transport_reduce_message();
+void Universe::dispatch_local_events(ChannelEvent* local_evts)
+{
+  assert(switch_board);
+  while(local_evts) {
+    ChannelEvent* e = local_evts;
+    local_evts = (ChannelEvent*)e->get_next_event();
+    int pid = e->stargate->target_timeline->universe->processor_id;
+    assert(processor_id != pid);
+    e->stargate->source_timeline->record_stats_shmem_messages();
+    SwitchRing* ring = &switch_board[processor_id*args_nprocs+pid];
+    int64 tail = ring->tail; // only we write it
+    if(tail-__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) < SWITCH_RING_SIZE) {
+      ring->slots[tail%SWITCH_RING_SIZE] = e;
+      __atomic_store_n(&ring->tail, tail+1, __ATOMIC_RELEASE);
+    } else { // the ring is full
+      e->set_next_event(ring->overflow);
+      ring->overflow = e;
+    }
+  }
+  int64 round = switch_rounds+1;
+  __atomic_store_n(&switch_rounds, round, __ATOMIC_RELEASE);
+
+  // instead of waiting for all others at a barrier, we take the
+  // events from the rings as they come, until all others are done
+  int ndone = 1; // myself
+  for(int i=0; i<args_nprocs; i++) switch_done[i] = false;
+  switch_done[processor_id] = true;
+  while(ndone < args_nprocs) {
+    bool taken = false;
+    for(int i=0; i<args_nprocs; i++) {
+      if(switch_done[i]) continue;
+      // the producer must be found done before we drain the ring for
+      // the last time, so that none of its events will be missed
+      bool finished = __atomic_load_n(&parallel_universe[i]->switch_rounds, __ATOMIC_ACQUIRE) >= round;
+      SwitchRing* ring = &switch_board[i*args_nprocs+processor_id];
+      int64 head = ring->head; // only we write it
+      int64 tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+      if(head < tail) {
+	// insert the events in a batch before making room in the ring
+	for(int64 k=head; k<tail; k++) {
+	  ChannelEvent* e = ring->slots[k%SWITCH_RING_SIZE];
+	  e->stargate->target_timeline->insert_event(e);
+	}
+	__atomic_store_n(&ring->head, tail, __ATOMIC_RELEASE);
+	taken = true;
+      }
+      if(finished) {
+	while(ring->overflow) {
+	  ChannelEvent* e = ring->overflow;
+	  ring->overflow = (ChannelEvent*)e->get_next_event();
+	  e->stargate->target_timeline->insert_event(e);
+	}
+	switch_done[i] = true;
+	ndone++;
+      }
     }
+    if(!taken && ndone < args_nprocs) ssf_thread_yield();
+  }
+}
 
-    // it's important to use the barrier here, since we need to make
-    // sure all the receiving events by the reader thread have been
-    // delivered to the other processors mailboxes before they can
-    // be retrieved using handle_io_events() next
-    ssf_barrier(); 
-    handle_io_events(false); // so that all synchronous events are inserted into the corresponding timelines
+void Universe::dispatch_global_events(ChannelEvent* evts)
+{
+  //printf("%d:%d: HERE 1\n", args_rank, processor_id);
+    
+  // sent the event through the writer thread, which records the
+  // number of messages being sent
+  while(evts) {
+    ChannelEvent* e = evts;
+    evts = (ChannelEvent*)e->get_next_event();
+    assert(e->stargate && e->stargate->source_timeline);
+    assert(!e->stargate->target_timeline);
+    transport_message(e);
+  }
+  //printf("%d:%d: HERE 2\n", args_rank, processor_id);
+  ssf_barrier();
 
-    // it's important to use the mpi barrier here too, since we
-    // don't want to mix up event delivery at different rounds
-    if(!processor_id) {
-      transport_barrier_message();
-    }
-    ssf_barrier(); // necessary?
+  if(!processor_id) {
+    // a global reduction so that each machine knows the number of
+    // messages expected to be received (by the reader thread)
+    // before it can continue
+    //printf("%d:%d: >> %lld %lld\n", args_rank, processor_id, sndcnt[0][0], sndcnt[0][1]);
+    transport_reduce_message();
   }
-#endif
+
+  // it's important to use the barrier here, since we need to make
+  // sure all the receiving events by the reader thread have been
+  // delivered to the other processors mailboxes before they can
+  // be retrieved using handle_io_events() next
+  ssf_barrier(); 
+  handle_io_events(false); // so that all synchronous events are inserted into the corresponding timelines
+
+  // there used to be an mpi barrier here so that event delivery at
+  // different rounds wouldn't mix up; now the batches carry the
+  // round number and the events are counted for each round
+  // separately, the reduce scatter is the only collective needed
+  ssf_barrier(); // necessary?
 }
 
 void Universe::run()
 {
+  // all universes take part in the initialization of the model
+  initialize_model();
+
   // wait for ALL universes to complete the initialization phrase
   // (using the barrier) and then we can move onto the running phase
   ssf_barrier(); 
   if(!processor_id) {
     sim_state = SIM_STATE_RUNNING; 
 
-#ifdef HAVE_MPI_H
     // initialize the variables, set up the send and receive buffers,
     // and spawn the reader and writer threads (or one r/w thread)
     // only when we detect there are more than one mpi processes
     if(args_nmachs > 1) {
       ssf_thread_mutex_init(&remote_mailbox_mutex);
       ssf_thread_cond_init(&remote_mailbox_cond);
-      char* attachbuf = new char[MPIBUF_ATTACHED]; assert(attachbuf);
-      ssf_mpi_buffer_attach(attachbuf, MPIBUF_ATTACHED);
       sendbuf = new char*[args_nmachs]; assert(sendbuf);
       sendpos = new int[args_nmachs]; assert(sendpos);
       memset(sendbuf, 0, sizeof(char*)*args_nmachs); // we will allocate each send buffer on demand
       recvbuf = new char[MPIBUF_SIZE]; assert(recvbuf);
-
-      rscnt = new int[args_nmachs]; assert(rscnt);
-      for(int i=0; i<args_nmachs; i++) rscnt[i] = 1;
+      if(args_parallel_unpack) {
+	splitbuf = new char*[args_nprocs]; assert(splitbuf);
+	splitpos = new int[args_nprocs]; assert(splitpos);
+	memset(splitbuf, 0, sizeof(char*)*args_nprocs); // we will allocate each split buffer on demand
+      }
 
       sndcnt = new int64*[args_nprocs]; assert(sndcnt);
       for(int i=0; i<args_nprocs; i++) {
@@ -214,9 +254,8 @@ void Universe::run()
       }
       ssf_thread_mutex_init(&rcvcnt_mutex);
       ssf_thread_cond_init(&rcvcnt_cond);
-      ssf_thread_cond_init(&bar_cond);
 
-      if(mpi_thread_support == MPI_THREAD_MULTIPLE) {
+      if(transport->is_concurrent()) {
 	ssf_thread_create(&reader_thread_id, &reader_thread_start, this);
 	ssf_thread_create(&writer_thread_id, &writer_thread_start, this);
       } else {
@@ -226,7 +265,6 @@ void Universe::run()
 	return; 
       }
     }
-#endif
   }
   run_continuation();
 }
@@ -245,11 +283,15 @@ void Universe::run_continuation()
     assert(local_binque);
   }
 
+  // when restarting from a checkpoint, the state of the entities and
+  // the channel events are restored, and the init events are dropped
+  if(!args_restart.empty()) restore_checkpoint();
+
   // now we can schedule all the init events
   for(SET(Timeline*)::iterator tmln_iter = timelines.begin();
       tmln_iter != timelines.end(); tmln_iter++) {
     Timeline* tmln = *tmln_iter;
-    for(SET(Entity*)::iterator iter = tmln->entities.begin();
+    for(VECTOR(Entity*)::iterator iter = tmln->entities.begin();
 	iter != tmln->entities.end(); iter++) 
       (*iter)->schedule_init_events();
   }
@@ -276,7 +318,20 @@ void Universe::run_continuation()
   if(!processor_id) {
     training_finished = global_channel_reclassified = 
       local_channel_reclassified = false;
-    if(0 >= local_training_length || local_training_length >= args_endtime) {
+    if(restart_time > 0) {
+      // the thresholds found by training are kept in the checkpoint
+      if((args_debug_mask&DEBUG_FLAG_LPSCHED) != 0) {
+	printf("[%d] restart from checkpoint, set local thresh=%lg, global thresh=%lg\n", 
+	       args_rank, restart_local_thresh.second(), restart_global_thresh.second());
+      }
+      classify_local_channels(restart_local_thresh, restart_time, false);
+      local_roundup = VirtualTime::INFINITY;
+      l_opt = restart_local_thresh;
+      classify_global_channels(restart_global_thresh, restart_time, false);
+      global_roundup = VirtualTime::INFINITY;
+      g_opt = restart_global_thresh;
+      training_finished = true;
+    } else if(0 >= local_training_length || local_training_length >= args_endtime) {
       if((args_debug_mask&DEBUG_FLAG_LPSCHED) != 0) {
 	printf("[%d] no one's doing local thresh, set default local thresh=%lg\n", 
 	       args_rank, args_local_thresh.second());
@@ -328,6 +383,7 @@ void Universe::run_continuation()
       global_roundup = local_training_length;
       t0 = ssf_wallclock_in_nanoseconds();
     }
+    checkpoint_time = restart_time+args_checkpoint_interval;
   }
 
   ssf_barrier();
@@ -346,20 +402,20 @@ void Universe::run_continuation()
       int n;
       if(args_endtime/1024 > epoch_length) n = 1024;
       else n = int(args_endtime/epoch_length)+1;
-      global_binque->settle(epoch_length, n, 0);
+      global_binque->settle(epoch_length, n, restart_time);
     }
     if(local_binque) {
       int n;
       if(args_endtime/1024 > decade_length) n = 1024;
       else n = int(args_endtime/decade_length)+1;
-      local_binque->settle(decade_length, n, 0); 
+      local_binque->settle(decade_length, n, restart_time); 
     }
   }
 
   // entering the main LP scheduling loop
-  synpoint = 0; 
-  next_decade = decade_length; 
-  next_epoch = epoch_length;
+  synpoint = restart_time; 
+  next_decade = synpoint+decade_length; 
+  next_epoch = synpoint+epoch_length;
   if(next_decade > args_endtime) next_decade = args_endtime;
   if(next_decade > local_roundup) next_decade = local_roundup;
   if(next_epoch > args_endtime) next_epoch = args_endtime;
@@ -369,7 +425,14 @@ void Universe::run_continuation()
   VirtualTime next_window = next_decade;
   if(next_epoch < next_window) next_window = next_epoch;
 
+  // the time spent at synchronization points and blocking for lbts
+  // is measured for retuning the thresholds
+  bool retuning = retune_enabled();
+  bool window_busy = false;
+  int64 window_end = retuning ? ssf_wallclock_in_nanoseconds() : 0;
+
   while(synpoint < args_endtime) { // the simulation hasn't finished
+    int64 sync_start = trace_buffer ? ssf_wallclock_in_nanoseconds() : 0;
     ssf_barrier();
 
     synchronize_events();
@@ -414,7 +477,6 @@ void Universe::run_continuation()
       }
     }
 
-#ifdef HAVE_MPI_H
     if(epoch_sync) { 
       if(synpoint == global_roundup && !processor_id) {
 	if(global_roundup == local_training_length) { // meaning it's a start
@@ -457,8 +519,10 @@ void Universe::run_continuation()
 	  } else {
 	    //g_opt = global_training_thresholds[0]; // DEBUG
 	    int64 myopt = g_opt.get_ticks(), youropt;
-	    ssf_mpi_allreduce(&myopt, &youropt, 1, MPI_LONG_LONG_INT, MPI_MIN, MPI_COMM_WORLD);
-	    g_opt.set_ticks(youropt);
+	    if(args_nmachs > 1) {
+	      transport->allreduce(&myopt, &youropt, 1, Transport::REDUCE_MIN);
+	      g_opt.set_ticks(youropt);
+	    }
 	    if((args_debug_mask&DEBUG_FLAG_LPSCHED) != 0) {
 	      printf("[%d] %lg: done global thresh, set opt global thresh=%lg\n", 
 		     args_rank, synpoint.second(), g_opt.second());
@@ -471,9 +535,23 @@ void Universe::run_continuation()
 	global_channel_reclassified = true;
       }
     }
-#endif
+
+    // re-evaluate the trained thresholds at the synchronization points
+    if(retuning && training_finished && !processor_id && 
+       (args_nmachs > 1 ? epoch_sync : decade_sync))
+      retune_thresholds(l_opt, g_opt);
 
     ssf_barrier();
+    if(retune_changed) {
+      // the events held for the later windows are delivered before
+      // the channels are reclassified (it doesn't hurt to deliver
+      // them early), since the windows are about to change
+      if(local_binque) dispatch_local_events(local_binque->retrieve_all_events());
+      if(global_binque) dispatch_global_events(global_binque->retrieve_all_events());
+      ssf_barrier();
+      if(!processor_id) retune_apply(l_opt, g_opt);
+      ssf_barrier();
+    }
     if(global_channel_reclassified || local_channel_reclassified) {
       if(local_channel_reclassified || training_finished) {
 	next_decade = synpoint+decade_length; 
@@ -522,6 +600,17 @@ void Universe::run_continuation()
     }
     ssf_barrier(); // safer to have it
 
+    if(checkpoint_due()) save_checkpoint(l_opt, g_opt);
+
+    // the synchronization point is traced along with the next window
+    set_trace_window(synpoint, next_window);
+    if(tracer) tracer->slice(TRACE_BARRIER, 0, synpoint.get_ticks(), next_window.get_ticks(), sync_start);
+
+    if(retuning) {
+      retune_sync_wait += ssf_wallclock_in_nanoseconds()-window_end;
+      window_busy = false;
+    }
+
     if((args_debug_mask&DEBUG_FLAG_LPSCHED) != 0) {
       printf(">> [%d:%d] composite window: synpoint=%lg, "
 	     "next_decade=%lg, next_epoch=%lg (decade=%lg, epoch=%lg)\n", 
@@ -559,7 +648,11 @@ void Universe::run_continuation()
 	  }
 
 	  // process events on the timeline until lbts (if it's not paced or interrupted)
+	  int64 run_start = tracer ? ssf_wallclock_in_nanoseconds() : 0;
+	  unsigned long nevts = tmln->stats_processed_events;
 	  VirtualTime newclock = tmln->run();
+	  if(tracer) tracer->slice(TRACE_RUN, tmln->serialno, clock.get_ticks(), 
+				   tmln->stats_processed_events-nevts, run_start);
 	  assert(newclock == tmln->simclock);
 	  if((args_debug_mask&DEBUG_FLAG_TMSCHED) != 0) {
 	    printf(">> [%d:%d] timeline [%d] done running (simclock=%lg => lbts=%lg)\n",
@@ -567,8 +660,10 @@ void Universe::run_continuation()
 		   newclock.second(), tmln->lbts.second());
 	  }
 
-	  if(clock < newclock) // if time has advanced, we propagate the new time
+	  if(clock < newclock) { // if time has advanced, we propagate the new time
 	    tmln->update_subsequent_timelines();
+	    window_busy = true;
+	  }
 	  clock = newclock;
 	  if(clock < tmln->lbts) break; // if the timeline is being paced or interrupted, we break out
 
@@ -599,11 +694,20 @@ void Universe::run_continuation()
       }
 
       // at this point, we don't have any runnable timeline
-      if(!blocked_timelines.empty() || !paced_timelines.empty()) {
+      if(blocked_timelines > 0 || !paced_timelines.empty()) {
 	// if there are still blocked or paced timelines
+	int64 block_start = (retuning || tracer) ? ssf_wallclock_in_nanoseconds() : 0;
+	int nblocked = blocked_timelines;
 	while(runnable_timelines.empty()) 
 	  handle_io_events(true); // handle i/o events, blocking
+	if(retuning) retune_block_wait += ssf_wallclock_in_nanoseconds()-block_start;
+	if(tracer) tracer->slice(TRACE_BLOCK, nblocked, synpoint.get_ticks(), 0, block_start);
       } else {
+	if(retuning) {
+	  window_end = ssf_wallclock_in_nanoseconds();
+	  retune_windows++;
+	  if(window_busy) retune_busy_windows++;
+	}
 	synpoint = next_window;
 	if(synpoint == next_decade) {
 	  next_decade += decade_length; 
@@ -634,34 +738,29 @@ void Universe::run_continuation()
   if(!processor_id) {
     sim_state = SIM_STATE_FINALIZING; 
 
-#ifdef HAVE_MPI_H
     if(args_nmachs > 1) {
       // send a special event to terminate the writer thread (the
       // writer thread will terminate the reader thread subsequently)
       transport_terminal_message();
 
       // wait until the threads are finished
-      if(mpi_thread_support == MPI_THREAD_MULTIPLE) {
+      if(transport->is_concurrent()) {
 	ssf_thread_join(&reader_thread_id);
 	ssf_thread_join(&writer_thread_id);
       } else return; // this is end of the new thread
     }
-#endif
   }
   run_end();
 }
 
 void Universe::run_end()
 {
-#ifdef HAVE_MPI_H
   if(args_nmachs > 1 && !processor_id) {
-    if(mpi_thread_support != MPI_THREAD_MULTIPLE) 
+    if(!transport->is_concurrent()) 
       ssf_thread_join(&rw_thread_id);
     for(int i=0; i<args_nprocs; i++) delete[] sndcnt[i];
     delete[] sndcnt;
-    delete[] rscnt; // used by mpi reduce scatter
   }
-#endif
   ssf_barrier();
 }
 
@@ -683,7 +782,7 @@ void Universe::make_timeline_runnable(Timeline* tmln)
 	 tmln->state == Timeline::STATE_WAITING);
   if(tmln->simclock < tmln->lbts) {
     if(tmln->state == Timeline::STATE_WAITING)
-      blocked_timelines.erase(tmln);
+      blocked_timelines--;
     tmln->state = Timeline::STATE_RUNNING;
     tmln->setTime(tmln->next_emulation_due_time()); // set the priority here!
     runnable_timelines.insert(tmln);
@@ -694,7 +793,7 @@ void Universe::make_timeline_runnable(Timeline* tmln)
     }
   } else if(tmln->state != Timeline::STATE_WAITING) {
     tmln->state = Timeline::STATE_WAITING;
-    blocked_timelines.insert(tmln);
+    blocked_timelines++;
     if((args_debug_mask&DEBUG_FLAG_TMSCHED) != 0) {
       printf(">> [%d:%d] timeline [%d] (readily) blocked (simclock=%lg, lbts=%lg)\n",
 	     args_rank, processor_id, tmln->serialno, 
@@ -707,7 +806,7 @@ void Universe::block_timeline(Timeline* tmln)
 {
   assert(tmln->state == Timeline::STATE_RUNNING);
   tmln->state = Timeline::STATE_WAITING;
-  blocked_timelines.insert(tmln);
+  blocked_timelines++;
   if((args_debug_mask&DEBUG_FLAG_TMSCHED) != 0) {
     printf(">> [%d:%d] timeline [%d] blocked (simclock=%lg, lbts=%lg)\n",
 	   args_rank, processor_id, tmln->serialno, 
@@ -729,6 +828,7 @@ bool Universe::pace_in_timeline(Timeline* tmln, VirtualTime untiltime)
 	     t.second(), tmln->lbts.second(), untiltime.second());
     }
     record_stats_timeline_pacing();
+    if(tracer) tracer->instant(TRACE_PACE, tmln->serialno, tmln->simclock.get_ticks(), untiltime.get_ticks());
     return true; // meaning the timeline is paced
   } else return false; // meaning it is not paced
 }
@@ -747,14 +847,12 @@ Timeline* Universe::pace_out_timeline()
   return 0;
 }
 
-#ifdef HAVE_MPI_H
 void Universe::transport_message(ChannelEvent* evt)
 {
   // an event needs to be sent out from a universe on this machine; we
   // deposit the event into the remote mailbox and notify the write
   // thread (if necessary)
-  assert(evt && !evt->inport);
-  assert(evt->stargate);
+  assert(evt && evt->stargate);
   // if the event is a null message, or if the event is not a null
   // message and the time is within the simulation end time, we count it
   if(!evt->event || (evt->event && evt->time() < args_endtime)) {
@@ -796,263 +894,347 @@ void Universe::transport_reduce_message()
     }
   }
 
-  if(mpi_thread_support != MPI_THREAD_MULTIPLE) {
-    //printf("before %d: rcvcnt=%lld, rcvcnt_target=%lld\n", args_rank, rcvcnt, rcvcnt_target); fflush(0);
-    ChannelEvent* evt = new ChannelEvent(Timestamp(0,0,0), 0, (int)1); // reduce
-    ssf_thread_mutex_lock(&remote_mailbox_mutex);
-    if(!remote_mailbox) ssf_thread_cond_signal(&remote_mailbox_cond);
-    evt->append_to_list(&remote_mailbox, &remote_mailbox_tail);
-    scatter_reduce_carry_on = false;
-    ssf_thread_mutex_unlock(&remote_mailbox_mutex);
-  
+  // the epoch marker tells the writer (or r/w) thread that all events
+  // of this round have been deposited in the remote mailbox (all
+  // universes have passed the barrier); the events after the marker
+  // will be sent in the next round; the flag for the r/w thread to
+  // carry on is cleared before the marker is deposited, since the r/w
+  // thread may set it as soon as it gets the marker
+  ssf_thread_mutex_lock(&rcvcnt_mutex);
+  scatter_reduce_carry_on = false;
+  ssf_thread_mutex_unlock(&rcvcnt_mutex);
+  ChannelEvent* evt = new ChannelEvent(Timestamp(0,0,0), 0, (int)1); // epoch marker
+  ssf_thread_mutex_lock(&remote_mailbox_mutex);
+  if(!remote_mailbox) ssf_thread_cond_signal(&remote_mailbox_cond);
+  evt->append_to_list(&remote_mailbox, &remote_mailbox_tail);
+  ssf_thread_mutex_unlock(&remote_mailbox_mutex);
+
+  if(!transport->is_concurrent()) {
+    // the r/w thread does the reduce scatter after it has flushed
+    // the events of this round
     ssf_thread_mutex_lock(&rcvcnt_mutex);
     while(!scatter_reduce_carry_on) 
       ssf_thread_cond_wait(&rcvcnt_cond, &rcvcnt_mutex); //XXX
-    ssf_thread_mutex_unlock(&rcvcnt_mutex);
-    //printf("after %d: rcvcnt=%lld, rcvcnt_target=%lld\n", args_rank, rcvcnt, rcvcnt_target); fflush(0);
   } else {
     int64 to_recv;
-    ssf_mpi_reduce_scatter(sndcnt[0], &to_recv, rscnt, MPI_LONG_LONG_INT, MPI_SUM, MPI_COMM_WORLD);
+    transport->reduce_scatter(sndcnt[0], &to_recv);
+    for(int j=0; j<args_nmachs; j++) sndcnt[0][j] = 0;
   
     // if the reader thread has not received the expected number
     // of events, processor 0 needs to wait
     ssf_thread_mutex_lock(&rcvcnt_mutex);
     rcvcnt_target = to_recv;
-    //printf("%d:%d: rcvcnt=%lld, rcvcnt_target=%lld\n", args_rank, processor_id, rcvcnt, rcvcnt_target);
-    while(rcvcnt < rcvcnt_target) //XXX
+    while(rcvcnt[recv_round&1] < rcvcnt_target) //XXX
       ssf_thread_cond_wait(&rcvcnt_cond, &rcvcnt_mutex);
-    ssf_thread_mutex_unlock(&rcvcnt_mutex);
   }
+
+  // the round is complete; the events arrived early for the next
+  // round have been counted in the other slot
+  assert(rcvcnt[recv_round&1] == rcvcnt_target);
+  rcvcnt[recv_round&1] = 0;
+  recv_round++;
+  rcvcnt_target = -1;
+  ssf_thread_mutex_unlock(&rcvcnt_mutex);
 }
 
-void Universe::transport_barrier_message()
+void Universe::handle_incoming_events(int rbfsz)
 {
-  assert(!processor_id);
-  
-  if(mpi_thread_support != MPI_THREAD_MULTIPLE) {
-    ChannelEvent* evt = new ChannelEvent(Timestamp(0,0,0), 0, (int)2); // barrier
-    ssf_thread_mutex_lock(&remote_mailbox_mutex);
-    if(!remote_mailbox) ssf_thread_cond_signal(&remote_mailbox_cond);
-    evt->append_to_list(&remote_mailbox, &remote_mailbox_tail);
-    barrier_carry_on = false;
-    ssf_thread_mutex_unlock(&remote_mailbox_mutex);
+  int nevts = 0;
+  int pos = 0;
+  int round;
+  ssf_unpack(recvbuf, rbfsz, &pos, &round, sizeof(round));
+  if(args_parallel_unpack) nevts = split_incoming_events(pos, rbfsz);
+  else {
+    // unpack the channel events and deliver them, one at a time
+    while(pos < rbfsz) {
+      int outportno;
+      Timestamp ts;
+      if(ChannelEvent::unpack_null(recvbuf, pos, rbfsz, outportno, ts))
+	deliver_incoming_null(outportno, ts, 0);
+      else {
+	ChannelEvent* evt = ChannelEvent::unpack(recvbuf, pos, rbfsz);
+	assert(evt);
+	deliver_incoming_event(evt, 0);
+      }
+      nevts++;
+    }
+    assert(pos == rbfsz);
+  }
 
-    ssf_thread_mutex_lock(&rcvcnt_mutex);
-    while(!barrier_carry_on)
-      ssf_thread_cond_wait(&bar_cond, &rcvcnt_mutex); //XXX
-    ssf_thread_mutex_unlock(&rcvcnt_mutex);
-  } else {
-    ssf_mpi_barrier(MPI_COMM_WORLD);
+  // the events must have been delivered before they are counted
+  ssf_thread_mutex_lock(&rcvcnt_mutex);
+  rcvcnt[round&1] += nevts;
+  if(round == recv_round && rcvcnt[round&1] == rcvcnt_target) {
+    scatter_reduce_carry_on = true;
+    ssf_thread_cond_signal(&rcvcnt_cond);
   }
+  ssf_thread_mutex_unlock(&rcvcnt_mutex);
 }
 
-void Universe::handle_incoming_events(int rbfsz)
+int Universe::split_incoming_events(int pos, int rbfsz)
 {
-  // unpack the channel events and deliver them, one at a time
-  int pos = 0;
+  // the reader thread doesn't unpack the events; it only finds out
+  // which universes an event is destined to and copies the packed
+  // event into the split batch of each of those universes
+  int nevts = 0;
+  VECTOR(int) marked(args_nprocs, -1); // the last event copied to each universe
   while(pos < rbfsz) {
-    ChannelEvent* evt = ChannelEvent::unpack(MPI_COMM_WORLD, recvbuf, pos, rbfsz);
-    assert(evt);
+    int start = pos;
+    Timestamp ts;
+    bool isnull;
+    int outportno = ChannelEvent::skip(recvbuf, pos, rbfsz, ts, isnull);
 
-    MAP(int,VECTOR(PAIR(MapInport*,Stargate*))*)::iterator iter = 
-      starmap.find(evt->outportno);
+    MAP(int,VECTOR(MapStarport)*)::iterator iter = starmap.find(outportno);
     assert(iter != starmap.end());
-      
-    // deliver a copy of the event to each timeline target
-    VECTOR(PAIR(MapInport*,Stargate*))* vec = (*iter).second;
-    assert(vec->size() > 0);
+    VECTOR(MapStarport)* vec = (*iter).second;
     for(int i=0; i<(int)vec->size(); i++) {
-      // all except the last one uses a cloned event
-      ChannelEvent* myevt;
-      if(i+1 < (int)vec->size()) myevt = new ChannelEvent
-	   (evt->time(), evt->event?evt->event->clone():0, evt->outportno);
-      else myevt = evt;
-
-      myevt->inport = vec->at(i).first;
-      myevt->stargate = vec->at(i).second;
-
-      // if the event is a regular channel event that goes through
-      // asynchronous channel, we send it to the mailbox at the
-      // corresponding stargate (via send_message); if this is a
-      // null message or if the channel is synchronous, we send it
-      // to the mailbox at the target universe
-      assert(myevt->stargate);
-      if(myevt->event && !myevt->stargate->in_sync) {
-	//printf("%d => async regular event\n", args_rank);
-	myevt->stargate->send_message(myevt);
-      } else {
-	//if(!myevt->event) printf("%d => null event\n", args_rank); else printf("%d => sync event\n", args_rank);
-	Universe* univ = myevt->stargate->target_timeline->universe;
-	ssf_thread_mutex_lock(&univ->mailbox_mutex);
-	if(!univ->mailbox) ssf_thread_cond_signal(&univ->mailbox_cond);
-	myevt->append_to_list(&univ->mailbox, &univ->mailbox_tail);
-	ssf_thread_mutex_unlock(&univ->mailbox_mutex);
+      Stargate* sg = vec->at(i).stargate;
+      if(isnull && sg->target_timeline_id != (int)ts.key2) continue;
+      int p = sg->target_timeline->universe->processor_id;
+      if(marked[p] == nevts) continue; // already copied for another timeline in the same universe
+      marked[p] = nevts;
+      if(!splitbuf[p]) { // create the split batch on demand
+	splitbuf[p] = new char[rbfsz]; assert(splitbuf[p]);
+	splitpos[p] = 0;
       }
+      memcpy(splitbuf[p]+splitpos[p], recvbuf+start, pos-start);
+      splitpos[p] += pos-start;
     }
+    nevts++;
+  }
+  assert(pos == rbfsz);
 
-    ssf_thread_mutex_lock(&rcvcnt_mutex);
-    //printf("%d => [%lld..%lld] recv evt at %lg\n", args_rank, rcvcnt, rcvcnt_target, VirtualTime(evt->time()).second());
-    rcvcnt++;
-    if(rcvcnt == rcvcnt_target) {
-      scatter_reduce_carry_on = true;
-      ssf_thread_cond_signal(&rcvcnt_cond);
+  // hand over the split batches to the universes
+  for(int p=0; p<args_nprocs; p++) {
+    if(!splitbuf[p]) continue;
+    ChannelBatchEvent* batch = new ChannelBatchEvent(splitbuf[p], splitpos[p]); assert(batch);
+    splitbuf[p] = 0;
+    Universe* univ = parallel_universe[p];
+    ssf_thread_mutex_lock(&univ->mailbox_mutex);
+    if(!univ->mailbox) ssf_thread_cond_signal(&univ->mailbox_cond);
+    batch->append_to_list(&univ->mailbox, &univ->mailbox_tail);
+    ssf_thread_mutex_unlock(&univ->mailbox_mutex);
+  }
+  return nevts;
+}
+
+void Universe::unpack_channel_batch(ChannelBatchEvent* batch)
+{
+  // unpack the events split for this universe and deliver them
+  int pos = 0;
+  while(pos < batch->size) {
+    int outportno;
+    Timestamp ts;
+    if(ChannelEvent::unpack_null(batch->data, pos, batch->size, outportno, ts))
+      deliver_incoming_null(outportno, ts, this);
+    else {
+      ChannelEvent* evt = ChannelEvent::unpack(batch->data, pos, batch->size);
+      assert(evt);
+      deliver_incoming_event(evt, this);
     }
-    ssf_thread_mutex_unlock(&rcvcnt_mutex);
   }
-  assert(pos == rbfsz);
+  assert(pos == batch->size);
+  delete batch;
 }
 
-bool Universe::handle_outgoing_events(ChannelEvent* evt)
+bool Universe::is_incoming_target(Stargate* sg, Universe* univ)
 {
-  SET(int) rankset; // contains the ranks of remote machines that we'll send messages to
+  return !univ || sg->target_timeline->universe == univ;
+}
+
+void Universe::deliver_incoming_event(ChannelEvent* evt, Universe* univ)
+{
+  // deliver the event from a remote machine to each timeline target;
+  // the event is sent only once to this machine with the smallest
+  // offset of all target timelines; if the universe is given, only
+  // the target timelines in the universe are considered
+  MAP(int,VECTOR(MapStarport)*)::iterator iter = 
+    starmap.find(evt->get_outportno());
+  assert(iter != starmap.end());
+  VECTOR(MapStarport)* vec = (*iter).second;
+  assert(vec->size() > 0);
+
+  assert(evt->event);
+  int ntargets = 0;
+  for(int i=0; i<(int)vec->size(); i++)
+    if(is_incoming_target(vec->at(i).stargate, univ)) ntargets++;
+  assert(ntargets > 0);
+
+  for(int i=0; i<(int)vec->size(); i++) {
+    if(!is_incoming_target(vec->at(i).stargate, univ)) continue;
+    // all except the last one uses a cloned event (the outport number
+    // is overwritten by the inport once the event is resolved)
+    ChannelEvent* myevt;
+    if(--ntargets > 0) myevt = new ChannelEvent
+	 (evt->time(), Event::share_event(evt->event), evt->get_outportno());
+    else myevt = evt;
+
+    myevt->set_inport(vec->at(i).inport);
+    myevt->stargate = vec->at(i).stargate;
+    if(vec->at(i).offset > 0) {
+      Timestamp ts = myevt->time();
+      ts.key1 += int64(vec->at(i).offset);
+      myevt->setTime(ts);
+    }
+
+    // if the event goes through asynchronous channel, we send it to
+    // the mailbox at the corresponding stargate (via send_message);
+    // if the channel is synchronous, we send it to the mailbox at the
+    // target universe (or handle it right away if it's the universe
+    // unpacking the events)
+    assert(myevt->stargate);
+    if(!myevt->stargate->in_sync) {
+      myevt->stargate->send_message(myevt);
+    } else if(univ) {
+      myevt->stargate->target_timeline->insert_event(myevt);
+    } else {
+      Universe* tuniv = myevt->stargate->target_timeline->universe;
+      ssf_thread_mutex_lock(&tuniv->mailbox_mutex);
+      if(!tuniv->mailbox) ssf_thread_cond_signal(&tuniv->mailbox_cond);
+      myevt->append_to_list(&tuniv->mailbox, &tuniv->mailbox_tail);
+      ssf_thread_mutex_unlock(&tuniv->mailbox_mutex);
+    }
+    if(!ntargets) break; // the original event has been handed over (and may be gone)
+  }
+}
+
+void Universe::deliver_incoming_null(int outportno, Timestamp ts, Universe* univ)
+{
+  // the outport may be mapped to several timelines on this machine;
+  // the null message is meant for only one target timeline, whose id
+  // is carried as the second key of the timestamp; the null message
+  // is handled right away if it's the universe unpacking the events,
+  // otherwise it's posted to the target universe
+  MAP(int,VECTOR(MapStarport)*)::iterator iter = starmap.find(outportno);
+  assert(iter != starmap.end());
+  VECTOR(MapStarport)* vec = (*iter).second;
+  for(int i=0; i<(int)vec->size(); i++) {
+    Stargate* sg = vec->at(i).stargate;
+    if(sg->target_timeline_id != (int)ts.key2) continue;
+    assert(is_incoming_target(sg, univ));
+    if(univ) sg->set_time(ts, false);
+    else sg->post_null_message(ts);
+    return;
+  }
+  assert(0);
+}
+
+void Universe::pack_outgoing_event(ChannelEvent* evt, SET(int)& rankset)
+{
+  // find the target machine rank, and pack the event into the send
+  // buffer (which starts with the round number)
+  assert(!evt->stargate->target_timeline);
+  int rank = timeline_to_machine(evt->stargate->target_timeline_id);
+  assert(rank != args_rank);
+  rankset.insert(rank);
+  if(!sendbuf[rank]) { // create send buffer on demand
+    sendbuf[rank] = new char[MPIBUF_SIZE]; assert(sendbuf[rank]);
+    sendpos[rank] = 0;
+  }
+  if(!sendpos[rank])
+    ssf_pack(&send_round, sizeof(send_round), sendbuf[rank], MPIBUF_SIZE, &sendpos[rank]);
+  evt->pack(sendbuf[rank], sendpos[rank], MPIBUF_SIZE);
+  delete evt;
+
+  // if the buffer is more than half full, we send the mpi message
+  if(sendpos[rank] > MPIBUF_THRESHOLD) {
+    record_stats_mpi_sent_messages(sendpos[rank]);
+    if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
+      printf(">> [%d] send %d bytes to %d [c=%lu,b=%lu]\n", args_rank, 
+	     sendpos[rank], rank, stats_mpi_sent_messages, stats_mpi_sent_bytes);
+    }
+    transport->send_batch(rank, sendbuf[rank], sendpos[rank]);
+    sendpos[rank] = 0; // reset to the beginning of the buffer
+    rankset.erase(rank);
+  }
+}
 
+bool Universe::handle_outgoing_events(ChannelEvent* evt)
+{
   // if the batch of events contain a terminating event (with a null
-  // 'stargate' pointer), this boolean will set to true; nullevt and
-  // nullevt_tail store all the null events in this batch of events
-  // as a linked list
+  // 'stargate' pointer), this boolean will set to true
   bool finished = false;
 
-  ChainedEvent* nullevt = 0;
-  ChainedEvent* nullevt_tail = 0;
-  bool do_reduce_scatter = false;
-  bool do_barrier = false;
+  // the events are handled in segments separated by the epoch
+  // markers, since the events after a marker belong to the next round
   while(evt) {
-    if(!evt->stargate) {
-      if(evt->outportno == 0) { // terminal
-	// if the main thread wants the writer thread to quit, we flag
-	// it for the moment
-	finished = true;
-      } else if(evt->outportno == 1) { // reduce scatter
-	do_reduce_scatter = true;
-      } else { // barrier
-	do_barrier = true;
-      }
-      ChannelEvent* nxt = (ChannelEvent*)evt->get_next_event();
-      delete evt;
-      evt = nxt;
-    } else if(!evt->event) { 
-      //printf("%d => null event!\n", args_rank); fflush(0);
-      // if this is a null event, we put it in the linked list for
-      // now; we'll send them later
-      ChannelEvent* nxt = (ChannelEvent*)evt->get_next_event();
-      evt->append_to_list(&nullevt, &nullevt_tail);
-      evt = nxt;
-    } else if(args_endtime <= evt->time()) { 
-      //printf("%d => regular event beyond end time!\n", args_rank); fflush(0);
-      // if a regular event is beyond the simulation end time,
-      // there's no need to send it, we simply delete it
+    SET(int) rankset; // contains the ranks of remote machines that we'll send messages to
+
+    // nullevt and nullevt_tail store all the null events in this
+    // segment of events as a linked list
+    ChainedEvent* nullevt = 0;
+    ChainedEvent* nullevt_tail = 0;
+    bool end_of_round = false;
+    while(evt && !end_of_round) {
       ChannelEvent* nxt = (ChannelEvent*)evt->get_next_event();
-      delete evt;
-      evt = nxt;
-    } else {
-      //printf("%d => regular event!\n", args_rank); fflush(0);
-      // for any other regular event, we find the target machine
-      // rank, and pack the event into the send buffer
-      assert(!evt->stargate->target_timeline);
-      int rank = timeline_to_machine(evt->stargate->target_timeline_id);
-      assert(rank != args_rank);
-      rankset.insert(rank);
-      if(!sendbuf[rank]) { // create send buffer on demand
-	sendbuf[rank] = new char[MPIBUF_SIZE]; assert(sendbuf[rank]);
-	sendpos[rank] = 0;
-      }
-      evt->pack(MPI_COMM_WORLD, sendbuf[rank], sendpos[rank], MPIBUF_SIZE);
-
-      ChannelEvent* nxt = (ChannelEvent*)evt->get_next_event();
-      delete evt;
-      evt = nxt;
-
-      // if the buffer is more than half full, we send the mpi message
-      if(sendpos[rank] > MPIBUF_THRESHOLD) {
-	record_stats_mpi_sent_messages(sendpos[rank]);
-	if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
-	  printf(">> [%d] send %d bytes to %d [c=%lu,b=%lu]\n", args_rank, 
-		 sendpos[rank], rank, stats_mpi_sent_messages, stats_mpi_sent_bytes);
+      if(!evt->stargate) {
+	if(evt->get_outportno() == 0) { // terminal
+	  // if the main thread wants the writer thread to quit, we flag
+	  // it for the moment
+	  finished = true;
+	} else { // epoch marker
+	  end_of_round = true;
 	}
-	ssf_mpi_bsend(sendbuf[rank], sendpos[rank], MPI_PACKED, rank, 
-		      CHANNEL_EVENT_TAG, MPI_COMM_WORLD);
-	sendpos[rank] = 0; // reset to the beginning of the buffer
-	rankset.erase(rank);
+	delete evt;
+      } else if(!evt->event) { 
+	// if this is a null event, we put it in the linked list for
+	// now; we'll send them later
+	evt->append_to_list(&nullevt, &nullevt_tail);
+      } else if(args_endtime <= evt->time()) { 
+	// if a regular event is beyond the simulation end time,
+	// there's no need to send it, we simply delete it
+	delete evt;
+      } else {
+	// for any other regular event, we pack it into the send buffer
+	pack_outgoing_event(evt, rankset);
       }
+      evt = nxt;
     }
-  }
 
-  while(nullevt) {
-    // for each null event, we find its target machine rank, and
-    // pack the event into the send buffer
-    assert(!((ChannelEvent*)nullevt)->stargate->target_timeline);
-    int rank = timeline_to_machine(((ChannelEvent*)nullevt)->stargate->target_timeline_id);
-    assert(rank != args_rank);
-    rankset.insert(rank);
-    if(!sendbuf[rank]) {
-      sendbuf[rank] = new char[MPIBUF_SIZE]; assert(sendbuf[rank]);
-      sendpos[rank] = 0;
+    while(nullevt) {
+      ChannelEvent* nxt = (ChannelEvent*)nullevt->get_next_event();
+      pack_outgoing_event((ChannelEvent*)nullevt, rankset);
+      nullevt = nxt;
     }
-    //printf("%d: PACKING for sending null event to rank %d\n", args_rank, rank);
-    ((ChannelEvent*)nullevt)->pack(MPI_COMM_WORLD, sendbuf[rank], sendpos[rank], MPIBUF_SIZE);
-
-    ChannelEvent* nxt = (ChannelEvent*)nullevt->get_next_event();
-    delete nullevt;
-    nullevt = nxt;
 
-    // if the buffer is more than half full, we send the mpi message
-    if(sendpos[rank] > MPIBUF_THRESHOLD) {
+    // for each send buffer with packed events, we send the mpi message
+    for(SET(int)::iterator iter = rankset.begin(); 
+	iter != rankset.end(); iter++) {
+      int rank = *iter;
+      assert(sendpos[rank] > 0);
       record_stats_mpi_sent_messages(sendpos[rank]);
       if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
 	printf(">> [%d] send %d bytes to %d [c=%lu,b=%lu]\n", args_rank, 
 	       sendpos[rank], rank, stats_mpi_sent_messages, stats_mpi_sent_bytes);
       }
-      ssf_mpi_bsend(sendbuf[rank], sendpos[rank], MPI_PACKED, rank, 
-		    CHANNEL_EVENT_TAG, MPI_COMM_WORLD);
+      TraceBuffer* mpi_tracer = transport_tracer(send_trace_buffer);
+      int64 send_start = mpi_tracer ? ssf_wallclock_in_nanoseconds() : 0;
+      transport->send_batch(rank, sendbuf[rank], sendpos[rank]);
+      if(mpi_tracer) mpi_tracer->slice(TRACE_MPI_SEND, rank, 0, sendpos[rank], send_start);
       sendpos[rank] = 0; // reset to the beginning of the buffer
-      rankset.erase(rank);
-    }
-  }
-
-  // for each send buffer with packed events, we send the mpi message
-  for(SET(int)::iterator iter = rankset.begin(); 
-      iter != rankset.end(); iter++) {
-    int rank = *iter;
-    assert(sendpos[rank] > 0);
-    record_stats_mpi_sent_messages(sendpos[rank]);
-    if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
-      printf(">> [%d] send %d bytes to %d [c=%lu,b=%lu]\n", args_rank, 
-	     sendpos[rank], rank, stats_mpi_sent_messages, stats_mpi_sent_bytes);
     }
-    ssf_mpi_bsend(sendbuf[rank], sendpos[rank], MPI_PACKED, rank, 
-		  CHANNEL_EVENT_TAG, MPI_COMM_WORLD);
-    sendpos[rank] = 0; // reset to the beginning of the buffer
-  }
-  rankset.clear();
-
-  if(do_reduce_scatter) {
-    // if the main thread wants to do a reduce scatter (this only
-    // happens when we use a single r/w thread)
-    //printf("%d => about to reduce scatter!\n", args_rank); fflush(0);
-    int64 to_recv;
-    ssf_mpi_reduce_scatter(sndcnt[0], &to_recv, rscnt, MPI_LONG_LONG_INT, 
-			   MPI_SUM, MPI_COMM_WORLD);
+    rankset.clear();
+
+    if(end_of_round) {
+      // all events of this round have been sent
+      send_round++;
+
+      if(!transport->is_concurrent()) {
+	// if we use a single r/w thread, it does the reduce scatter
+	// on behalf of processor 0 (which is waiting)
+	int64 to_recv;
+	transport->reduce_scatter(sndcnt[0], &to_recv);
+	for(int j=0; j<args_nmachs; j++) sndcnt[0][j] = 0;
     
-    ssf_thread_mutex_lock(&rcvcnt_mutex);
-    rcvcnt_target = to_recv; assert(rcvcnt <= rcvcnt_target);
-    if(rcvcnt == rcvcnt_target) {
-      //printf("SIGNALED!!!\n"); fflush(0);
-      scatter_reduce_carry_on = true;
-      ssf_thread_cond_signal(&rcvcnt_cond); //XXX
+	ssf_thread_mutex_lock(&rcvcnt_mutex);
+	rcvcnt_target = to_recv; assert(rcvcnt[recv_round&1] <= rcvcnt_target);
+	if(rcvcnt[recv_round&1] == rcvcnt_target) {
+	  scatter_reduce_carry_on = true;
+	  ssf_thread_cond_signal(&rcvcnt_cond); //XXX
+	}
+	ssf_thread_mutex_unlock(&rcvcnt_mutex);
+      }
     }
-    ssf_thread_mutex_unlock(&rcvcnt_mutex);
-    //printf("%d => [%lld..%lld] done reduce scatter at %lg\n", args_rank, rcvcnt, rcvcnt_target, VirtualTime(evt->time()).second()); fflush(0);
-  }
-
-  if(do_barrier) {
-    //printf("%d => about to barrier!\n", args_rank); fflush(0);
-    ssf_mpi_barrier(MPI_COMM_WORLD);
-	
-    ssf_thread_mutex_lock(&rcvcnt_mutex);
-    barrier_carry_on = true;
-    ssf_thread_cond_signal(&bar_cond); //XXX
-    ssf_thread_mutex_unlock(&rcvcnt_mutex);
-    //printf("%d => done barrier!\n", args_rank); fflush(0);
   }
 
   return finished;
@@ -1063,33 +1245,35 @@ void Universe::reader_thread()
   // the receive buffer has been created when this thread is running
   for(;;) {
     // blocking receive
-    MPI_Status status;
-    ssf_mpi_recv(recvbuf, MPIBUF_SIZE, MPI_PACKED, MPI_ANY_SOURCE, 
-		 CHANNEL_EVENT_TAG, MPI_COMM_WORLD, &status);
+    int source;
+    int rbfsz = transport->recv_batch(recvbuf, MPIBUF_SIZE, &source);
 
     // if we receive a message from the same machine, it indicates
     // that the reader thread should terminate by now (it's a hack)
-    if(status.MPI_SOURCE == args_rank) {
+    if(source == args_rank) {
       if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
 	printf(">> [%d] reader thread has been instructed to end\n", args_rank);
       }
       break;
     }
 
-    // check incoming message size
-    int rbfsz;
-    ssf_mpi_get_count(&status, MPI_PACKED, &rbfsz);
-
     record_stats_mpi_rcvd_messages(rbfsz);
     if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
       printf(">> [%d] receive %d bytes from %d [c=%lu,b=%lu]\n", args_rank,
-	     rbfsz, status.MPI_SOURCE, stats_mpi_rcvd_messages, stats_mpi_rcvd_bytes);
+	     rbfsz, source, stats_mpi_rcvd_messages, stats_mpi_rcvd_bytes);
     }
+    TraceBuffer* mpi_tracer = transport_tracer(recv_trace_buffer);
+    int64 recv_start = mpi_tracer ? ssf_wallclock_in_nanoseconds() : 0;
     handle_incoming_events(rbfsz);
+    if(mpi_tracer) mpi_tracer->slice(TRACE_MPI_RECV, source, 0, rbfsz, recv_start);
   }
 
   // reclaim the receive buffer
   delete[] recvbuf;
+  if(splitbuf) {
+    delete[] splitbuf; 
+    delete[] splitpos;
+  }
 }
 
 void Universe::writer_thread()
@@ -1108,14 +1292,11 @@ void Universe::writer_thread()
     bool finished = handle_outgoing_events(evt);
     if(finished) {
       // if the main thread wants to terminate, first inform the
-      // reader thread to finish by sending an mpi message (a packed
-      // dummy integer) to the same machine, and then break out
-      char mybuf[128]; int dummy = 0; int pos = 0;
-      ssf_mpi_pack(&dummy, 1, MPI_INT, mybuf, 128, &pos, MPI_COMM_WORLD);
-      ssf_mpi_bsend(mybuf, pos, MPI_PACKED, args_rank, CHANNEL_EVENT_TAG, MPI_COMM_WORLD);
+      // reader thread to finish by interrupting the transport, and
+      // then break out
+      transport->interrupt();
       if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
-	printf(">> [%d] writer thread informing reader thread to end (size=%d)\n", 
-	       args_rank, pos);
+	printf(">> [%d] writer thread informing reader thread to end\n", args_rank);
       }
       break; // we are done!
     }
@@ -1127,68 +1308,38 @@ void Universe::writer_thread()
   delete[] sendbuf;
   delete[] sendpos;
   sendbuf = 0;
-  int attachsiz; char* attachbuf;
-  ssf_mpi_buffer_detach(&attachbuf, &attachsiz);
-  assert(attachsiz==MPIBUF_ATTACHED);
-  delete[] attachbuf;
 }
 
 void Universe::rw_thread()
 {
   SET(int) rankset; // contains the ranks of remote machines that we'll send messages to
 
-  /*
-  MPI_Request request;
-  if(MPI_Irecv(recvbuf, MPIBUF_SIZE, MPI_PACKED, MPI_ANY_SOURCE, 
-	       CHANNEL_EVENT_TAG, MPI_COMM_WORLD, &request))
-    SSF_THROW("unable to post irecv");
-  */
-
   bool finished = false;
   while(!finished) {
     //printf("*"); fflush(0);
     //ssf_thread_yield();
 
-    int flag;
-    MPI_Status status;
-    ssf_mpi_iprobe(MPI_ANY_SOURCE, CHANNEL_EVENT_TAG, MPI_COMM_WORLD, &flag, &status);
-    /*
-    if(MPI_Test(&request, &flag, &status)) SSF_THROW("unable to mpi test");
-    */
-    if(flag) {
-      // check incoming message size
-      int rbfsz;
-      ssf_mpi_get_count(&status, MPI_PACKED, &rbfsz);
-      if(rbfsz > MPIBUF_SIZE) SSF_THROW("increase MPIBUF_SIZ to receive jumbo message: msgsiz=" << rbfsz);
-
-      ssf_mpi_recv(recvbuf, rbfsz/*MPIBUF_SIZE*/, MPI_PACKED, status.MPI_SOURCE/*MPI_ANY_SOURCE*/, 
-		   status.MPI_TAG/*CHANNEL_EVENT_TAG*/, MPI_COMM_WORLD, &status);
+    int source;
+    int rbfsz = transport->poll_batch(recvbuf, MPIBUF_SIZE, &source);
+    if(rbfsz >= 0) {
       // if we receive a message from the same machine, it indicates
       // that the reader thread should terminate by now (it's a hack)
-      if(status.MPI_SOURCE == args_rank) {
+      if(source == args_rank) {
 	if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
 	  printf(">> [%d] reader thread has been instructed to end\n", args_rank);
 	}
 	break;
       }
-#ifndef NDEBUG
-      // WE ASSUME (ACCORDING TO MANPAGE) THE RECEIVED MESSAGE IS THE ONE PROBED
-      int t; ssf_mpi_get_count(&status, MPI_PACKED, &t); 
-      if(t != rbfsz) SSF_THROW("internal error: invalid iprobe/recv sequence");
-#endif
 
       record_stats_mpi_rcvd_messages(rbfsz);
       if((args_debug_mask&DEBUG_FLAG_MPIMSG) != 0) {
 	printf(">> [%d] receive %d bytes from %d [c=%lu,b=%lu]\n", args_rank,
-	       rbfsz, status.MPI_SOURCE, stats_mpi_rcvd_messages, stats_mpi_rcvd_bytes);
+	       rbfsz, source, stats_mpi_rcvd_messages, stats_mpi_rcvd_bytes);
       }
+      TraceBuffer* mpi_tracer = transport_tracer(recv_trace_buffer);
+      int64 recv_start = mpi_tracer ? ssf_wallclock_in_nanoseconds() : 0;
       handle_incoming_events(rbfsz);
-      
-      /*
-      if(MPI_Irecv(recvbuf, MPIBUF_SIZE, MPI_PACKED, MPI_ANY_SOURCE, 
-		   CHANNEL_EVENT_TAG, MPI_COMM_WORLD, &request))
-	SSF_THROW("unable to post irecv");
-      */
+      if(mpi_tracer) mpi_tracer->slice(TRACE_MPI_RECV, source, 0, rbfsz, recv_start);
     } else { 
       // wait on the conditional variable, until there are one or more
       // events have been deposited in the remote mailbox
@@ -1219,13 +1370,12 @@ void Universe::rw_thread()
   delete[] sendbuf;
   delete[] sendpos;
   sendbuf = 0;
-  int attachsiz; char* attachbuf;
-  ssf_mpi_buffer_detach(&attachbuf, &attachsiz);
-  assert(attachsiz==MPIBUF_ATTACHED);
-  delete[] attachbuf;
   delete[] recvbuf;
+  if(splitbuf) {
+    delete[] splitbuf; 
+    delete[] splitpos;
+  }
 }
-#endif
 
 void Universe::insert_emulated_event(Timeline* tmln, EmulatedEvent* myevt)
 {
@@ -1290,18 +1440,20 @@ void Universe::handle_io_events(bool blocking)
   // handle the null events
   while(evt) {
     ChainedEvent* nxt = evt->get_next_event();
-    if(evt->is_channel_event()) {
+    if(evt->is_channel_batch()) {
+      unpack_channel_batch((ChannelBatchEvent*)evt);
+    } else if(evt->is_channel_event()) {
       ChannelEvent* chevt = (ChannelEvent*)evt;
       assert(chevt->stargate); 
       assert(chevt->stargate->target_timeline->universe == this);
-      //assert(!chevt->event || chevt->stargate->in_sync); // must be null message or the event is supposed going through synchronous channel
-      if(!chevt->event) {
-	chevt->stargate->set_time(chevt->time(), false);
-	delete chevt;
-      } else {
-	assert(!chevt->stargate->source_timeline);
-	chevt->stargate->target_timeline->insert_event(chevt);
-      }
+      assert(chevt->event); // null messages are posted as NullMessage
+      assert(!chevt->stargate->source_timeline);
+      chevt->stargate->target_timeline->insert_event(chevt);
+    } else if(evt->is_null_message()) {
+      // the null message is owned by the stargate and reused
+      NullMessage* nmsg = (NullMessage*)evt;
+      assert(nmsg->stargate->target_timeline->universe == this);
+      nmsg->stargate->receive_null_message();
     } else {
       EmulatedEvent* eevt = (EmulatedEvent*)evt;
       Timeline* tmln = eevt->entity->timeline;
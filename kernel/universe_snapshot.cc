@@ -0,0 +1,482 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "kernel/universe.h"
+#include "ssf.h"
+
+namespace minissf {
+
+// the model snapshot is a binary file (one for each machine) in the
+// native byte order, to be loaded on the same platform; the file is
+// mapped into memory and read sequentially:
+//   1) magic string, format version, number of machines, machine rank;
+//   2) number of entities, and the state of each entity (in the order
+//      their init() methods are called), each as length and bytes;
+//   3) ranges of timeline serial numbers of all machines;
+//   4) timelines (in order of serial numbers), each with its serial
+//      number, the first entity serial number and outport number, and
+//      for each entity, its index and numbers of in/outchannels;
+//   5) stargates, each with the source and target timeline ids,
+//      whether they are local, the outport number, and min delay;
+//   6) for each timeline, its inbound and outbound stargates;
+//   7) for each outchannel (by entity, then in order of creation),
+//      the outports, each with the stargate, min offset, colocated
+//      outport, carried flag, and the inports (inchannel and delay);
+//   8) the starmap for fanning out events from remote machines.
+#define SNAPSHOT_MAGIC "MSSFSNAP"
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_SOURCE_LOCAL 1
+#define SNAPSHOT_TARGET_LOCAL 2
+
+VECTOR(Entity*) Universe::snapshot_entities;
+VECTOR(STRING) Universe::snapshot_states;
+VECTOR(PAIR(const char*,int)) Universe::snapshot_blobs;
+VECTOR(Timeline*) Universe::snapshot_timelines;
+
+static char* snapshot_map = 0; // the snapshot file mapped into memory
+static size_t snapshot_size = 0; // the size of the snapshot file
+static const char* snapshot_cursor = 0; // the position to read next
+
+static void put_int(STRING& buf, int x) { buf.append((const char*)&x, sizeof(int)); }
+
+static void put_time(STRING& buf, VirtualTime t) { int64 x = (int64)t; buf.append((const char*)&x, sizeof(int64)); }
+
+static void put_inports(STRING& buf, MapInport* inport, UNORDERED_MAP(inChannel*,PAIR(int,int))& icidx)
+{
+  int n = 0;
+  for(MapInport* p = inport; p; p = p->next) n++;
+  put_int(buf, n);
+  for(MapInport* p = inport; p; p = p->next) {
+    UNORDERED_MAP(inChannel*,PAIR(int,int))::iterator iter = icidx.find(p->ic);
+    assert(iter != icidx.end());
+    put_int(buf, (*iter).second.first);
+    put_int(buf, (*iter).second.second);
+    put_time(buf, p->extra_delay);
+  }
+}
+
+static void get_bytes(void* p, size_t n)
+{
+  if(n > snapshot_size-(snapshot_cursor-snapshot_map))
+    SSF_THROW("corrupted model snapshot: unexpected end of file");
+  memcpy(p, snapshot_cursor, n);
+  snapshot_cursor += n;
+}
+
+static int get_int() { int x; get_bytes(&x, sizeof(int)); return x; }
+
+static VirtualTime get_time() { int64 x; get_bytes(&x, sizeof(int64)); VirtualTime t; t = x; return t; }
+
+// read an index in the range [0,n), or -1 if allowed
+static int get_index(int n, bool nullable = false)
+{
+  int x = get_int();
+  if(x >= n || x < (nullable ? -1 : 0))
+    SSF_THROW("corrupted model snapshot: index out of range");
+  return x;
+}
+
+static MapInport* get_inports(const VECTOR(Entity*)& ents)
+{
+  int n = get_int();
+  if(n < 0) SSF_THROW("corrupted model snapshot: bad number of inports");
+  MapInport* head = 0;
+  MapInport** tail = &head;
+  for(int i=0; i<n; i++) {
+    Entity* ent = ents[get_index(ents.size())];
+    inChannel* ic = ent->getInChannels()[get_index(ent->getInChannels().size())];
+    MapInport* inport = new MapInport(ic); assert(inport);
+    inport->extra_delay = get_time();
+    *tail = inport; tail = &inport->next;
+  }
+  return head;
+}
+
+void Universe::open_model_snapshot()
+{
+  int fd = open(args_load_model.c_str(), O_RDONLY);
+  if(fd < 0) SSF_THROW("can't open model snapshot: " << args_load_model);
+  struct stat st;
+  if(fstat(fd, &st) < 0 || st.st_size <= 0) {
+    close(fd);
+    SSF_THROW("can't read model snapshot: " << args_load_model);
+  }
+  snapshot_size = st.st_size;
+  void* p = mmap(0, snapshot_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(p == MAP_FAILED) SSF_THROW("can't map model snapshot: " << args_load_model);
+  snapshot_map = (char*)p;
+  snapshot_cursor = snapshot_map;
+
+  char magic[8];
+  get_bytes(magic, 8);
+  if(memcmp(magic, SNAPSHOT_MAGIC, 8) || get_int() != SNAPSHOT_VERSION)
+    SSF_THROW("not a model snapshot: " << args_load_model);
+  int nmachs = get_int();
+  int rank = get_int();
+  if(nmachs != args_nmachs || rank != args_rank)
+    SSF_THROW("model snapshot " << args_load_model << " is for machine " << rank << " of " << nmachs);
+
+  // the entity states are used in place when the entities are initialized
+  int nents = get_int();
+  if(nents < 0) SSF_THROW("corrupted model snapshot: bad number of entities");
+  snapshot_blobs.reserve(nents);
+  for(int i=0; i<nents; i++) {
+    int len = get_int();
+    if(len < 0 || (size_t)len > snapshot_size-(snapshot_cursor-snapshot_map))
+      SSF_THROW("corrupted model snapshot: bad entity state");
+    snapshot_blobs.push_back(MAKE_PAIR(snapshot_cursor, len));
+    snapshot_cursor += len;
+  }
+}
+
+void Universe::add_snapshot_entities()
+{
+  snapshot_entities.insert(snapshot_entities.end(), init_entities.begin(), init_entities.end());
+  if(!args_save_model.empty()) snapshot_states.resize(snapshot_entities.size());
+  if(!args_load_model.empty() && snapshot_entities.size() > snapshot_blobs.size())
+    SSF_THROW("model does not match the snapshot: more than " << snapshot_blobs.size() << " entities");
+}
+
+void Universe::serialize_entity(int idx)
+{
+  // the entities of this round are at the end of the list; each
+  // processor writes only to the slots of its own entities
+  int k = snapshot_entities.size()-init_entities.size()+idx;
+  if(!args_load_model.empty()) {
+    Snapshot snapshot(snapshot_blobs[k].first, snapshot_blobs[k].second);
+    init_entities[idx]->serialize(&snapshot);
+    if(!args_save_model.empty()) // pass it on to the new snapshot
+      snapshot_states[k].assign(snapshot_blobs[k].first, snapshot_blobs[k].second);
+  } else {
+    Snapshot snapshot(&snapshot_states[k]);
+    init_entities[idx]->serialize(&snapshot);
+  }
+}
+
+void Universe::restore_timelines()
+{
+  int nents = snapshot_entities.size();
+  if(nents != (int)snapshot_blobs.size())
+    SSF_THROW("model does not match the snapshot: " << nents << " entities created, " <<
+	      snapshot_blobs.size() << " expected");
+
+  // the timelines formed by aligning the entities are dissolved
+  for(SET(Timeline*)::iterator tmln_iter = created_timelines.begin();
+      tmln_iter != created_timelines.end(); tmln_iter++) {
+    Timeline* tmln = *tmln_iter;
+    for(VECTOR(Entity*)::iterator e_iter = tmln->entities.begin();
+	e_iter != tmln->entities.end(); e_iter++)
+      (*e_iter)->timeline = 0;
+    tmln->entities.clear();
+    delete tmln;
+  }
+  created_timelines.clear();
+  orphan_entities.clear();
+  if(args_save_profile.empty()) entity_births.clear(); // the profile refers to entities in order
+
+  timeline_scans = new int[args_nmachs]; assert(timeline_scans);
+  for(int i=0; i<args_nmachs; i++) timeline_scans[i] = get_int();
+
+  // recreate the timelines with the same serial numbers and port
+  // numbers; they are assigned to the universes in blocks, which
+  // works even if the number of processors has changed
+  int nt = get_int();
+  if(nt < 0) SSF_THROW("corrupted model snapshot: bad number of timelines");
+  int aligned = 0;
+  snapshot_timelines.reserve(nt);
+  for(int t=0; t<nt; t++) {
+    int tsn = get_int();
+    int startne = get_int();
+    int startnp = get_int();
+    int ne = get_int();
+    if(ne <= 0) SSF_THROW("corrupted model snapshot: empty timeline");
+    Timeline* tmln = new Timeline(); assert(tmln);
+    for(int j=0; j<ne; j++) {
+      int idx = get_index(nents);
+      Entity* ent = snapshot_entities[idx];
+      if(ent->timeline) SSF_THROW("corrupted model snapshot: entity aligned twice");
+      int nin = get_int();
+      int nout = get_int();
+      if(nin != (int)ent->inchannels.size() || nout != (int)ent->outchannels.size())
+	SSF_THROW("model does not match the snapshot: entity " << idx << " has " << 
+		  ent->inchannels.size() << " inchannels and " << ent->outchannels.size() <<
+		  " outchannels, " << nin << " and " << nout << " expected");
+      tmln->add_entity(ent);
+    }
+    aligned += ne;
+    tmln->settle_serialno(tsn, startne);
+    tmln->settle_portno(startnp);
+    snapshot_timelines.push_back(tmln);
+  }
+  if(aligned != nents) SSF_THROW("corrupted model snapshot: entities not aligned");
+  distribute_timelines(snapshot_timelines);
+}
+
+void Universe::restore_channels()
+{
+  int nt = snapshot_timelines.size();
+  int startnt = args_rank ? timeline_scans[args_rank-1] : 0;
+
+  int nsg = get_int();
+  if(nsg < 0) SSF_THROW("corrupted model snapshot: bad number of stargates");
+  VECTOR(Stargate*) sgs;
+  sgs.reserve(nsg);
+  for(int k=0; k<nsg; k++) {
+    int srcid = get_int();
+    int tgtid = get_int();
+    int flags = get_int();
+    int outportno = get_int();
+    VirtualTime delay = get_time();
+    Timeline* src = 0;
+    Timeline* tgt = 0;
+    if(flags&SNAPSHOT_SOURCE_LOCAL) {
+      if(srcid < startnt || srcid >= startnt+nt) SSF_THROW("corrupted model snapshot: bad stargate");
+      src = snapshot_timelines[srcid-startnt];
+    }
+    if(flags&SNAPSHOT_TARGET_LOCAL) {
+      if(tgtid < startnt || tgtid >= startnt+nt) SSF_THROW("corrupted model snapshot: bad stargate");
+      tgt = snapshot_timelines[tgtid-startnt];
+    }
+    Stargate* sg;
+    if(src && tgt) sg = new Stargate(src, tgt);
+    else if(src) sg = new Stargate(src, tgtid, outportno);
+    else if(tgt) sg = new Stargate(srcid, outportno, tgt);
+    else SSF_THROW("corrupted model snapshot: bad stargate");
+    assert(sg);
+    sg->outportno = outportno;
+    sg->min_delay = delay;
+    sgs.push_back(sg);
+  }
+
+  // the stargates are added to the timelines by the constructors;
+  // they are put back in the original order here
+  for(int t=0; t<nt; t++) {
+    Timeline* tmln = snapshot_timelines[t];
+    tmln->inbound.clear();
+    int n = get_int();
+    for(int i=0; i<n; i++) tmln->inbound.push_back(sgs[get_index(nsg)]);
+    tmln->outbound.clear();
+    n = get_int();
+    for(int i=0; i<n; i++) tmln->outbound.push_back(sgs[get_index(nsg)]);
+  }
+
+  for(VECTOR(Entity*)::iterator e_iter = snapshot_entities.begin();
+      e_iter != snapshot_entities.end(); e_iter++) {
+    for(VECTOR(outChannel*)::iterator oc_iter = (*e_iter)->outchannels.begin();
+	oc_iter != (*e_iter)->outchannels.end(); oc_iter++) {
+      outChannel* oc = *oc_iter;
+      int n = get_int();
+      if(n < 0) SSF_THROW("corrupted model snapshot: bad number of outports");
+      VECTOR(PAIR(MapOutport*,int)) outports;
+      MapOutport** tail = &oc->outports;
+      for(int i=0; i<n; i++) {
+	int sgidx = get_index(nsg, true);
+	VirtualTime offset = get_time();
+	int colocated = get_index(n, true);
+	int carried = get_int();
+	MapInport* inport = get_inports(snapshot_entities);
+	MapOutport* outport = new MapOutport((sgidx < 0) ? 0 : sgs[sgidx], inport, offset); 
+	assert(outport);
+	outport->carried = (carried != 0);
+	*tail = outport; tail = &outport->next;
+	outports.push_back(MAKE_PAIR(outport, colocated));
+      }
+      for(int i=0; i<n; i++)
+	if(outports[i].second >= 0)
+	  outports[i].first->colocated = outports[outports[i].second].first;
+    }
+  }
+
+  int nsm = get_int();
+  if(nsm < 0) SSF_THROW("corrupted model snapshot: bad starmap");
+  for(int k=0; k<nsm; k++) {
+    int outportno = get_int();
+    int n = get_int();
+    if(n <= 0) SSF_THROW("corrupted model snapshot: bad starmap");
+    VECTOR(MapStarport)* vec = new VECTOR(MapStarport); assert(vec);
+    vec->reserve(n);
+    for(int i=0; i<n; i++) {
+      Stargate* sg = sgs[get_index(nsg)];
+      VirtualTime offset = get_time();
+      MapInport* inport = get_inports(snapshot_entities);
+      vec->push_back(MapStarport(inport, sg, offset));
+    }
+    if(!starmap.insert(MAKE_PAIR(outportno,vec)).second) 
+      SSF_THROW("corrupted model snapshot: bad starmap");
+  }
+  if(snapshot_cursor != snapshot_map+snapshot_size)
+    SSF_THROW("corrupted model snapshot: trailing data");
+
+  // the named inchannels are no longer needed
+  local_icmap.clear();
+  remote_icmap.clear();
+
+  created_timelines.clear();
+  snapshot_timelines.clear();
+  snapshot_blobs.clear();
+  munmap(snapshot_map, snapshot_size);
+  snapshot_map = 0; snapshot_cursor = 0; snapshot_size = 0;
+  if(args_save_model.empty()) snapshot_entities.clear();
+}
+
+void Universe::save_model_snapshot()
+{
+  STRING buf;
+  buf.append(SNAPSHOT_MAGIC, 8);
+  put_int(buf, SNAPSHOT_VERSION);
+  put_int(buf, args_nmachs);
+  put_int(buf, args_rank);
+
+  int nents = snapshot_entities.size();
+  assert(nents == (int)snapshot_states.size());
+  put_int(buf, nents);
+  for(int i=0; i<nents; i++) {
+    put_int(buf, (int)snapshot_states[i].length());
+    buf.append(snapshot_states[i]);
+  }
+  snapshot_states.clear();
+
+  for(int i=0; i<args_nmachs; i++) put_int(buf, timeline_scans[i]);
+
+  // the timelines are written in the order of their serial numbers;
+  // the entities and inchannels are referred to by their indices
+  VECTOR(PAIR(int,Timeline*)) tvec;
+  for(int p=0; p<args_nprocs; p++) {
+    Universe* univ = parallel_universe[p]; assert(univ);
+    for(SET(Timeline*)::iterator tmln_iter = univ->timelines.begin();
+	tmln_iter != univ->timelines.end(); tmln_iter++)
+      tvec.push_back(MAKE_PAIR((*tmln_iter)->serialno, *tmln_iter));
+  }
+  std::sort(tvec.begin(), tvec.end());
+  UNORDERED_MAP(Entity*,int) eidx;
+  UNORDERED_MAP(inChannel*,PAIR(int,int)) icidx;
+  for(int i=0; i<nents; i++) {
+    Entity* ent = snapshot_entities[i];
+    eidx.insert(MAKE_PAIR(ent, i));
+    for(int j=0; j<(int)ent->inchannels.size(); j++)
+      icidx.insert(MAKE_PAIR(ent->inchannels[j], MAKE_PAIR(i, j)));
+  }
+  put_int(buf, (int)tvec.size());
+  for(VECTOR(PAIR(int,Timeline*))::iterator t_iter = tvec.begin(); t_iter != tvec.end(); t_iter++) {
+    Timeline* tmln = (*t_iter).second;
+    assert(!tmln->entities.empty());
+    int startnp = 0;
+    for(VECTOR(Entity*)::iterator e_iter = tmln->entities.begin();
+	e_iter != tmln->entities.end(); e_iter++) {
+      if(!(*e_iter)->outchannels.empty()) {
+	startnp = (*e_iter)->outchannels[0]->portno;
+	break;
+      }
+    }
+    put_int(buf, tmln->serialno);
+    put_int(buf, tmln->entities[0]->serialno);
+    put_int(buf, startnp);
+    put_int(buf, (int)tmln->entities.size());
+    for(VECTOR(Entity*)::iterator e_iter = tmln->entities.begin();
+	e_iter != tmln->entities.end(); e_iter++) {
+      UNORDERED_MAP(Entity*,int)::iterator iter = eidx.find(*e_iter);
+      assert(iter != eidx.end());
+      put_int(buf, (*iter).second);
+      put_int(buf, (int)(*e_iter)->inchannels.size());
+      put_int(buf, (int)(*e_iter)->outchannels.size());
+    }
+  }
+
+  UNORDERED_MAP(Stargate*,int) sgidx;
+  put_int(buf, (int)created_stargates.size());
+  for(MAP(PAIR(int,int),Stargate*)::iterator sg_iter = created_stargates.begin();
+      sg_iter != created_stargates.end(); sg_iter++) {
+    Stargate* sg = (*sg_iter).second;
+    sgidx.insert(MAKE_PAIR(sg, (int)sgidx.size()));
+    put_int(buf, sg->source_timeline_id);
+    put_int(buf, sg->target_timeline_id);
+    put_int(buf, (sg->source_timeline ? SNAPSHOT_SOURCE_LOCAL : 0) | 
+	    (sg->target_timeline ? SNAPSHOT_TARGET_LOCAL : 0));
+    put_int(buf, sg->outportno);
+    put_time(buf, sg->min_delay);
+  }
+  for(VECTOR(PAIR(int,Timeline*))::iterator t_iter = tvec.begin(); t_iter != tvec.end(); t_iter++) {
+    Timeline* tmln = (*t_iter).second;
+    put_int(buf, (int)tmln->inbound.size());
+    for(VECTOR(Stargate*)::iterator sg_iter = tmln->inbound.begin();
+	sg_iter != tmln->inbound.end(); sg_iter++)
+      put_int(buf, sgidx[*sg_iter]);
+    put_int(buf, (int)tmln->outbound.size());
+    for(VECTOR(Stargate*)::iterator sg_iter = tmln->outbound.begin();
+	sg_iter != tmln->outbound.end(); sg_iter++)
+      put_int(buf, sgidx[*sg_iter]);
+  }
+
+  for(VECTOR(Entity*)::iterator e_iter = snapshot_entities.begin();
+      e_iter != snapshot_entities.end(); e_iter++) {
+    for(VECTOR(outChannel*)::iterator oc_iter = (*e_iter)->outchannels.begin();
+	oc_iter != (*e_iter)->outchannels.end(); oc_iter++) {
+      UNORDERED_MAP(MapOutport*,int) opidx;
+      for(MapOutport* outport = (*oc_iter)->outports; outport; outport = outport->next)
+	opidx.insert(MAKE_PAIR(outport, (int)opidx.size()));
+      put_int(buf, (int)opidx.size());
+      for(MapOutport* outport = (*oc_iter)->outports; outport; outport = outport->next) {
+	put_int(buf, outport->stargate ? sgidx[outport->stargate] : -1);
+	put_time(buf, outport->min_offset);
+	put_int(buf, outport->colocated ? opidx[outport->colocated] : -1);
+	put_int(buf, outport->carried ? 1 : 0);
+	put_inports(buf, outport->inport, icidx);
+      }
+    }
+  }
+
+  put_int(buf, (int)starmap.size());
+  for(MAP(int,VECTOR(MapStarport)*)::iterator iter = starmap.begin();
+      iter != starmap.end(); iter++) {
+    VECTOR(MapStarport)* vec = (*iter).second; assert(vec);
+    put_int(buf, (*iter).first);
+    put_int(buf, (int)vec->size());
+    for(VECTOR(MapStarport)::iterator s_iter = vec->begin(); s_iter != vec->end(); s_iter++) {
+      put_int(buf, sgidx[(*s_iter).stargate]);
+      put_time(buf, (*s_iter).offset);
+      put_inports(buf, (*s_iter).inport, icidx);
+    }
+  }
+  snapshot_entities.clear();
+
+  FILE* fptr = fopen(args_save_model.c_str(), "wb");
+  if(!fptr) SSF_THROW("can't open model snapshot: " << args_save_model);
+  size_t n = fwrite(buf.data(), 1, buf.length(), fptr);
+  if(fclose(fptr) || n != buf.length()) 
+    SSF_THROW("can't write model snapshot: " << args_save_model);
+}
+
+}; /*namespace minissf*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
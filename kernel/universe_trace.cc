@@ -0,0 +1,72 @@
+#include <assert.h>
+
+#include "kernel/universe.h"
+#include "ssf.h"
+
+namespace minissf {
+
+// the trace records are kept only for the synchronization windows
+// that overlap with the simulation time to be traced (given by the
+// --trace-window option), so that a long run can be traced around the
+// time of interest; each window is either traced or not as a whole,
+// and the transport threads follow the windows of processor 0
+
+TraceBuffer* Universe::send_trace_buffer = 0;
+TraceBuffer* Universe::recv_trace_buffer = 0;
+bool Universe::trace_transport = false;
+
+void Universe::open_trace()
+{
+  assert(!args_trace.empty());
+  TraceBuffer::open_file(args_trace, args_nmachs, args_rank, args_nprocs, time0);
+  if(args_nmachs > 1) {
+    send_trace_buffer = new TraceBuffer(args_nprocs); assert(send_trace_buffer);
+    recv_trace_buffer = new TraceBuffer(args_nprocs+1); assert(recv_trace_buffer);
+  }
+}
+
+void Universe::close_trace()
+{
+  // the transport threads are done by now
+  if(send_trace_buffer) { delete send_trace_buffer; send_trace_buffer = 0; }
+  if(recv_trace_buffer) { delete recv_trace_buffer; recv_trace_buffer = 0; }
+  TraceBuffer::close_file();
+}
+
+void Universe::set_trace_window(VirtualTime from, VirtualTime to)
+{
+  if(!trace_buffer) return;
+  if(from < args_trace_end && args_trace_start < to) tracer = trace_buffer;
+  else tracer = 0;
+  if(!processor_id && args_nmachs > 1)
+    __atomic_store_n(&trace_transport, tracer != 0, __ATOMIC_RELAXED);
+}
+
+}; /*namespace minissf*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
@@ -23,6 +23,7 @@
 #include <cstdlib>
 #include <iostream>
 #include "random/random.h"
+#include "ssfapi/ssf_snapshot.h"
 
 using namespace std;
 
@@ -514,6 +515,15 @@ void LecuyerRandom::setSeed(int s)
   srand(tmp);
 }
 
+void LecuyerRandom::serialize(Snapshot* snapshot)
+{
+  snapshot->data(Cg, sizeof(Cg));
+  snapshot->data(Bg, sizeof(Bg));
+  snapshot->data(Ig, sizeof(Ig));
+  snapshot->value(anti);
+  snapshot->value(incPrec);
+}
+
 }; /*namespace minissf*/
 
 /*
@@ -124,6 +124,9 @@ public:
     }
   }
 
+  /** \brief Save or restore the state of the random stream. */
+  virtual void serialize(Snapshot* snapshot);
+
   /** \brief Return a random number uniformly distributed between 0 and 1. */
   virtual double operator()() { return RandU01(); }
 
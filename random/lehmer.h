@@ -101,6 +101,11 @@ class LehmerTemplate : public Random {
     }
   }
 
+  /** \brief Save or restore the state of the random stream. */
+  virtual void serialize(Snapshot* snapshot) {
+    serialize_data(snapshot, &seed, sizeof(int));
+  }
+
  private:
   int seed;
   int init_seed;
@@ -1,5 +1,6 @@
 #include <math.h>
 #include "random/random.h"
+#include "ssfapi/ssf_snapshot.h"
 
 namespace minissf {
 
@@ -163,6 +164,14 @@ void MersenneTwisterRandom::load(uint32 *const loadArray)
   left = *la;
   pNext = &state[N-left];
 }
+
+void MersenneTwisterRandom::serialize(Snapshot* snapshot)
+{
+  uint32 buf[SAVE];
+  if(!snapshot->isLoading()) save(buf);
+  snapshot->data(buf, sizeof(buf));
+  if(snapshot->isLoading()) load(buf);
+}
  
 /*
 std::ostream& operator<<(std::ostream& os, const MersenneTwisterRandom& mtrand) {
@@ -65,6 +65,9 @@ class MersenneTwisterRandom : public Random {
       s[i] = new MersenneTwisterRandom((uint32)((*this)()*0x07fff0000));
     }
   }
+
+  /** \brief Save or restore the state of the random stream. */
+  virtual void serialize(Snapshot* snapshot);
     
  protected:
   // access to 32-bit random numbers
@@ -2,6 +2,7 @@
 #include <time.h>
 #include "random/random.h"
 #include "kernel/throwable.h"
+#include "ssfapi/ssf_snapshot.h"
 
 namespace minissf {
 
@@ -9,6 +10,17 @@ namespace minissf {
 
 int Random::global_seed = 0;
 
+void Random::serialize(Snapshot* snapshot)
+{
+  SSF_THROW("the random number generator can't be serialized");
+}
+
+void Random::serialize_data(Snapshot* snapshot, void* buf, int len)
+{
+  if(!snapshot) SSF_THROW("null snapshot");
+  snapshot->data(buf, len);
+}
+
 double Random::uniform(double a, double b)
 {
   if(a > b) SSF_THROW("invalid arguments: a=" << a << ", b=" << b);
@@ -12,6 +12,8 @@
 
 namespace minissf {
 
+class Snapshot;
+
 /**
  * \brief Random number and random variate generators.
  *
@@ -44,6 +46,18 @@ class Random {
    */
   virtual void spawnStreams(int n, Random** streams) = 0;
 
+  /**
+   * \brief Save or restore the state of the random stream.
+   * \param snapshot the snapshot or checkpoint of the owner entity
+   *
+   * This method is meant to be called from the serialize() method of
+   * the entity owning the random number generator, so that the random
+   * stream continues from where it was when the simulation restarts
+   * from a checkpoint. The random number generators provided by the
+   * simulator all support this method.
+   */
+  virtual void serialize(Snapshot* snapshot);
+
   /**
    * \brief Returns a random number from a uniform(a,b) distribution.
    * \param a is the lower limit.
@@ -205,6 +219,11 @@ class Random {
   // calculate log(n!), used by poisson()
   double logfactorial(int n);
 
+  // save or restore a block of memory (for the generators defined
+  // entirely in the header files, where the snapshot class is not
+  // yet defined)
+  static void serialize_data(Snapshot* snapshot, void* buf, int len);
+
 }; /*class Random*/
 
 }; /*namespace minissf*/
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include "random/random.h"
 #include "kernel/throwable.h"
+#include "ssfapi/ssf_snapshot.h"
 
 namespace minissf {
 
@@ -124,6 +125,26 @@ void SPRNGRandom::spawnStreams(int n, Random** s)
   free(r);
 }
 
+void SPRNGRandom::serialize(Snapshot* snapshot)
+{
+  // the generator packs its state into a buffer allocated by itself;
+  // the size is the same for generators of the same type
+  char* buf = 0;
+  int len = pack_sprng(sprng_kernel, &buf);
+  if(len <= 0 || !buf) SSF_THROW("failed to pack the random number stream");
+  int n = len;
+  snapshot->value(n);
+  if(n != len) { free(buf); SSF_THROW("mismatched random number stream in the snapshot"); }
+  snapshot->data(buf, len);
+  if(snapshot->isLoading()) {
+    int* k = unpack_sprng(buf);
+    if(!k) { free(buf); SSF_THROW("failed to unpack the random number stream"); }
+    free_sprng(sprng_kernel);
+    sprng_kernel = k;
+  }
+  free(buf);
+}
+
 }; /*namespace minissf*/
 
 /*
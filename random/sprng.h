@@ -231,6 +231,9 @@ class SPRNGRandom : public Random {
    * \param s a preallocated array, which will hold the random streams upon return of this function
    */
   virtual void spawnStreams(int n, Random** s);
+
+  /** \brief Save or restore the state of the random stream. */
+  virtual void serialize(Snapshot* snapshot);
     
  protected:
   int sprng_type; 
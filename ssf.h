@@ -23,6 +23,8 @@
 #include "ssfapi/outchannel.h"
 #include "ssfapi/ssf_timer.h"
 #include "ssfapi/ssf_semaphore.h"
+#include "ssfapi/ssf_snapshot.h"
+#include "ssfapi/coprocess.h"
 #endif
 
 /** \brief The namespace for all minissf classes and functions. 
@@ -156,6 +158,16 @@ extern int ssf_total_processor_index();
  * \returns the global index of the caller's processor.
  */
 extern int ssf_processor_range(int& startid, int& endid);
+
+/** 
+ * \brief Return true if the model is to be restored from a snapshot.
+ *
+ * If the model is loaded from a snapshot file (with the --load-model
+ * command-line option), the entities are aligned and the channels
+ * are wired up as recorded in the snapshot; the calls to
+ * Entity::alignto() and outChannel::mapto() are ignored.
+ */
+extern bool ssf_model_restored();
 /** @} */
 
 }; /*namespace minissf*/
@@ -715,18 +715,14 @@ void CompactDataType::compact_retrieve_raw(int c, int size, unsigned char* buf)
   compact_get_offset += size*c;
 }
 
-#ifdef HAVE_MPI_H
 int CompactDataType::pack(char* buffer, int bufsiz) 
 {
   int pos = 0;
-  ssf_mpi_pack(&compact_rec_add_offset, 1, MPI_INT, buffer, bufsiz, &pos, MPI_COMM_WORLD);
+  ssf_pack(&compact_rec_add_offset, sizeof(compact_rec_add_offset), buffer, bufsiz, &pos);
   if(compact_rec_add_offset > 0) {
-    ssf_mpi_pack(compact_record, compact_rec_add_offset, MPI_INT, 
-		 buffer, bufsiz, &pos, MPI_COMM_WORLD);
-    ssf_mpi_pack(&compact_add_offset, 1, MPI_INT, 
-		 buffer, bufsiz, &pos, MPI_COMM_WORLD);
-    ssf_mpi_pack(compact_data, compact_add_offset, MPI_UNSIGNED_CHAR, 
-		 buffer, bufsiz, &pos, MPI_COMM_WORLD);
+    ssf_pack(compact_record, compact_rec_add_offset*sizeof(int), buffer, bufsiz, &pos);
+    ssf_pack(&compact_add_offset, sizeof(compact_add_offset), buffer, bufsiz, &pos);
+    ssf_pack(compact_data, compact_add_offset, buffer, bufsiz, &pos);
   }
   return pos;
 }
@@ -742,23 +738,18 @@ void CompactDataType::unpack(char* buffer, int bufsiz)
 {
   int pos = 0;
   compact_reset();
-  ssf_mpi_unpack(buffer, bufsiz, &pos, &compact_rec_add_offset, 
-		 1, MPI_INT, MPI_COMM_WORLD);
+  ssf_unpack(buffer, bufsiz, &pos, &compact_rec_add_offset, sizeof(compact_rec_add_offset));
   if(compact_rec_add_offset > 0) {
     compact_rec_capacity = compact_rec_add_offset;
     compact_record = new int[compact_rec_capacity]; assert(compact_record);
-    ssf_mpi_unpack(buffer, bufsiz, &pos, compact_record, 
-		   compact_rec_add_offset, MPI_INT, MPI_COMM_WORLD);
-    ssf_mpi_unpack(buffer, bufsiz, &pos, &compact_add_offset, 
-		   1, MPI_INT, MPI_COMM_WORLD);
+    ssf_unpack(buffer, bufsiz, &pos, compact_record, compact_rec_add_offset*sizeof(int));
+    ssf_unpack(buffer, bufsiz, &pos, &compact_add_offset, sizeof(compact_add_offset));
     compact_capacity = compact_add_offset;
     compact_data = new unsigned char[compact_capacity]; assert(compact_data);
-    ssf_mpi_unpack(buffer, bufsiz, &pos, compact_data, 
-		   compact_add_offset, MPI_UNSIGNED_CHAR, MPI_COMM_WORLD);
+    ssf_unpack(buffer, bufsiz, &pos, compact_data, compact_add_offset);
   }
   if(pos != bufsiz) SSF_THROW("unmatched compact data type");
 }
-#endif /*HAVE_MPI_H*/
 
 }; /*namespace minissf*/
 
@@ -223,12 +223,10 @@ public:
   void compact_retrieve_raw(int ch, int size, unsigned char* buf);
 
  public:
-#ifdef HAVE_MPI_H
-  // packing and unpacking to and from a byte array using mpi
+  // packing and unpacking to and from a byte array
   int pack(char* buf, int bufsiz);
   int pack_and_delete(char* buf, int bufsiz); // reclaiming this after use!
   void unpack(char* buf, int siz);
-#endif
 }; // class CompactDataType
 
 }; /*namespace minissf*/
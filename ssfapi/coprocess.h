@@ -0,0 +1,311 @@
+/**
+ * \file coprocess.h
+ * \brief Header file for the coroutine process and procedure classes.
+ *
+ * This header file contains the definition of the coroutine process
+ * and procedure classes, which are available only if the model is
+ * compiled with C++20 coroutine support (e.g., with -std=c++20);
+ * Users do not need to include this header file directly; it is
+ * included from ssf.h.
+ */
+
+#ifndef __MINISSF_COPROCESS_H__
+#define __MINISSF_COPROCESS_H__
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include "ssfapi/ssf_common.h"
+#include "ssfapi/quick_memory.h"
+#include "ssfapi/process.h"
+#include "ssfapi/ssf_semaphore.h"
+
+namespace minissf {
+
+class CoProcess;
+
+/**
+ * \brief A procedure of a coroutine process.
+ *
+ * A coroutine procedure is a C++20 coroutine that returns an object
+ * of this class. It is the counterpart of a translated procedure: it
+ * can be suspended by a wait statement (which must be co_await-ed),
+ * and it can call another coroutine procedure by co_await-ing it.
+ * The compiler lays out the procedure frames, which are allocated
+ * from quick memory, so no source code translation is needed. A
+ * coroutine procedure can be a method of any class or a regular
+ * function; it usually takes a pointer to the calling process as an
+ * argument so that it can call the wait statements. A coroutine
+ * procedure does not return a value.
+ */
+class CoProcedure {
+ public:
+  // the promise of the coroutine (required by the compiler)
+  class promise_type {
+  public:
+    // the procedure frame is allocated from quick memory
+    static void* operator new(size_t sz) { return ssf_quickmem_malloc(sz); }
+    static void operator delete(void* p) { ssf_quickmem_free(p); }
+
+    CoProcedure get_return_object() {
+      return CoProcedure(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    // the procedure starts when it's co_await-ed (or resumed by the
+    // process if it's the starting procedure)
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // at the end, the procedure returns to the caller procedure, if
+    // there's one; otherwise, it returns to the process
+    class FinalAwaiter {
+    public:
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+	std::coroutine_handle<> caller = h.promise().caller;
+	if(caller) return caller;
+	else return std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void return_void() {}
+    void unhandled_exception() { throw; }
+
+    std::coroutine_handle<> caller; // the calling procedure (null for starting procedure)
+  }; /*class promise_type*/
+
+  CoProcedure() : handle(0) {}
+  CoProcedure(CoProcedure&& p) : handle(p.handle) { p.handle = 0; }
+  CoProcedure& operator=(CoProcedure&& p) {
+    if(this != &p) { if(handle) handle.destroy(); handle = p.handle; p.handle = 0; }
+    return *this;
+  }
+  ~CoProcedure() { if(handle) handle.destroy(); }
+
+  // calling a procedure from another procedure (with co_await)
+  bool await_ready() { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+    handle.promise().caller = caller;
+    return handle;
+  }
+  void await_resume() {}
+
+ private:
+  friend class CoProcess;
+  explicit CoProcedure(std::coroutine_handle<promise_type> h) : handle(h) {}
+  CoProcedure(const CoProcedure&) = delete;
+  CoProcedure& operator=(const CoProcedure&) = delete;
+
+  std::coroutine_handle<promise_type> handle; // the procedure frame
+}; /*class CoProcedure*/
+
+/*
+ * \brief A wait statement of a coroutine process.
+ *
+ * The wait statement is not called until it's co_await-ed, at which
+ * time the procedure is suspended only if the process is blocked by
+ * the wait statement (a semaphore wait, for example, may not block).
+ * The result of co_await is true if the process is unblocked by a
+ * timeout, and false otherwise.
+ */
+template<typename WaitFunction>
+class [[nodiscard]] CoWait {
+ public:
+  CoWait(CoProcess* p, WaitFunction f) : process(p), wait_function(f) {}
+
+  bool await_ready() { return false; }
+  inline bool await_suspend(std::coroutine_handle<> h);
+  inline bool await_resume();
+
+ private:
+  CoProcess* process; // the calling process
+  WaitFunction wait_function; // calls the wait statement of the process
+}; /*class CoWait*/
+
+/**
+ * \brief A simulation process whose procedures are C++20 coroutines.
+ *
+ * A coroutine process is an alternative to a translated process
+ * (with procedures marked for source code translation) and a
+ * stackful process. The user derives a class from this class and
+ * overrides the coAction() method, which is the starting procedure
+ * of the process. The wait statements of this class are the same as
+ * those of the Process class, except that they must be co_await-ed;
+ * a semaphore is waited on with the wait() method of this class. The
+ * procedure frames are laid out by the compiler, which is free to
+ * inline code across the suspension points. Like a translated
+ * process, the starting procedure is called again if it returns.
+ */
+class CoProcess : public Process {
+ public:
+  /**
+   * \brief Creating a coroutine process, which starts from the coAction() method.
+   *
+   * \param owner points to the entity owner of this process
+   */
+  CoProcess(Entity* owner) : Process(owner, false) {}
+
+  /**
+   * \brief The destructor of a coroutine process.
+   *
+   * The frames of the procedures, if the process is blocked in the
+   * middle of them, are destroyed with the process.
+   */
+  virtual ~CoProcess() {}
+
+  /**
+   * \brief The starting procedure of the coroutine process.
+   *
+   * The user must override this method, which is a coroutine
+   * returning a CoProcedure object.
+   */
+  virtual CoProcedure coAction() = 0;
+
+  /** @name Wait statements (to be co_await-ed). */
+  /** @{ */
+
+  /** \brief Wait for an event to arrive on any of the inchannels. */
+  auto waitOn(const SET(inChannel*)& icset) {
+    return make_wait([this, &icset]() { Process::waitOn(icset); });
+  }
+
+  /** \brief Wait for an event to arrive on the given inchannel. */
+  auto waitOn(inChannel* ic) {
+    return make_wait([this, ic]() { Process::waitOn(ic); });
+  }
+
+  /** \brief Wait for an event to arrive on any of the static inchannels. */
+  auto waitOn() {
+    return make_wait([this]() { Process::waitOn(); });
+  }
+
+  /** \brief Terminate the process and reclaim it immediately. */
+  auto waitForever() {
+    return make_wait([this]() { Process::waitForever(); });
+  }
+
+  /** \brief Terminate the process but keep it until the simulation ends. */
+  auto suspendForever() {
+    return make_wait([this]() { Process::suspendForever(); });
+  }
+
+  /** \brief Wait for the specified amount of simulation time. */
+  auto waitFor(VirtualTime delay) {
+    return make_wait([this, delay]() { Process::waitFor(delay); });
+  }
+
+  /** \brief Wait until the specified simulation time. */
+  auto waitUntil(VirtualTime time) {
+    return make_wait([this, time]() { Process::waitUntil(time); });
+  }
+
+  /** \brief Wait on the inchannels for at most the given amount of time; returns true if timed out. */
+  auto waitOnFor(const SET(inChannel*)& icset, VirtualTime delay) {
+    return make_wait([this, &icset, delay]() { Process::waitOnFor(icset, delay); });
+  }
+
+  /** \brief Wait on the inchannel for at most the given amount of time; returns true if timed out. */
+  auto waitOnFor(inChannel* ic, VirtualTime delay) {
+    return make_wait([this, ic, delay]() { Process::waitOnFor(ic, delay); });
+  }
+
+  /** \brief Wait on the static inchannels for at most the given amount of time; returns true if timed out. */
+  auto waitOnFor(VirtualTime delay) {
+    return make_wait([this, delay]() { Process::waitOnFor(delay); });
+  }
+
+  /** \brief Wait on the inchannels until at most the given time; returns true if timed out. */
+  auto waitOnUntil(const SET(inChannel*)& icset, VirtualTime time) {
+    return make_wait([this, &icset, time]() { Process::waitOnUntil(icset, time); });
+  }
+
+  /** \brief Wait on the inchannel until at most the given time; returns true if timed out. */
+  auto waitOnUntil(inChannel* ic, VirtualTime time) {
+    return make_wait([this, ic, time]() { Process::waitOnUntil(ic, time); });
+  }
+
+  /** \brief Wait on the static inchannels until at most the given time; returns true if timed out. */
+  auto waitOnUntil(VirtualTime time) {
+    return make_wait([this, time]() { Process::waitOnUntil(time); });
+  }
+
+  /** \brief Decrement the semaphore and wait if its value becomes negative. */
+  auto wait(Semaphore* sem) {
+    return make_wait([sem]() { sem->wait(); });
+  }
+
+  /** @} */
+
+ protected:
+  // the starting procedure of a translated process; it resumes the
+  // coroutine procedure that has been suspended
+  virtual void action() final {
+    if(!current_procedure) {
+      root_procedure = coAction();
+      current_procedure = root_procedure.handle;
+    }
+    std::coroutine_handle<> h = current_procedure;
+    current_procedure = 0; // set again by the next wait statement
+    h.resume();
+    if(root_procedure.handle.done())
+      root_procedure = CoProcedure(); // start over if action() is called again
+  }
+
+ private:
+  template<typename WaitFunction> friend class CoWait;
+
+  template<typename WaitFunction>
+  CoWait<WaitFunction> make_wait(WaitFunction f) { return CoWait<WaitFunction>(this, f); }
+
+  CoProcedure root_procedure; // the starting procedure
+  std::coroutine_handle<> current_procedure; // the procedure to resume next
+}; /*class CoProcess*/
+
+template<typename WaitFunction>
+bool CoWait<WaitFunction>::await_suspend(std::coroutine_handle<> h)
+{
+  wait_function();
+  if(!process->suspended()) return false; // continue right away
+  process->current_procedure = h;
+  return true;
+}
+
+template<typename WaitFunction>
+bool CoWait<WaitFunction>::await_resume()
+{
+  return process->timed_out();
+}
+
+}; /*namespace minissf*/
+
+#endif /*__cpp_impl_coroutine*/
+
+#endif /*__MINISSF_COPROCESS_H__*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
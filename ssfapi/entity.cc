@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <algorithm>
 #include "ssfapi/entity.h"
 #include "kernel/universe.h"
 
@@ -6,9 +7,21 @@ namespace minissf {
 
 #define MIN_RESPONSIVENESS VirtualTime(10, VirtualTime::MICROSECOND)
 
+// remove an element from the list; the element is most likely at the
+// back since they are reclaimed in the reverse order of creation
+template<class T>
+static void remove_from_list(VECTOR(T)& list, T x)
+{
+  if(!list.empty() && list.back() == x) list.pop_back();
+  else {
+    typename VECTOR(T)::iterator iter = std::find(list.begin(), list.end(), x);
+    if(iter != list.end()) list.erase(iter);
+  }
+}
+
 Entity::Entity(bool emulation, VirtualTime resp) : 
   timeline(0), serialno(0), nxtevtid(0), 
-  responsiveness(resp), emulated(emulation)
+  responsiveness(resp), emulated(emulation), init_state(0)
 {
   // the entity's timeline and serial number are not yet settled at this moment
   if(!Universe::is_initializing()) 
@@ -28,36 +41,20 @@ Entity::~Entity()
   if(!Universe::is_finalizing()) 
     SSF_THROW("entity can only be deleted during simulation finalization");
   
-  while(!processes.empty()) {
-    SET(Process*)::iterator iter = processes.begin();
-    assert(iter != processes.end());
-    delete (*iter);
-  }
-  processes.clear();
-
-  while(!inchannels.empty()) {
-    SET(inChannel*)::iterator iter = inchannels.begin();
-    assert(iter != inchannels.end());
-    delete (*iter);
-  }
-  inchannels.clear();
+  // delete from the back so that each removal is constant time
+  while(!processes.empty()) delete processes.back();
 
-  while(!outchannels.empty()) {
-    SET(outChannel*)::iterator iter = outchannels.begin();
-    assert(iter != outchannels.end());
-    delete (*iter);
-  }
-  outchannels.clear();
+  while(!inchannels.empty()) delete inchannels.back();
 
-  for(SET(KernelEvent*)::iterator e_iter = init_events.begin();
-      e_iter != init_events.end(); e_iter++) delete (*e_iter); 
-  init_events.clear();
+  while(!outchannels.empty()) delete outchannels.back();
 
-  for(SET(InitWrite*)::iterator  w_iter = init_writes.begin();
-      w_iter != init_writes.end(); w_iter++) {
-    delete (*w_iter)->evt; delete (*w_iter);
+  if(init_state) {
+    for(VECTOR(KernelEvent*)::iterator e_iter = init_state->events.begin();
+	e_iter != init_state->events.end(); e_iter++) delete (*e_iter); 
+    for(VECTOR(InitWrite)::iterator w_iter = init_state->writes.begin();
+	w_iter != init_state->writes.end(); w_iter++) delete (*w_iter).evt;
+    delete init_state;
   }
-  init_writes.clear();
 
   if(timeline) timeline->delete_entity(this);
 }
@@ -75,6 +72,7 @@ void Entity::alignto(Entity* entity)
   if(!entity) SSF_THROW("null entity");
   if(this == entity) return;
 
+  Universe::init_lock(); // if init() is called in parallel
   if(timeline && !entity->timeline) {
     timeline->add_entity(entity);
     Universe::deregister_orphan_entity(entity);
@@ -90,39 +88,42 @@ void Entity::alignto(Entity* entity)
     Universe::deregister_orphan_entity(entity);
     Universe::deregister_orphan_entity(this);
   }
+  Universe::init_unlock();
 }
 
-const SET(Entity*)& Entity::coalignedEntities()
+const VECTOR(Entity*)& Entity::coalignedEntities()
 {
   if(!timeline) {
+    Universe::init_lock(); // if init() is called in parallel
     Timeline* tmln = Universe::create_timeline();
     tmln->add_entity(this);
     Universe::deregister_orphan_entity(this);
+    Universe::init_unlock();
   } 
   assert(timeline);
   return timeline->get_entities(); 
 }
 
-void Entity::add_inchannel(inChannel* ic) {
-  inchannels.insert(ic); 
-  if(!ic->name.empty()) 
-    Universe::register_named_inchannel(ic);
+void Entity::add_inchannel(inChannel* ic, const char* name) {
+  inchannels.push_back(ic); 
+  if(name && *name) 
+    Universe::register_named_inchannel(ic, name);
 }
 
-void Entity::delete_inchannel(inChannel* ic) { inchannels.erase(ic); }
+void Entity::delete_inchannel(inChannel* ic) { remove_from_list(inchannels, ic); }
 
-void Entity::add_outchannel(outChannel* oc) { outchannels.insert(oc); }
+void Entity::add_outchannel(outChannel* oc) { outchannels.push_back(oc); }
 
-void Entity::delete_outchannel(outChannel* oc) { outchannels.erase(oc); }
+void Entity::delete_outchannel(outChannel* oc) { remove_from_list(outchannels, oc); }
 
-void Entity::add_process(Process* p) { processes.insert(p); }
+void Entity::add_process(Process* p) { processes.push_back(p); }
 
-void Entity::delete_process(Process* p) { processes.erase(p); }
+void Entity::delete_process(Process* p) { remove_from_list(processes, p); }
 
 void Entity::insert_event(KernelEvent* evt)
 {
   if(Universe::is_initializing()) { // store locally
-    init_events.insert(evt);
+    get_init_state()->events.push_back(evt);
   } else {
     assert(timeline);
     timeline->insert_event(evt);
@@ -132,7 +133,11 @@ void Entity::insert_event(KernelEvent* evt)
 void Entity::cancel_event(KernelEvent* evt)
 {
   if(Universe::is_initializing()) { // store locally
-    init_events.erase(evt);
+    if(init_state) {
+      VECTOR(KernelEvent*)::iterator iter = 
+	std::find(init_state->events.begin(), init_state->events.end(), evt);
+      if(iter != init_state->events.end()) init_state->events.erase(iter);
+    }
   } else {
     assert(timeline);
     timeline->cancel_event(evt);
@@ -141,29 +146,35 @@ void Entity::cancel_event(KernelEvent* evt)
 
 void Entity::init_write_event(Event* evt, VirtualTime write_delay, outChannel* oc) 
 {
-  init_writes.insert(new InitWrite(evt, write_delay, oc));
+  get_init_state()->writes.push_back(InitWrite(evt, write_delay, oc));
+}
+
+Entity::InitState* Entity::get_init_state()
+{
+  if(!init_state) { init_state = new InitState; assert(init_state); }
+  return init_state;
 }
 
 void Entity::schedule_init_events()
 {
-  SET(KernelEvent*)::iterator e_iter;
-  for(e_iter = init_events.begin();
-      e_iter != init_events.end(); e_iter++)
+  if(!init_state) return;
+
+  VECTOR(KernelEvent*)::iterator e_iter;
+  for(e_iter = init_state->events.begin();
+      e_iter != init_state->events.end(); e_iter++)
     timeline->insert_event(*e_iter);
-  init_events.clear();
 
-  SET(EmulatedEvent*)::iterator ee_iter;
-  for(ee_iter = init_emu_events.begin();
-      ee_iter != init_emu_events.end(); ee_iter++)
+  VECTOR(EmulatedEvent*)::iterator ee_iter;
+  for(ee_iter = init_state->emu_events.begin();
+      ee_iter != init_state->emu_events.end(); ee_iter++)
     timeline->insert_emulated_event(*ee_iter);
-  init_emu_events.clear();
 
-  for(SET(InitWrite*)::iterator  w_iter = init_writes.begin();
-      w_iter != init_writes.end(); w_iter++) {
-    (*w_iter)->oc->write_event((*w_iter)->evt, (*w_iter)->wdelay);
-    delete (*w_iter);
-  }
-  init_writes.clear();
+  // the writes are issued in the order they were made
+  for(VECTOR(InitWrite)::iterator w_iter = init_state->writes.begin();
+      w_iter != init_state->writes.end(); w_iter++)
+    (*w_iter).oc->write_event((*w_iter).evt, (*w_iter).wdelay);
+
+  delete init_state; init_state = 0;
 }
 
 VirtualTime Entity::realNow() 
@@ -178,7 +189,7 @@ void Entity::insertEmulatedEvent(Event*& evt)
 
   EmulatedEvent* ee = new EmulatedEvent(this, evt);
   if(Universe::is_initializing()) { // store locally
-    init_emu_events.insert(ee);
+    get_init_state()->emu_events.push_back(ee);
   } else {
     assert(timeline);
     timeline->insert_emulated_event(ee);
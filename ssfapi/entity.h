@@ -11,6 +11,7 @@
 #define __MINISSF_ENTITY_H__
 
 #include "ssfapi/procedure.h"
+#include "ssfapi/quick_memory.h"
 #include "kernel/kernel_event.h"
 #include "kernel/timeline.h"
 
@@ -72,6 +73,26 @@ class Entity : public ProcedureContainer {
    */
   virtual ~Entity();
 
+  /**
+   * \brief Allocate an entity (of this or a derived class) from the init arena.
+   *
+   * Entities live until the end of simulation; they are packed in an
+   * arena without per-object allocator overhead, and the memory is
+   * given back all at once after the simulation is finalized.
+   */
+  static void* operator new(size_t sz) { return ssf_arena_malloc(sz); }
+
+  /** \brief The memory of an entity is reclaimed with the init arena, not individually. */
+  static void operator delete(void* p) {}
+
+#ifdef __cpp_aligned_new
+  /** \brief Allocate an over-aligned entity (of a derived class) from the init arena. */
+  static void* operator new(size_t sz, std::align_val_t al) { return ssf_arena_malloc(sz, (size_t)al); }
+
+  /** \brief The memory of an over-aligned entity is also reclaimed with the init arena. */
+  static void operator delete(void* p, std::align_val_t al) {}
+#endif
+
  /**
    * \brief Initialize a newly created entity.
    *
@@ -82,6 +103,35 @@ class Entity : public ProcedureContainer {
    */
   virtual void init() {}
 
+  /**
+   * \brief Save or restore the state of the entity with a model snapshot or a checkpoint.
+   *
+   * If the model is saved to (with the --save-model command-line
+   * option) or loaded from (with the --load-model option) a snapshot
+   * file, this method is called by the simulator right before the
+   * init() method of the entity. The entity can save its state when
+   * the snapshot is saved, and restore the same state when the
+   * snapshot is loaded, so that, for example, the expensive
+   * computation for setting up the entity can be skipped in later
+   * runs. The method in the base class is virtual and does nothing by
+   * default.
+   *
+   * The method is also called when the simulator takes a checkpoint
+   * (with the --checkpoint option), and when the simulation restarts
+   * from the checkpoint (with the --restart option), in which case
+   * Snapshot::isCheckpoint() returns true. At restart, the method is
+   * called after init(), with the simulation clock set to the time of
+   * the checkpoint; the processes of the entity are started over, and
+   * the events scheduled by init() are dropped, so the entity is
+   * expected to restore its state variables (including the random
+   * number generators) here. A checkpoint is skipped (with a warning)
+   * unless all processes are waiting on inchannels and no timer is
+   * running.
+   *
+   * \param snapshot the model snapshot (see the Snapshot class)
+   */
+  virtual void serialize(Snapshot* snapshot) {}
+
   /**
    * \brief Wrap up the entity before the simulator reclaims it.
    *
@@ -129,17 +179,17 @@ class Entity : public ProcedureContainer {
    */
   void alignto(Entity* entity);
 
-  /** \brief Return the set of coaligned entities (including this entity). */
-  const SET(Entity*)& coalignedEntities();
+  /** \brief Return the list of coaligned entities (including this entity). */
+  const VECTOR(Entity*)& coalignedEntities();
 
-  /** \brief Return the set of processes defined for this entity. */
-  inline const SET(Process*)& getProcesses() { return processes; }
+  /** \brief Return the list of processes defined for this entity (in order of creation). */
+  inline const VECTOR(Process*)& getProcesses() { return processes; }
 
-  /** \brief Return the set of inchannels of this entity. */  
-  inline const SET(inChannel*)& getInChannels() { return inchannels; }
+  /** \brief Return the list of inchannels of this entity (in order of creation). */  
+  inline const VECTOR(inChannel*)& getInChannels() { return inchannels; }
 
-  /** \brief Return the set of outchannels of this entity. */ 
-  inline const SET(outChannel*)& getOutChannels() { return outchannels; }
+  /** \brief Return the list of outchannels of this entity (in order of creation). */ 
+  inline const VECTOR(outChannel*)& getOutChannels() { return outchannels; }
 
   /** @name Emulation Functions. */
   /** @{ */
@@ -207,11 +257,9 @@ class Entity : public ProcedureContainer {
   VirtualTime responsiveness; // max delay allowed to respond to an external event (only if emulated)
   bool emulated; // indicate whether this entity is emulated
  
-  SET(inChannel*) inchannels; // set of inchannels defined for this entity
-  SET(outChannel*) outchannels; // set of outchannels defined for this entity
-  SET(Process*) processes; // set of processes defined for this entity
-  SET(KernelEvent*) init_events; // temporarily store events during initialization
-  SET(EmulatedEvent*) init_emu_events; // temporarily store emulated events during initialization
+  VECTOR(inChannel*) inchannels; // list of inchannels defined for this entity
+  VECTOR(outChannel*) outchannels; // list of outchannels defined for this entity
+  VECTOR(Process*) processes; // list of processes defined for this entity
   
   class InitWrite {
    public:
@@ -221,7 +269,17 @@ class Entity : public ProcedureContainer {
     InitWrite(Event* e, VirtualTime d, outChannel* o) :
       evt(e), wdelay(d), oc(o) {}
   };
-  SET(InitWrite*) init_writes;
+
+  // the events issued during initialization are kept in a side table,
+  // which is allocated on demand and reclaimed as soon as the events
+  // are scheduled, so that a running entity doesn't pay for it
+  class InitState {
+   public:
+    VECTOR(KernelEvent*) events; // temporarily store events during initialization
+    VECTOR(EmulatedEvent*) emu_events; // temporarily store emulated events during initialization
+    VECTOR(InitWrite) writes; // temporarily store the writes during initialization
+  };
+  InitState* init_state;
 
  protected:
   //inline Timeline* get_timeline() const { return timeline; }
@@ -230,7 +288,7 @@ class Entity : public ProcedureContainer {
   //inline void set_serialno(int s) { serialno = s; }
   inline int get_next_event_id() { return nxtevtid++; }
 
-  void add_inchannel(inChannel* ic);
+  void add_inchannel(inChannel* ic, const char* name = 0);
   void delete_inchannel(inChannel* ic);
   void add_outchannel(outChannel* oc);
   void delete_outchannel(outChannel* oc);
@@ -241,6 +299,7 @@ class Entity : public ProcedureContainer {
   void cancel_event(KernelEvent*);
 
   //XXX temporarily store events before the entity is wired correctly
+  InitState* get_init_state();
   void init_write_event(Event* evt, VirtualTime write_delay, outChannel* oc);
   void schedule_init_events();
 }; /*class Entity*/
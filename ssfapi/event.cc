@@ -11,6 +11,28 @@ SSF_REGISTER_EVENT(Event, Event::create_baseclass_event);
 
 Event* Event::clone() { return new Event(*this); }
 
+Event* Event::share_event(Event* evt)
+{
+  assert(evt);
+  if(!evt->isShareable()) return evt->clone();
+  // the receivers may be on different processors
+  __atomic_add_fetch(&evt->event_refcnt, 1, __ATOMIC_RELAXED);
+  return evt;
+}
+
+void Event::release_event(Event* evt)
+{
+  assert(evt);
+  if(evt->isShareable() && 
+     __atomic_sub_fetch(&evt->event_refcnt, 1, __ATOMIC_ACQ_REL) > 0) return;
+  delete evt;
+}
+
+bool Event::is_shared()
+{
+  return __atomic_load_n(&event_refcnt, __ATOMIC_ACQUIRE) > 1;
+}
+
 int Event::register_event(const char* classname, EventFactory factory)
 {
   if(!classname) SSF_THROW("missing event class name for event registration");
@@ -110,7 +110,7 @@ In myevent.cc file:
 class Event {
  public:
   /** \brief The constructor of an event. */
-  Event() {}
+  Event() : event_refcnt(1) {}
 
   /**
    * \brief The copy constructor.
@@ -131,11 +131,33 @@ class Event {
    * we recommend that one should \b always call the superclass's copy
    * constructor.
    */
-  Event(const Event& evt) {}
+  Event(const Event& evt) : event_refcnt(1) {}
+
+  /** \brief The assignment operator (which does not copy the reference count). */
+  Event& operator=(const Event& evt) { return *this; }
 
   /** \brief The event destructor. */
   virtual ~Event() {}
 
+  /**
+   * \brief Whether the event can be shared among receivers.
+   *
+   * By default, the kernel clones an event for each additional
+   * target inchannel when it is written to an outchannel. A derived
+   * event class can override this method to return true if the event
+   * is never modified once it has been written to an outchannel. In
+   * that case, the kernel delivers the same event object to all
+   * target inchannels (on the same machine) and keeps a reference
+   * count, rather than making clones of the event. This can save a
+   * lot of memory allocation and copying for large events that are
+   * sent to many inchannels. A receiving process should use
+   * inChannel::peekActiveEvent() to access the arrived event as
+   * read-only; if inChannel::activeEvent() is called instead, the
+   * process gets its own copy of the event (a clone if the event is
+   * still shared).
+   */
+  virtual bool isShareable() { return false; }
+
   /**
    * \brief Clone an event.
    *
@@ -185,6 +207,18 @@ Event* myEvent::clone() { return new myEvent(*this); }
   static Event* create_baseclass_event(char* buf, int siz);
   static SET(STRING)* registered_event_names;
   static VECTOR(EventFactory)* registered_event_factories;
+
+  // public methods used internally for delivering an event to more
+  // than one receiver: share_event() returns the event itself with
+  // one more reference if it's shareable, or a clone otherwise;
+  // release_event() drops a reference and reclaims the event when
+  // the last reference is gone
+  static Event* share_event(Event* evt);
+  static void release_event(Event* evt);
+  bool is_shared();
+
+ private:
+  int event_refcnt; // number of references to a shared event
 }; /*class Event*/
 
 }; /*namespace minissf*/
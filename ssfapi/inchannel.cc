@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <algorithm>
 #include "ssfapi/inchannel.h"
 #include "kernel/universe.h"
 #include "kernel/timeline.h"
@@ -7,7 +8,8 @@ namespace minissf {
 
 inChannel::inChannel(Entity* theowner) :
   entity_owner(theowner), wait_head(0), wait_tail(0),
-  active_event(0), processes_activated(0)
+  active_event(0), processes_activated(0), callback_context(false),
+  ic_entity_callback(0), ic_callback(0)
 {
   if(!Universe::is_initializing()) 
     SSF_THROW("can only be created during simulation initialization");
@@ -17,12 +19,13 @@ inChannel::inChannel(Entity* theowner) :
 
 inChannel::inChannel(Entity* theowner, const char* thename) :
   entity_owner(theowner), wait_head(0), wait_tail(0),
-  active_event(0), processes_activated(0), name(thename)
+  active_event(0), processes_activated(0), callback_context(false),
+  ic_entity_callback(0), ic_callback(0)
 {
   if(!Universe::is_initializing()) 
     SSF_THROW("can only be created during simulation initialization");
   if(!entity_owner) SSF_THROW("null entity owner");
-  entity_owner->add_inchannel(this);
+  entity_owner->add_inchannel(this, thename);
 }
 
 inChannel::~inChannel()
@@ -38,6 +41,20 @@ inChannel::~inChannel()
 
 Event* inChannel::activeEvent()
 {
+  if(callback_context) {
+    // the callback function takes over the event (or a copy of it if
+    // it's still shared with other inchannels)
+    Event* retevt = active_event;
+    if(!retevt) return 0;
+    active_event = 0;
+    if(retevt->is_shared()) {
+      Event* e = retevt->clone();
+      Event::release_event(retevt);
+      retevt = e;
+    }
+    return retevt;
+  }
+
   Process* p = entity_owner->timeline->current_process();
   PROPER_PROCEDURE(p);
 
@@ -48,7 +65,8 @@ Event* inChannel::activeEvent()
     } else {
       p->active_event_retrieved = true;
       //processes_activated--;
-      if(processes_activated > 1) return active_event->clone();
+      if(processes_activated > 1 || active_event->is_shared()) 
+	return active_event->clone();
       else {
 	Event* retevt = active_event;
 	active_event = 0;
@@ -58,8 +76,42 @@ Event* inChannel::activeEvent()
   } else return 0;
 }
 
+const Event* inChannel::peekActiveEvent()
+{
+  if(callback_context) return active_event;
+
+  Process* p = entity_owner->timeline->current_process();
+  PROPER_PROCEDURE(p);
+
+  // the event may still be shared with other processes and
+  // inchannels; it's only valid during the current activation
+  if(p->active_event_retrieved) return 0;
+  else return active_event;
+}
+
+void inChannel::setCallback(void (Entity::*cb)(inChannel*))
+{
+  if(cb) drop_static_auto();
+  if(cb && (wait_head || !static_processes.empty()))
+    SSF_THROW("processes are waiting on inchannel");
+  ic_entity_callback = cb;
+  ic_callback = 0;
+}
+
+void inChannel::setCallback(void (*cb)(inChannel*))
+{
+  if(cb) drop_static_auto();
+  if(cb && (wait_head || !static_processes.empty()))
+    SSF_THROW("processes are waiting on inchannel");
+  ic_entity_callback = 0;
+  ic_callback = cb;
+}
+
 void inChannel::set_sensitivity(WaitNode* wnode)
 {
+  if(ic_entity_callback || ic_callback)
+    SSF_THROW("cannot wait on inchannel with callback");
+  drop_static_auto();
   // put the node into the double-linked list
   wnode->prev_c = 0;
   wnode->next_c = wait_head;
@@ -80,12 +132,30 @@ void inChannel::set_insensitivity(WaitNode* wnode)
 
 void inChannel::set_static_sensitivity(Process* proc)
 {
-  static_processes.insert(proc);
+  if(ic_entity_callback || ic_callback)
+    SSF_THROW("cannot wait on inchannel with callback");
+  drop_static_auto();
+  // the process keeps its own static inchannels unique, so no need
+  // to check for duplicates here
+  static_processes.push_back(proc);
 }
 
 void inChannel::set_static_insensitivity(Process* proc)
 {
-  static_processes.erase(proc);
+  VECTOR(Process*)::iterator iter = 
+    std::find(static_processes.begin(), static_processes.end(), proc);
+  assert(iter != static_processes.end());
+  static_processes.erase(iter);
+}
+
+void inChannel::drop_static_auto()
+{
+  // a process made statically sensitive automatically is the sole
+  // process waiting on the inchannel; it goes back to waiting
+  // dynamically once another process (or a callback) comes along, so
+  // that it's treated as if it had never been promoted
+  if(static_processes.size() == 1 && static_processes[0]->static_auto)
+    static_processes[0]->demote_static_auto();
 }
 
 void inChannel::schedule_arrival(Event* evt)
@@ -93,13 +163,27 @@ void inChannel::schedule_arrival(Event* evt)
   assert(evt);
   assert(!processes_activated);
 
+  // the callback function handles the arrival right away; the event
+  // is reclaimed afterwards if it's not taken over
+  if(ic_entity_callback || ic_callback) {
+    active_event = evt;
+    callback_context = true;
+    if(ic_entity_callback) (entity_owner->*ic_entity_callback)(this);
+    else ic_callback(this);
+    callback_context = false;
+    if(active_event) {
+      Event::release_event(active_event);
+      active_event = 0;
+    }
+    return;
+  }
+
   // check permanent sensitivity first
-  for(SET(Process*)::iterator iter = static_processes.begin();
-      iter != static_processes.end(); iter++) {
-    Process* p = *iter;
+  for(int i=0, n=static_processes.size(); i<n; i++) {
+    Process* p = static_processes[i];
     if(p->static_sensitivity) {
       // if the process is indeed expecting event arrival
-      assert(!p->waiton_node);
+      assert(!p->waiton_count);
       processes_activated++;
       p->active_inchannel = this;
       p->active_event_retrieved = false;
@@ -131,13 +215,13 @@ void inChannel::schedule_arrival(Event* evt)
   }
 
   if(processes_activated) active_event = evt;
-  else delete evt;
+  else Event::release_event(evt);
 }
 
 void inChannel::clear_pending_event()
 {
   if(active_event) {
-    delete active_event;
+    Event::release_event(active_event);
     active_event = 0;
     processes_activated = 0;
   }
@@ -11,6 +11,7 @@
 #define __MINISSF_INCHANNEL_H__
 
 #include "ssfapi/ssf_common.h"
+#include "ssfapi/quick_memory.h"
 #include "kernel/kernel_event.h"
 
 namespace minissf {
@@ -66,6 +67,18 @@ class inChannel {
    */
   virtual ~inChannel();
 
+  /** \brief Inchannels are allocated from the init arena (like entities). */
+  static void* operator new(size_t sz) { return ssf_arena_malloc(sz); }
+
+  /** \brief The memory of an inchannel is reclaimed with the init arena, not individually. */
+  static void operator delete(void* p) {}
+
+#ifdef __cpp_aligned_new
+  /** \brief Over-aligned inchannels (of a derived class) keep their alignment in the init arena. */
+  static void* operator new(size_t sz, std::align_val_t al) { return ssf_arena_malloc(sz, (size_t)al); }
+  static void operator delete(void* p, std::align_val_t al) {}
+#endif
+
   /**
    * \brief Return the entity owner of this inchannel.
    *
@@ -96,6 +109,53 @@ class inChannel {
    */
   Event* activeEvent();
 
+  /**
+   * \brief Return the event arrived at the inchannel as read-only.
+   *
+   * Like activeEvent(), this method can only be called within a
+   * procedure of a process unblocked by an event arrival at this
+   * inchannel. Unlike activeEvent(), the event is not handed over to
+   * the process: no copy is made (even if the event is shared with
+   * other processes or inchannels), the event must not be modified
+   * or deleted, and it remains valid only until the process waits
+   * again (or returns from the procedure). The method can be called
+   * more than once during the same activation; it returns null if
+   * there is no event arrival or if the event has already been
+   * retrieved using activeEvent(). This is the preferred way to
+   * receive a shareable event (see Event::isShareable()).
+   */
+  const Event* peekActiveEvent();
+
+  /**
+   * \brief Handle event arrivals with an entity method.
+   *
+   * Once a callback function is set, an event arrived at the
+   * inchannel is no longer delivered to processes; instead, the
+   * callback function is invoked directly, with a pointer to the
+   * inchannel as the argument, at the simulation time of the
+   * arrival. This is much cheaper than activating a process if the
+   * entity merely reacts to each arrival. Within the callback
+   * function, the arrived event can be retrieved using activeEvent()
+   * or peekActiveEvent(), as from a process. The callback function
+   * must not call any wait statements. No process may wait on the
+   * inchannel while the callback function is set. Passing null
+   * resets the inchannel to deliver events to the processes.
+   *
+   * \param callback points to the callback method of the owner entity
+   */
+  void setCallback(void (Entity::*callback)(inChannel*));
+
+  /**
+   * \brief Handle event arrivals with a regular function.
+   *
+   * This method is the same as the previous one, except that the
+   * callback function is a regular function that takes as argument a
+   * pointer to the inchannel.
+   *
+   * \param callback points to the callback function
+   */
+  void setCallback(void (*callback)(inChannel*));
+
  protected:
   friend class Entity;
   friend class Process;
@@ -109,6 +169,7 @@ class inChannel {
   void set_insensitivity(WaitNode* wnode); // remove a process from the sensitivity list
   void set_static_sensitivity(Process* p); // make a process statically sensitive to this inchannel
   void set_static_insensitivity(Process* p); // remove the inchannel from the process's static set
+  void drop_static_auto(); // turn an automatic static sensitivity back to a dynamic one
   void schedule_arrival(Event* evt); // deliver an event to the inchannel
   void clear_pending_event(); // clean up the arrival event if it's not retrieved
 
@@ -128,13 +189,20 @@ class inChannel {
   // the number of processes activated by the arrival event
   int processes_activated;
 
-  // if provided, this is the name of the inchannel which shall be
-  // globally unique
-  STRING name; 
+  // true while the callback function is handling an arrival
+  bool callback_context;
+
+  // if set, the arrival event is handled by the callback function
+  // (either an entity method or a regular function) rather than by
+  // the processes waiting on this inchannel
+  void (Entity::*ic_entity_callback)(inChannel*);
+  void (*ic_callback)(inChannel*);
 
-  // keep the set of processes that are declared statically sensitive
-  // to this inchannel
-  SET(Process*) static_processes;
+  // keep the list of processes that are declared statically
+  // sensitive to this inchannel; it's scanned on every arrival and
+  // changes rarely, so a flat vector (in the order of declaration)
+  // is used rather than a set
+  VECTOR(Process*) static_processes;
 }; /*class inChannel*/
 
 }; // namespace minissf
@@ -7,7 +7,7 @@
 namespace minissf {
 
 outChannel::outChannel(Entity* owner, VirtualTime delay) :
-  portno(0), entity_owner(owner), channel_delay(delay)
+  portno(0), entity_owner(owner), channel_delay(delay), outports(0)
 {
   if(!Universe::is_initializing()) 
     SSF_THROW("only allowed to be created during simulation initialization");
@@ -20,9 +20,11 @@ outChannel::~outChannel()
 {
   if(!Universe::is_finalizing()) 
     SSF_THROW("can only be deleted during simulation finalization");
-  for(DEQUE(MapOutport*)::iterator iter = outports.begin();
-      iter != outports.end(); iter++) delete (*iter);
-  outports.clear();
+  while(outports) {
+    MapOutport* outport = outports;
+    outports = outport->next;
+    delete outport;
+  }
   entity_owner->delete_outchannel(this);
 }
 
@@ -45,15 +47,17 @@ void outChannel::write_event(Event* evt, VirtualTime write_delay)
 {
   assert(Universe::is_running());
   // reference scheme so that we create the same number of clones of
-  // the user event as there are needed; we assume that
-  // Timeline::insert_event() and Stargate::send_message() do not
-  // alter the event (the event is cloned after insert_event and
-  // send_message
+  // the user event as there are needed (or references, if the event
+  // is shareable); the original event goes to
+  // the last target, since once the event is handed over to another
+  // universe or to the writer thread, it may be reclaimed at any time
   int refs = 0; 
-  for(DEQUE(MapOutport*)::iterator iter = outports.begin();
-      iter != outports.end(); iter++) {
+  MapOutport* outport;
+  for(outport = outports; outport; outport = outport->next)
+    if(!outport->carried) refs++;
+  if(!refs) { delete evt; return; } // if the event is not being sent, reclaim it
+  for(outport = outports; outport; outport = outport->next) {
     // there is one outport corresponding to each target timeline
-    MapOutport* outport = *iter;
     if(outport->inport) { 
       // if not null, the target timeline is on the same machine,
       // although it could be on a different processor
@@ -61,7 +65,7 @@ void outChannel::write_event(Event* evt, VirtualTime write_delay)
       assert(inport && inport->extra_delay == 0);
       ChannelEvent* chevt = new ChannelEvent
 	(this, owner()->now()+write_delay+outport->min_offset, 
-	 (refs++>0)?evt->clone():evt, inport);
+	 (--refs>0)?Event::share_event(evt):evt, inport);
       if(outport->stargate) { 
 	// if not null, we send an event to a different timeline
 	Timeline* source_timeline = outport->stargate->source_timeline;
@@ -69,6 +73,7 @@ void outChannel::write_event(Event* evt, VirtualTime write_delay)
 	Timeline* target_timeline = outport->stargate->target_timeline;
 	assert(inport->ic->entity_owner->timeline == target_timeline);
 	assert(source_timeline != target_timeline);
+	outport->stargate->record_stats_messages();
 	if(target_timeline->universe == source_timeline->universe) {
 	  // the target timeline is in the same universe; we can
 	  // directly insert the event into the target timeline
@@ -84,14 +89,22 @@ void outChannel::write_event(Event* evt, VirtualTime write_delay)
 	entity_owner->timeline->insert_event(chevt);
       }
     } else { // the target timeline is on another machine
+      // only one copy is sent to each remote machine (by the outport
+      // with the smallest min_offset), which will be fanned out to
+      // all target timelines on that machine upon arrival
+      if(outport->carried) continue;
       ChannelEvent* chevt = new ChannelEvent
 	(this, owner()->now()+write_delay+outport->min_offset, 
-	 (refs++>0)?evt->clone():evt, portno);
-      assert(outport->stargate);
-      outport->stargate->send_message(chevt);
+	 (--refs>0)?Event::share_event(evt):evt, portno);
+      // if any of the channels to the machine is asynchronous, the
+      // event must go through an asynchronous one, so that it won't
+      // be held up until the end of the epoch
+      Stargate* sg = outport->stargate; assert(sg);
+      for(MapOutport* p = outport->colocated; sg->in_sync && p; p = p->colocated)
+	if(!p->stargate->in_sync) sg = p->stargate;
+      sg->send_message(chevt);
     }
   }
-  if(!refs) delete evt; // if the event is not being sent, reclaim it
 }
 
 void outChannel::mapto(inChannel* ic, VirtualTime map_delay)
@@ -11,6 +11,7 @@
 #define __MINISSF_OUTCHANNEL_H__
 
 #include "ssfapi/ssf_common.h"
+#include "ssfapi/quick_memory.h"
 #include "kernel/stargate.h"
 
 namespace minissf {
@@ -57,6 +58,18 @@ class outChannel {
    */
   virtual ~outChannel();
 
+  /** \brief Outchannels are allocated from the init arena (like entities). */
+  static void* operator new(size_t sz) { return ssf_arena_malloc(sz); }
+
+  /** \brief The memory of an outchannel is reclaimed with the init arena, not individually. */
+  static void operator delete(void* p) {}
+
+#ifdef __cpp_aligned_new
+  /** \brief Over-aligned outchannels (of a derived class) keep their alignment in the init arena. */
+  static void* operator new(size_t sz, std::align_val_t al) { return ssf_arena_malloc(sz, (size_t)al); }
+  static void operator delete(void* p, std::align_val_t al) {}
+#endif
+
   /** \brief Return the entity owner of this outchannel.
    *
    * The entity owner is permanently set upon creation of the
@@ -134,9 +147,11 @@ class outChannel {
   // event from the outchannel to a mapped inchannel
   VirtualTime channel_delay;
 
-  // the outchannel keeps a list of MapOutport objects, one for each
-  // target timeline mapped from this outchannel
-  DEQUE(MapOutport*) outports;
+  // the outchannel keeps a linked list of MapOutport objects, one
+  // for each target timeline mapped from this outchannel; most
+  // outchannels map to very few timelines, so it costs only a
+  // pointer per outchannel
+  MapOutport* outports;
 
   //inline int get_portno() { return portno; }
   //inline void set_portno(int s) { portno = s; }
@@ -1,13 +1,27 @@
 #include <assert.h>
+#include <algorithm>
 #include "ssfapi/process.h"
 #include "kernel/kernel_event.h"
 #include "kernel/timeline.h"
 #include "kernel/universe.h"
+#include "kernel/coroutine.h"
+
+// a process waiting on the same inchannels this many times in a row
+// is made statically sensitive to them (unless it already has static
+// inchannels set by the user), so that it no longer needs to link
+// and unlink wait nodes at each wait
+#define AUTO_STATIC_REPEATS 3
 
 namespace minissf {
 
 Process::Process(Entity* owner) :
-  entity_owner(owner), start_function(0), start_container(0) 
+  entity_owner(owner), start_function(0), start_container(0), 
+  process_stackful(Universe::args_stackful)
+{ common_constructor(); }
+
+Process::Process(Entity* owner, bool stackful) :
+  entity_owner(owner), start_function(0), start_container(0), 
+  process_stackful(stackful)
 { common_constructor(); }
 
 #if 0 /* disabled after version 1.1 */
@@ -38,12 +52,20 @@ void Process::common_constructor()
   process_state = PROCESS_STATE_CREATING;
   process_stack = 0;
   hold_event = 0;
-  waiton_node = 0;
+  for(int i=0; i<PROCESS_WAITNODE_SLOTS; i++) {
+    waiton_slots[i].p = this;
+    waiton_slots[i].ic = 0;
+    waiton_slots[i].next_p = 0;
+  }
+  waiton_extra = 0;
+  waiton_count = waiton_last = waiton_repeats = 0;
   active_inchannel = 0;
   active_event_retrieved = false;
   process_timedout = false;
   static_sensitivity = false;
+  static_auto = false;
   procedure_context = 0;
+  process_coroutine = 0;
   
   entity_owner->add_process(this); // will schedule init() to be called
 
@@ -58,7 +80,13 @@ Process::~Process()
 
   clear_pending_wait();
   desensitize_static_inchannels();
+  while(waiton_extra) {
+    WaitNode* n = waiton_extra->next_p;
+    delete waiton_extra;
+    waiton_extra = n;
+  }
   while(process_stack) delete pop_stack();
+  if(process_coroutine) delete process_coroutine;
   entity_owner->delete_process(this);
 }
 
@@ -68,9 +96,7 @@ void Process::waitOn(const SET(inChannel*)& icset)
 {
   PROPER_PROCEDURE(this);
   if(!icset.empty()) {
-    for(SET(inChannel*)::iterator iter = icset.begin();
-	iter != icset.end(); iter++)
-      sensitize_inchannel(*iter);
+    sensitize_inchannels(icset.begin(), icset.end());
     suspend_process();
   } else {
     SSF_THROW("empty inchannel set"); // maybe we shouldn't abort
@@ -82,7 +108,7 @@ void Process::waitOn(inChannel* ic)
 {
   PROPER_PROCEDURE(this);
   if(ic) {
-    sensitize_inchannel(ic);
+    sensitize_inchannels(&ic, &ic+1);
     suspend_process();
   } else {
     SSF_THROW("null inchannel"); // maybe we shouldn't abort
@@ -94,6 +120,7 @@ void Process::waitForever()
 { 
   PROPER_PROCEDURE(this);
   entity_owner->timeline->deactivate_process(PROCESS_STATE_TERMINATING);
+  if(process_coroutine) process_coroutine->yield(); // never resumed
 }
 
 void Process::suspendForever()
@@ -120,9 +147,7 @@ bool Process::waitOnFor(const SET(inChannel*)& icset, VirtualTime delay)
 {
   PROPER_PROCEDURE(this);
   if(delay < 0) SSF_THROW("negative delay: " << delay);
-  for(SET(inChannel*)::iterator iter = icset.begin();
-      iter != icset.end(); iter++)
-    sensitize_inchannel(*iter);
+  sensitize_inchannels(icset.begin(), icset.end());
   hold_for(delay);
   return true;
 }
@@ -131,7 +156,7 @@ bool Process::waitOnFor(inChannel* ic, VirtualTime delay)
 {
   PROPER_PROCEDURE(this);
   if(delay < 0) SSF_THROW("negative delay: " << delay);
-  if(ic) sensitize_inchannel(ic);
+  if(ic) sensitize_inchannels(&ic, &ic+1);
   hold_for(delay);
   return true;
 }
@@ -140,9 +165,7 @@ bool Process::waitOnUntil(const SET(inChannel*)& icset, VirtualTime time)
 {
   PROPER_PROCEDURE(this);
   if(time < now()) SSF_THROW("time in the past: " << time);
-  for(SET(inChannel*)::iterator iter = icset.begin();
-      iter != icset.end(); iter++)
-    sensitize_inchannel(*iter);
+  sensitize_inchannels(icset.begin(), icset.end());
   hold_until(time);
   return true;
 }
@@ -151,7 +174,7 @@ bool Process::waitOnUntil(inChannel* ic, VirtualTime time)
 {
   PROPER_PROCEDURE(this);
   if(time < now()) SSF_THROW("time in the past: " << time);
-  if(ic) sensitize_inchannel(ic);
+  if(ic) sensitize_inchannels(&ic, &ic+1);
   hold_until(time);
   return true;
 }
@@ -173,6 +196,7 @@ void Process::waitsOn(inChannel* ic)
 void Process::waitOn()
 {
   PROPER_PROCEDURE(this);
+  if(static_auto) desensitize_static_inchannels(); // not set by user
   if(!static_inchannels.empty()) {
     static_sensitivity = true;
     suspend_process();
@@ -186,6 +210,7 @@ bool Process::waitOnFor(VirtualTime delay)
 {
   PROPER_PROCEDURE(this);
   if(delay < 0) SSF_THROW("negative delay: " << delay);
+  if(static_auto) desensitize_static_inchannels(); // not set by user
   static_sensitivity = true;
   hold_for(delay);
   return true;
@@ -195,6 +220,7 @@ bool Process::waitOnUntil(VirtualTime time)
 {
   PROPER_PROCEDURE(this);
   if(time < now()) SSF_THROW("time in the past: " << time);
+  if(static_auto) desensitize_static_inchannels(); // not set by user
   static_sensitivity = true;
   hold_until(time);
   return true;
@@ -216,41 +242,117 @@ Procedure* Process::pop_stack()
   return p;
 }
 
-void Process::sensitize_inchannel(inChannel* ic)
+template<typename Iter>
+void Process::sensitize_inchannels(Iter first, Iter last)
 {
-  assert(ic);
-  WaitNode* wnode = new WaitNode;
-  wnode->p = this;
-  wnode->ic = ic;
-  wnode->next_p = waiton_node;
-  waiton_node = wnode;
-  ic->set_sensitivity(wnode);
+  // if the static inchannels were set automatically, they are used
+  // as long as the process waits on the same inchannels
+  if(static_auto) {
+    Iter iter = first; int i = 0, n = static_inchannels.size();
+    while(iter != last && i < n && *iter == static_inchannels[i]) { iter++; i++; }
+    if(iter == last && i == n) {
+      static_sensitivity = true;
+      return;
+    }
+    desensitize_static_inchannels();
+  }
+
+  bool same = link_wait_nodes(first, last);
+  if(same && waiton_count == waiton_last) waiton_repeats++;
+  else waiton_repeats = 0;
+  waiton_last = waiton_count;
+
+  // the process is made statically sensitive only if it's the sole
+  // process waiting on each of the inchannels; static processes are
+  // activated before the dynamic ones, which would otherwise change
+  // the order of the processes activated at the same time
+  if(waiton_count > 0 && waiton_repeats >= AUTO_STATIC_REPEATS && 
+     static_inchannels.empty()) {
+    for(Iter iter = first; iter != last; iter++) {
+      inChannel* ic = *iter;
+      if(!ic->static_processes.empty() || ic->wait_head != ic->wait_tail) return;
+    }
+    desensitize_inchannels();
+    for(Iter iter = first; iter != last; iter++)
+      sensitize_static_inchannel(*iter);
+    static_auto = true;
+    static_sensitivity = true;
+  }
+}
+
+template<typename Iter>
+bool Process::link_wait_nodes(Iter first, Iter last)
+{
+  // the wait nodes are reused: they still remember the inchannels of
+  // the last wait, so we can tell whether they are the same
+  assert(!waiton_count);
+  bool same = true;
+  WaitNode** extra = &waiton_extra;
+  for(Iter iter = first; iter != last; iter++) {
+    inChannel* ic = *iter; assert(ic);
+    WaitNode* wnode;
+    if(waiton_count < PROCESS_WAITNODE_SLOTS)
+      wnode = &waiton_slots[waiton_count];
+    else {
+      if(!*extra) {
+	*extra = new WaitNode; assert(*extra);
+	(*extra)->p = this;
+	(*extra)->ic = 0;
+	(*extra)->next_p = 0;
+      }
+      wnode = *extra;
+      extra = &wnode->next_p;
+    }
+    if(wnode->ic != ic) { wnode->ic = ic; same = false; }
+    ic->set_sensitivity(wnode);
+    waiton_count++;
+  }
+  return same;
+}
+
+void Process::demote_static_auto()
+{
+  // the process goes back to waiting dynamically on the inchannels
+  // (if it's waiting at all); the repeats are counted anew
+  assert(static_auto);
+  VECTOR(inChannel*) ics(static_inchannels);
+  desensitize_static_inchannels();
+  waiton_repeats = 0;
+  if(static_sensitivity) {
+    static_sensitivity = false;
+    link_wait_nodes(ics.begin(), ics.end());
+  }
 }
 
 void Process::desensitize_inchannels()
 {
-  while(waiton_node) {
-    WaitNode* n = waiton_node->next_p;
-    assert(waiton_node->p == this);
-    waiton_node->ic->set_insensitivity(waiton_node);
-    delete waiton_node;
-    waiton_node = n;
+  WaitNode* extra = waiton_extra;
+  for(int i=0; i<waiton_count; i++) {
+    WaitNode* wnode;
+    if(i < PROCESS_WAITNODE_SLOTS) wnode = &waiton_slots[i];
+    else { wnode = extra; extra = extra->next_p; }
+    assert(wnode->p == this);
+    wnode->ic->set_insensitivity(wnode);
   }
+  waiton_count = 0; // the wait nodes are kept for the next wait
 }
 
 void Process::sensitize_static_inchannel(inChannel* ic)
 {
   assert(ic);
+  if(std::find(static_inchannels.begin(), static_inchannels.end(), ic) != 
+     static_inchannels.end()) return; // already sensitive
   ic->set_static_sensitivity(this);
-  static_inchannels.insert(ic);
+  static_inchannels.push_back(ic);
 }
 
 void Process::desensitize_static_inchannels()
 {
-  for(SET(inChannel*)::iterator iter = static_inchannels.begin();
+  for(VECTOR(inChannel*)::iterator iter = static_inchannels.begin();
       iter != static_inchannels.end(); iter++)
     (*iter)->set_static_insensitivity(this);
   static_inchannels.clear();
+  static_auto = false;
 }
 
 void Process::hold_for(VirtualTime delay)
@@ -268,11 +370,26 @@ void Process::hold_until(VirtualTime time)
 
 void Process::execute_process()
 {
-  activate_procedure();
+  if(process_stackful) {
+    // the stack is created when the process runs for the first time;
+    // the process returns here whenever it's blocked
+    if(!process_coroutine) {
+      process_coroutine = new Coroutine(entity_owner->timeline, stackful_process, this);
+      assert(process_coroutine);
+    }
+    process_coroutine->resume();
+  } else activate_procedure();
   if(process_state == PROCESS_STATE_TERMINATING)
     terminate_process();
 }
 
+void Process::stackful_process(void* p)
+{
+  // same as a translated process, the starting procedure is called
+  // again if it returns
+  for(;;) ((Process*)p)->activate_procedure();
+}
+
 void Process::activate_procedure()
 {
   // if start_function=0 and start_container=0, that's
@@ -296,6 +413,7 @@ void Process::activate_procedure()
 void Process::suspend_process()
 {
   entity_owner->timeline->deactivate_process(PROCESS_STATE_WAITING);
+  if(process_coroutine) process_coroutine->yield(); // until the process is activated again
 }
 
 void Process::terminate_process()
@@ -309,9 +427,9 @@ void Process::clear_pending_wait()
   if(process_state == PROCESS_STATE_RUNNING ||
      process_state == PROCESS_STATE_WAITING) {
     if(hold_event) { entity_owner->cancel_event(hold_event); hold_event = 0; }
-    if(waiton_node) desensitize_inchannels();
+    if(waiton_count) desensitize_inchannels();
     static_sensitivity = false;
-  } else assert(!hold_event && !waiton_node && !static_sensitivity);
+  } else assert(!hold_event && !waiton_count && !static_sensitivity);
 }
 
 void Process::clear_process_context()
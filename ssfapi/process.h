@@ -16,7 +16,22 @@
 
 namespace minissf {
 
-class WaitNode;
+class Coroutine;
+
+// the number of wait nodes embedded in each process; a process
+// waiting on more inchannels at a time uses extra wait nodes from
+// quick memory (which are kept by the process for reuse)
+#define PROCESS_WAITNODE_SLOTS 2
+
+// assocate inchannel and its waiting process
+class WaitNode : public QuickObject {
+ public:
+  Process* p; // points to the process
+  inChannel* ic; // points to the inchannel
+  WaitNode* next_p; // next extra wait node of the process
+  WaitNode* prev_c; // previous process that is also sensitive to the inchannel
+  WaitNode* next_c; // next process that is also sensitive to the inchannel
+}; /*class WaitNode*/
 
 /**
  * \brief Encapsulation of a simulation process as a single thread of control.
@@ -51,6 +66,24 @@ class Process : public ProcedureContainer {
    */
   Process(Entity* owner);
 
+  /**
+   * \brief Creating a process that runs on its own stack, or not.
+   *
+   * This constructor is similar to the previous one, except that the
+   * user decides whether the process is stackful, rather than using
+   * the default set by the command-line option. A stackful process
+   * runs on its own stack and the wait statements simply switch
+   * stacks. As such, the procedures of a stackful process are plain
+   * C++ functions and the model needs no source code
+   * translation. Objects left on the stack of a stackful process are
+   * discarded without being destroyed when the process is reclaimed,
+   * and exceptions must not be thrown beyond the starting procedure.
+   *
+   * \param owner points to the entity owner of this process
+   * \param stackful true if the process runs on its own stack
+   */
+  Process(Entity* owner, bool stackful);
+
 #if 0 /* disabled after version 1.1 */
   /**
    * \brief The constructor using an entity method as the starting procedure.
@@ -127,6 +160,9 @@ class Process : public ProcedureContainer {
    */
   inline Entity* owner() { return entity_owner; }
 
+  /** \brief Return whether the process runs on its own stack. */
+  inline bool isStackful() { return process_stackful; }
+
   /** \brief An alias to the Entity::now() method. */
   VirtualTime now();
 
@@ -387,6 +423,10 @@ class Process : public ProcedureContainer {
   // from timeout or due to event arrival
   inline bool timed_out() { return process_timedout; }
 
+  // used by embedded code to check whether the wait statement just
+  // called has blocked the process
+  inline bool suspended() { return process_state != PROCESS_STATE_RUNNING; }
+
  private:
   friend class Entity;
   friend class Event;
@@ -398,6 +438,7 @@ class Process : public ProcedureContainer {
   friend class SemaphoreEvent;
   friend class Procedure;
   friend class Timeline;
+  friend class Universe;
 
   // the four possible states of a process
   enum {
@@ -413,13 +454,20 @@ class Process : public ProcedureContainer {
   ProcedureContainer* start_container; // root procedure container
   Procedure* process_stack; // heap stack
   HoldEvent* hold_event; // scheduled event for timed wait
-  WaitNode* waiton_node; // cross link between inchannels and waiting processes
+  WaitNode waiton_slots[PROCESS_WAITNODE_SLOTS]; // embedded cross links between inchannels and waiting process
+  WaitNode* waiton_extra; // more wait nodes if waiting on more inchannels than the embedded ones
+  int waiton_count; // number of wait nodes in use (i.e., inchannels dynamically sensitive to)
+  int waiton_last; // number of wait nodes used by the last dynamic wait
+  int waiton_repeats; // number of consecutive dynamic waits on the same inchannels
   inChannel* active_inchannel; // only one inchannel may activate a process at a time!
   bool active_event_retrieved; // true when active inchannel active event has been retrieved
   bool process_timedout; // set when process is activivated due to timeout
   bool static_sensitivity; // true if blocking on static inchannels
+  bool static_auto; // true if static inchannels are set from repeated dynamic waits
   int procedure_context; // process is active so procedures are invoked properly
-  SET(inChannel*) static_inchannels; // all statically sensitive inchannels
+  bool process_stackful; // true if the process runs on its own stack
+  Coroutine* process_coroutine; // the stack of a stackful process (created when it first runs)
+  VECTOR(inChannel*) static_inchannels; // all statically sensitive inchannels (no duplicates)
 
  public: // since the following methods are also called by embedded code, we made them public
   // dealing with the procedures on the stack
@@ -432,7 +480,11 @@ class Process : public ProcedureContainer {
   void common_constructor();
 
   // dealing with waiting for inchannels, statically or dynamically
-  void sensitize_inchannel(inChannel* ic); // make dynamically sensitive to an in-channel
+  template<typename Iter>
+  void sensitize_inchannels(Iter first, Iter last); // make dynamically sensitive to in-channels
+  template<typename Iter>
+  bool link_wait_nodes(Iter first, Iter last); // link the wait nodes to in-channels (true if same as the last wait)
+  void demote_static_auto(); // turn the automatic static sensitivities back to dynamic ones
   void desensitize_inchannels();// remove dynamic sensitivities to all in-channels
   void sensitize_static_inchannel(inChannel* ic); // make statically sensitive to an in-channel
   void desensitize_static_inchannels(); // remove static sensitivities to all in-channels
@@ -441,6 +493,7 @@ class Process : public ProcedureContainer {
   void hold_until(VirtualTime time); // suspend the process until the specified time
 
   void execute_process(); // continue running this process
+  static void stackful_process(void* p); // the start function of a stackful process
   void activate_procedure(); // activate start procedure or the one on top of stack
   void suspend_process(); // block this process from execution
   void terminate_process(); // terminate this process
@@ -449,16 +502,6 @@ class Process : public ProcedureContainer {
   void clear_process_context(); // clear process context information (timeout flag and active channel)
 }; /*class Process*/
 
-// assocate inchannel and its waiting process
-class WaitNode {
- public:
-  Process* p; // points to the process
-  inChannel* ic; // points to the inchannel
-  WaitNode* next_p; // next inchannel the process is waiting on
-  WaitNode* prev_c; // previous process that is also sensitive to the inchannel
-  WaitNode* next_c; // next process that is also sensitive to the inchannel
-}; /*class WaitNode*/
-
 }; /*namespace minissf*/
 
 #include "ssfapi/entity.h"
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "ssfapi/quick_memory.h"
 #include "kernel/universe.h"
 
@@ -7,8 +9,12 @@ namespace minissf {
 
 #define SSF_QMEM_ALIGNMENT 8 // make sure the first bucket is larger than this!
 #define SSF_QMEM_NUMBUCKETS 9
-#define SSF_QMEM_POOLCHUNK 32768
+#define SSF_QMEM_POOLCHUNK 32768 // must be a power of two
 #define SSF_QMEM_THRESHOLD 4096
+#define SSF_QMEM_KEEPIDLE 4 // idle chunks kept in memory before we give them back
+#define SSF_QMEM_HUGEPAGE (2*1024*1024) // must be a multiple of the chunk size
+#define SSF_ARENA_CHUNK (1024*1024) // size of each init arena chunk
+#define SSF_ARENA_ALIGNMENT 16 // alignment of objects carved from the arena
 
 extern int ssf_processor_index();
 
@@ -16,6 +22,26 @@ extern int ssf_processor_index();
 #define SSF_QMEM_BUCKETIZE(s, n, b) if(s <= n) return b
 #define SSF_QMEM_PRIVATE(x) (universe->x)
 
+// each memory chunk serves memory blocks of one size class; it's
+// aligned at its size so that one can find the chunk from any memory
+// block carved out of it; the chunk starts with the following header
+class QuickChunk {
+ public:
+  QuickChunk* next; // the next chunk owned by the same universe
+  QuickChunk* prev_avail; // the previous chunk in the partial list
+  QuickChunk* next_avail; // the next chunk in the partial, idle, or released list
+  char* carve; // start of the memory not yet carved out
+  void* freelist; // the free blocks in this chunk
+  int owner; // the processor id of the owner universe
+  int bucket; // the size class; -1 if the chunk is idle
+  int nlive; // number of live blocks in this chunk
+  bool partial; // whether the chunk is in the partial list
+};
+#define SSF_QMEM_HEADER 64 // must be no smaller than sizeof(QuickChunk)
+#define SSF_QMEM_CHUNK(p) ((QuickChunk*)((size_t)(p)&~(size_t)(SSF_QMEM_POOLCHUNK-1)))
+
+static long ssf_quickmem_pagesize = 0;
+
 // round the size up to the power of two
 static int ssf_quickmem_canonicalize(size_t size)
 {
@@ -46,37 +72,166 @@ static int ssf_quickmem_bucketize(size_t size)
   return -1;
 }
 
-// allocate a new chunk of memory for the memory pool
+// map anonymous memory of the given size aligned at the given boundary
+static char* ssf_quickmem_map(size_t size, size_t align)
+{
+  char* mem = (char*)mmap(0, size+align, PROT_READ|PROT_WRITE, 
+			  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if(mem == (char*)MAP_FAILED) SSF_THROW("out of memory for quick memory pool");
+
+  // trim the unaligned head and the tail
+  char* aligned = (char*)(((size_t)mem+align-1)&~(align-1));
+  if(aligned > mem) munmap(mem, aligned-mem);
+  if(mem+align > aligned) munmap(aligned+size, mem+align-aligned);
+  return aligned;
+}
+
+// allocate new memory chunks and put them in the idle list
 static void ssf_quickmem_allocate_pool(Universe* universe)
 {
-  // allocate the memory chunk
-  SSF_QMEM_PRIVATE(qmem_poolsize) += SSF_QMEM_POOLCHUNK;
-  SSF_QMEM_PRIVATE(qmem_poolbegin) = new char[SSF_QMEM_POOLCHUNK];
-  assert(SSF_QMEM_PRIVATE(qmem_poolbegin));
-  SSF_QMEM_PRIVATE(qmem_poolend) = 
-    SSF_QMEM_PRIVATE(qmem_poolbegin)+SSF_QMEM_POOLCHUNK;
+  size_t size = SSF_QMEM_POOLCHUNK;
+  char* mem;
+  if(Universe::args_qmem_hugepage) {
+    // carve the chunks out of one huge page
+    size = SSF_QMEM_HUGEPAGE;
+    mem = ssf_quickmem_map(size, SSF_QMEM_HUGEPAGE);
+#ifdef MADV_HUGEPAGE
+    madvise(mem, size, MADV_HUGEPAGE);
+#endif
+  } else mem = ssf_quickmem_map(size, SSF_QMEM_POOLCHUNK);
+  SSF_QMEM_PRIVATE(qmem_poolsize) += size;
+
+  for(char* p = mem; p < mem+size; p += SSF_QMEM_POOLCHUNK) {
+    QuickChunk* chunk = (QuickChunk*)p;
+    chunk->next = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_chunklist);
+    SSF_QMEM_PRIVATE(qmem_chunklist) = (char*)chunk;
+    chunk->owner = universe->processor_id;
+    chunk->bucket = -1;
+    chunk->partial = false;
+    chunk->next_avail = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_idle);
+    SSF_QMEM_PRIVATE(qmem_idle) = (char*)chunk;
+    SSF_QMEM_PRIVATE(qmem_nidle)++;
+  }
+}
+
+// add the chunk to the partial list of its size class
+static void ssf_quickmem_add_partial(Universe* universe, QuickChunk* chunk)
+{
+  QuickChunk*& head = (QuickChunk*&)SSF_QMEM_PRIVATE(qmem_partial)[chunk->bucket];
+  chunk->prev_avail = 0;
+  chunk->next_avail = head;
+  if(head) head->prev_avail = chunk;
+  head = chunk;
+  chunk->partial = true;
+}
+
+// remove the chunk from the partial list of its size class
+static void ssf_quickmem_remove_partial(Universe* universe, QuickChunk* chunk)
+{
+  QuickChunk*& head = (QuickChunk*&)SSF_QMEM_PRIVATE(qmem_partial)[chunk->bucket];
+  if(chunk->prev_avail) chunk->prev_avail->next_avail = chunk->next_avail;
+  else head = chunk->next_avail;
+  if(chunk->next_avail) chunk->next_avail->prev_avail = chunk->prev_avail;
+  chunk->partial = false;
+}
+
+// get an idle chunk (or a released one) for the given size class
+static QuickChunk* ssf_quickmem_get_chunk(Universe* universe, int bucket)
+{
+  QuickChunk* chunk;
+  if(!SSF_QMEM_PRIVATE(qmem_idle) && !SSF_QMEM_PRIVATE(qmem_released))
+    ssf_quickmem_allocate_pool(universe);
+  if(SSF_QMEM_PRIVATE(qmem_idle)) {
+    chunk = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_idle);
+    SSF_QMEM_PRIVATE(qmem_idle) = (char*)chunk->next_avail;
+    SSF_QMEM_PRIVATE(qmem_nidle)--;
+  } else {
+    // the pages will be faulted in again as the blocks are carved out
+    chunk = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_released);
+    SSF_QMEM_PRIVATE(qmem_released) = (char*)chunk->next_avail;
+    SSF_QMEM_PRIVATE(qmem_poolsize) += SSF_QMEM_POOLCHUNK-ssf_quickmem_pagesize;
+  }
 
-  // link it with the existing chunks (using the first 16 bytes)
-  *(char**)SSF_QMEM_PRIVATE(qmem_poolbegin) = SSF_QMEM_PRIVATE(qmem_chunklist);
-  SSF_QMEM_PRIVATE(qmem_chunklist) = SSF_QMEM_PRIVATE(qmem_poolbegin);
-  SSF_QMEM_PRIVATE(qmem_poolbegin) += 16;
+  chunk->bucket = bucket;
+  chunk->carve = (char*)chunk+SSF_QMEM_HEADER;
+  chunk->freelist = 0;
+  chunk->nlive = 0;
+  ssf_quickmem_add_partial(universe, chunk);
+  return chunk;
+}
+
+// a chunk with no live blocks becomes idle; if there are already
+// enough idle chunks, the memory of the chunk (except the page
+// holding the header) is given back to the system
+static void ssf_quickmem_retire_chunk(Universe* universe, QuickChunk* chunk)
+{
+  if(chunk->partial) ssf_quickmem_remove_partial(universe, chunk);
+  chunk->bucket = -1;
+  if(SSF_QMEM_PRIVATE(qmem_nidle) < SSF_QMEM_KEEPIDLE || 
+     Universe::args_qmem_hugepage || // giving back part of a huge page would split it
+     ssf_quickmem_pagesize >= SSF_QMEM_POOLCHUNK) {
+    chunk->next_avail = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_idle);
+    SSF_QMEM_PRIVATE(qmem_idle) = (char*)chunk;
+    SSF_QMEM_PRIVATE(qmem_nidle)++;
+  } else {
+    madvise((char*)chunk+ssf_quickmem_pagesize, 
+	    SSF_QMEM_POOLCHUNK-ssf_quickmem_pagesize, MADV_DONTNEED);
+    SSF_QMEM_PRIVATE(qmem_poolsize) -= SSF_QMEM_POOLCHUNK-ssf_quickmem_pagesize;
+    chunk->next_avail = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_released);
+    SSF_QMEM_PRIVATE(qmem_released) = (char*)chunk;
+  }
+}
+
+// return a memory block to the chunk it's carved from; this is
+// called only by the owner
+static void ssf_quickmem_free_local(Universe* universe, void* p, size_t size)
+{
+  QuickChunk* chunk = SSF_QMEM_CHUNK(p);
+  assert(chunk->owner == universe->processor_id && chunk->nlive > 0);
+  *((void**)p) = chunk->freelist;
+  chunk->freelist = p;
+  SSF_QMEM_PRIVATE(qmem_inuse) -= size;
+  SSF_QMEM_PRIVATE(qmem_live)[chunk->bucket] -= size;
+  if(!--chunk->nlive) ssf_quickmem_retire_chunk(universe, chunk);
+  else if(!chunk->partial) ssf_quickmem_add_partial(universe, chunk);
+}
+
+// move all memory blocks freed by other universes back to their
+// chunks; this is called only by the owner
+static void ssf_quickmem_drain_remote(Universe* universe)
+{
+  void* p = __atomic_exchange_n(&SSF_QMEM_PRIVATE(qmem_remotefree), (void*)0, __ATOMIC_ACQUIRE);
+  while(p) {
+    // the size is kept in the first SSF_QMEM_ALIGNMENT bytes and the
+    // link to the next block in the stack is right after it
+    void* next = *(void**)((char*)p+SSF_QMEM_ALIGNMENT);
+    ssf_quickmem_free_local(universe, p, *(size_t*)p);
+    SSF_QMEM_PRIVATE(qmem_drift_in)++;
+    p = next;
+  }
 }
 
 void ssf_quickmem_init(int pid)
 {
   Universe* universe = Universe::parallel_universe[pid]; 
   assert(universe);
+  if(!ssf_quickmem_pagesize) ssf_quickmem_pagesize = sysconf(_SC_PAGESIZE);
 
-  // get the first chunk
   SSF_QMEM_PRIVATE(qmem_chunklist) = 0;
-  ssf_quickmem_allocate_pool(universe);
+  SSF_QMEM_PRIVATE(qmem_partial) = new void*[SSF_QMEM_NUMBUCKETS];
+  assert(SSF_QMEM_PRIVATE(qmem_partial));
+  SSF_QMEM_PRIVATE(qmem_live) = new long[SSF_QMEM_NUMBUCKETS];
+  assert(SSF_QMEM_PRIVATE(qmem_live));
+  SSF_QMEM_PRIVATE(qmem_peak) = new long[SSF_QMEM_NUMBUCKETS];
+  assert(SSF_QMEM_PRIVATE(qmem_peak));
+  for(int i=0; i<SSF_QMEM_NUMBUCKETS; i++) {
+    SSF_QMEM_PRIVATE(qmem_partial)[i] = 0;
+    SSF_QMEM_PRIVATE(qmem_live)[i] = 0;
+    SSF_QMEM_PRIVATE(qmem_peak)[i] = 0;
+  }
 
-  // make a free list at the start of the chunk (next to the first 16 bytes)
-  SSF_QMEM_PRIVATE(qmem_freelist) = (void**)SSF_QMEM_PRIVATE(qmem_poolbegin);
-  SSF_QMEM_PRIVATE(qmem_poolbegin) +=  
-    ssf_quickmem_canonicalize(sizeof(void*)*SSF_QMEM_NUMBUCKETS);
-  for(int i=0; i<SSF_QMEM_NUMBUCKETS; i++)
-    SSF_QMEM_PRIVATE(qmem_freelist)[i] = 0;
+  // get the first chunk
+  ssf_quickmem_allocate_pool(universe);
 }
 
 void ssf_quickmem_wrapup(int pid)
@@ -86,10 +241,37 @@ void ssf_quickmem_wrapup(int pid)
 
   // return the memory chunks one after another back to system
   while(SSF_QMEM_PRIVATE(qmem_chunklist)) {
-    char* next = *(char**)SSF_QMEM_PRIVATE(qmem_chunklist);
-    delete[] SSF_QMEM_PRIVATE(qmem_chunklist);
-    SSF_QMEM_PRIVATE(qmem_chunklist) = next;
+    QuickChunk* chunk = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_chunklist);
+    SSF_QMEM_PRIVATE(qmem_chunklist) = (char*)chunk->next;
+    munmap(chunk, SSF_QMEM_POOLCHUNK);
   }
+  SSF_QMEM_PRIVATE(qmem_idle) = SSF_QMEM_PRIVATE(qmem_released) = 0;
+  SSF_QMEM_PRIVATE(qmem_nidle) = 0;
+  SSF_QMEM_PRIVATE(qmem_poolsize) = 0;
+  delete[] SSF_QMEM_PRIVATE(qmem_partial);
+  delete[] SSF_QMEM_PRIVATE(qmem_live);
+  delete[] SSF_QMEM_PRIVATE(qmem_peak);
+  SSF_QMEM_PRIVATE(qmem_partial) = 0;
+  SSF_QMEM_PRIVATE(qmem_live) = SSF_QMEM_PRIVATE(qmem_peak) = 0;
+}
+
+void ssf_quickmem_report(int pid, bool header)
+{
+  Universe* universe = Universe::parallel_universe[pid]; 
+  assert(universe);
+
+  if(header) {
+    printf("[%d:0] QMEM     ", Universe::args_rank);
+    for(int i=0; i<SSF_QMEM_NUMBUCKETS; i++) printf(" %-9d", 16<<i);
+    printf("\n");
+  }
+  printf("[%d:%d] LIVE     ", Universe::args_rank, pid);
+  for(int i=0; i<SSF_QMEM_NUMBUCKETS; i++) 
+    printf(" %-9lu", (unsigned long)SSF_QMEM_PRIVATE(qmem_live)[i]);
+  printf("\n[%d:%d] PEAK     ", Universe::args_rank, pid);
+  for(int i=0; i<SSF_QMEM_NUMBUCKETS; i++) 
+    printf(" %-9lu", (unsigned long)SSF_QMEM_PRIVATE(qmem_peak)[i]);
+  printf("\n");
 }
 
 void* ssf_quickmem_malloc(size_t size)
@@ -104,25 +286,38 @@ void* ssf_quickmem_malloc(size_t size)
     return (void*)mem;
   }
 
-  // find the free list of the right size
+  // find a chunk with free blocks of the right size
   Universe* universe = Universe::parallel_universe[ssf_processor_index()];
   assert(universe);
   size_t canon_size = ssf_quickmem_canonicalize(size);
   int bucket = ssf_quickmem_bucketize(canon_size);
-  char* mem = (char*)SSF_QMEM_PRIVATE(qmem_freelist)[bucket];
+  QuickChunk* chunk = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_partial)[bucket];
+  if(!chunk && SSF_QMEM_PRIVATE(qmem_remotefree)) {
+    // reclaim the blocks returned by other universes in one batch
+    ssf_quickmem_drain_remote(universe);
+    chunk = (QuickChunk*)SSF_QMEM_PRIVATE(qmem_partial)[bucket];
+  }
+  if(!chunk) chunk = ssf_quickmem_get_chunk(universe, bucket);
+
+  char* mem = (char*)chunk->freelist;
   if(mem) {
     // if there's a memory block in the free list, use it
-    SSF_QMEM_PRIVATE(qmem_freelist)[bucket] = *((void**)mem);
+    chunk->freelist = *((void**)mem);
   } else {
-    // if the memory chunk exhausted
-    if(SSF_QMEM_PRIVATE(qmem_poolbegin)+canon_size > 
-       SSF_QMEM_PRIVATE(qmem_poolend))
-      ssf_quickmem_allocate_pool(universe);
-
     // carve out a memory block
-    mem = SSF_QMEM_PRIVATE(qmem_poolbegin);
-    SSF_QMEM_PRIVATE(qmem_poolbegin) += canon_size;
+    mem = chunk->carve;
+    chunk->carve += canon_size;
   }
+  chunk->nlive++;
+  if(!chunk->freelist && chunk->carve+canon_size > (char*)chunk+SSF_QMEM_POOLCHUNK)
+    ssf_quickmem_remove_partial(universe, chunk); // the chunk is full
+
+  SSF_QMEM_PRIVATE(qmem_inuse) += canon_size;
+  if(SSF_QMEM_PRIVATE(qmem_inuse) > SSF_QMEM_PRIVATE(qmem_highwater))
+    SSF_QMEM_PRIVATE(qmem_highwater) = SSF_QMEM_PRIVATE(qmem_inuse);
+  SSF_QMEM_PRIVATE(qmem_live)[bucket] += canon_size;
+  if(SSF_QMEM_PRIVATE(qmem_live)[bucket] > SSF_QMEM_PRIVATE(qmem_peak)[bucket])
+    SSF_QMEM_PRIVATE(qmem_peak)[bucket] = SSF_QMEM_PRIVATE(qmem_live)[bucket];
 
   // store the size in the first SSF_QMEM_ALIGNMENT bytes
   *(size_t*)mem = canon_size;
@@ -143,13 +338,73 @@ void ssf_quickmem_free(void *p)
     return;
   }
 
-  // return the memory block to the free list of the right size
   Universe* universe = Universe::parallel_universe[ssf_processor_index()];
   assert(universe);
-  int bucket = ssf_quickmem_bucketize(size);
-  assert(bucket >= 0);
-  *((void**)p) = SSF_QMEM_PRIVATE(qmem_freelist)[bucket];
-  SSF_QMEM_PRIVATE(qmem_freelist)[bucket] = p;
+  int owner = SSF_QMEM_CHUNK(p)->owner;
+  if(owner == universe->processor_id) {
+    // return the memory block to its chunk
+    ssf_quickmem_free_local(universe, p, size);
+  } else {
+    // the memory block belongs to another universe; push it onto the
+    // owner's remote-free stack (keeping the size in place)
+    SSF_QMEM_PRIVATE(qmem_drift_out)++;
+    Universe* ouniv = Universe::parallel_universe[owner];
+    assert(ouniv);
+    void* head = __atomic_load_n(&ouniv->qmem_remotefree, __ATOMIC_RELAXED);
+    do *(void**)((char*)p+SSF_QMEM_ALIGNMENT) = head;
+    while(!__atomic_compare_exchange_n(&ouniv->qmem_remotefree, &head, p, true, 
+				       __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  }
+}
+
+// the init arena is a list of chunks, each starting with a link to
+// the previous chunk and its size; objects are carved out from the
+// newest chunk back to back without any per-object header
+static char* ssf_arena_chunks = 0;
+static char* ssf_arena_carve = 0;
+static char* ssf_arena_end = 0;
+static size_t ssf_arena_total = 0;
+
+void* ssf_arena_malloc(size_t size, size_t align)
+{
+  // the alignment must be a power of two; objects are always aligned
+  // at least to SSF_ARENA_ALIGNMENT (the carve point stays so aligned)
+  assert(align > 0 && !(align&(align-1)));
+  if(align < SSF_ARENA_ALIGNMENT) align = SSF_ARENA_ALIGNMENT;
+  size = (size+SSF_ARENA_ALIGNMENT-1)&~(size_t)(SSF_ARENA_ALIGNMENT-1);
+  Universe::init_lock(); // if the model is initialized in parallel
+  char* p = (char*)(((size_t)ssf_arena_carve+align-1)&~(align-1));
+  if(!ssf_arena_carve || p+size > ssf_arena_end) {
+    // the chunk is page aligned, so the padding before an object at
+    // the start of the chunk is no more than the alignment
+    size_t csz = SSF_ARENA_CHUNK;
+    if(size+align > csz) csz = size+align;
+    if(!ssf_quickmem_pagesize) ssf_quickmem_pagesize = sysconf(_SC_PAGESIZE);
+    char* chunk = ssf_quickmem_map(csz, ssf_quickmem_pagesize);
+    *(char**)chunk = ssf_arena_chunks;
+    *(size_t*)(chunk+sizeof(char*)) = csz;
+    ssf_arena_chunks = chunk;
+    ssf_arena_carve = chunk+SSF_ARENA_ALIGNMENT;
+    ssf_arena_end = chunk+csz;
+    p = (char*)(((size_t)ssf_arena_carve+align-1)&~(align-1));
+  }
+  ssf_arena_total += p+size-ssf_arena_carve;
+  ssf_arena_carve = p+size;
+  Universe::init_unlock();
+  return p;
+}
+
+size_t ssf_arena_size() { return ssf_arena_total; }
+
+void ssf_arena_release()
+{
+  while(ssf_arena_chunks) {
+    char* chunk = ssf_arena_chunks;
+    ssf_arena_chunks = *(char**)chunk;
+    munmap(chunk, *(size_t*)(chunk+sizeof(char*)));
+  }
+  ssf_arena_carve = ssf_arena_end = 0;
+  ssf_arena_total = 0;
 }
 
 }; /*namespace minissf*/
@@ -6,7 +6,10 @@
  * allocation and deallocation services at each processor. The speed
  * comes at the cost of additional memory consumption due to
  * fragmentation. The memory blocks are chosen from free memory chunks
- * with sizes rounded up to the power of two.
+ * with sizes rounded up to the power of two. A memory block freed by a
+ * processor other than the one that allocated it is returned to its
+ * owner (which reclaims such blocks in batches). Memory chunks that
+ * no longer hold any live blocks are given back to the system.
  *
  * The header file also contains the definition of the QuickObject
  * class; Users do not need to include this header file directly; it
@@ -17,6 +20,7 @@
 #define __MINISSF_QUICK_MEMORY_H__
 
 #include <stdio.h>
+#include <new>
 
 namespace minissf {
 
@@ -28,6 +32,28 @@ extern void ssf_quickmem_init(int pid);
 // each processor; not to be called by user
 extern void ssf_quickmem_wrapup(int pid);
 
+// print the live and peak bytes of each size class of quick memory at
+// the processor (with the column header if requested); called by
+// each processor for the report; not to be called by user
+extern void ssf_quickmem_report(int pid, bool header);
+
+// allocate memory from the init arena, which is used for the kernel
+// objects created only at simulation initialization and kept until
+// the end of simulation (entities, channels, and channel mappings);
+// the objects are packed without per-object headers and the memory
+// is never reclaimed individually; only called during initialization
+// (by all processors if the model is initialized in parallel); the
+// memory is aligned to 16 bytes, or the given alignment if larger (a
+// power of two); not to be called by user
+extern void* ssf_arena_malloc(size_t size, size_t align = 16);
+
+// return the number of bytes allocated from the init arena
+extern size_t ssf_arena_size();
+
+// give all memory of the init arena back to the system after all
+// objects in it are destroyed; not to be called by user
+extern void ssf_arena_release();
+
 /** 
  * \brief Allocate memory of the given size from quick memory.
  *
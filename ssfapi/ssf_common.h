@@ -21,6 +21,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 
@@ -72,6 +73,7 @@ typedef unsigned long int uint64; ///< 64-bit unsigned integer type
 #define MAP(S,T) std::map<S,T > ///< same as std::map
 #define MULTIMAP(S,T) std::multimap<S,T > ///< same as std::multimap
 #define SET(T) std::set<T > ///< same as std::set
+#define UNORDERED_MAP(S,T) std::unordered_map<S,T > ///< same as std::unordered_map
 #define VECTOR(T) std::vector<T > ///< same as std::vector
 
 typedef std::string STRING; ///< same as std::string
@@ -87,16 +89,19 @@ class outChannel;
 class Event;
 class Timer;
 class Semaphore;
+class Snapshot;
 class Timeline;
 class Universe;
 class MapOutport;
 class MapInport;
+class MapStarport;
 class Stargate;
 class KernelEvent;
 class TickEvent;
 class TimerEvent;
 class HoldEvent;
 class ChannelEvent;
+class ChannelBatchEvent;
 class ProcessEvent;
 class SemaphoreEvent;
 
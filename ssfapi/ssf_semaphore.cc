@@ -27,10 +27,12 @@ void Semaphore::wait()
 
   sem_count--; 
   if(sem_count < 0) {
-    // get the process off the running queue
-    p->suspend_process();
     // add calling process to the end of the semaphore waiting list
+    // (before the process is suspended, since a stackful process
+    // switches out right away)
     blocked_processes.push_back(p);
+    // get the process off the running queue
+    p->suspend_process();
   }
 }
 
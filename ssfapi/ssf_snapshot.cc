@@ -0,0 +1,66 @@
+#include <assert.h>
+#include <string.h>
+#include "ssfapi/ssf_snapshot.h"
+
+namespace minissf {
+
+Snapshot::Snapshot(STRING* savebuf, bool ckpt) :
+  loading(false), checkpoint(ckpt), save_buffer(savebuf), load_buffer(0), load_length(0), load_position(0) 
+{
+  assert(savebuf);
+}
+
+Snapshot::Snapshot(const char* loadbuf, int loadlen, bool ckpt) :
+  loading(true), checkpoint(ckpt), save_buffer(0), load_buffer(loadbuf), load_length(loadlen), load_position(0) {}
+
+void Snapshot::data(void* buf, int len)
+{
+  if(len < 0 || (len > 0 && !buf)) SSF_THROW("invalid memory block");
+  if(loading) {
+    if(load_position+len > load_length) 
+      SSF_THROW("read beyond the entity state saved in the " << (checkpoint ? "checkpoint" : "model snapshot"));
+    memcpy(buf, load_buffer+load_position, len);
+    load_position += len;
+  } else save_buffer->append((const char*)buf, len);
+}
+
+void Snapshot::text(STRING& str)
+{
+  int len = (int)str.length();
+  data(&len, sizeof(int));
+  if(loading) {
+    if(len < 0 || load_position+len > load_length) 
+      SSF_THROW("read beyond the entity state saved in the " << (checkpoint ? "checkpoint" : "model snapshot"));
+    str.assign(load_buffer+load_position, len);
+    load_position += len;
+  } else save_buffer->append(str);
+}
+
+}; /*namespace minissf*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */
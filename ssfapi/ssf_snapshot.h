@@ -0,0 +1,115 @@
+/**
+ * \file ssf_snapshot.h
+ * \brief Header file for the model snapshot class.
+ *
+ * This header file contains the definition of the model snapshot
+ * class; Users do not need to include this header file directly; it
+ * is included from ssf.h.
+ */
+
+#ifndef __MINISSF_SNAPSHOT_H__
+#define __MINISSF_SNAPSHOT_H__
+
+#include "ssfapi/ssf_common.h"
+
+namespace minissf {
+
+/** \brief The state of an entity saved in or restored from a model snapshot.
+ *
+ * Building a large model (creating entities, aligning them into
+ * timelines, and wiring up the channels) can take longer than
+ * running it. With the --save-model command-line option, the
+ * simulator writes the initialized model into a binary snapshot
+ * file; a later run with the --load-model option restores the
+ * timelines and the channel mappings from the file, rather than
+ * aligning the entities and wiring up the channels again. The user
+ * still creates the same entities, inchannels, and outchannels in
+ * the same order; the entity alignments and the outchannel mappings
+ * are ignored, however, when the model is loaded from a snapshot.
+ *
+ * The simulator calls the serialize() method of each entity with an
+ * object of this class right before the entity's init() method, both
+ * when the snapshot is saved and when it is loaded. The entity is
+ * expected to pass the same state variables in the same order, with
+ * the data() or value() method, which writes the variables into the
+ * snapshot when saving, and reads them back when loading.
+ *
+ * The same method is called with an object of this class when the
+ * simulator takes a checkpoint (with the --checkpoint command-line
+ * option) and when the simulation restarts from the checkpoint (with
+ * the --restart option); isCheckpoint() returns true in both cases.
+ */
+class Snapshot {
+ public:
+  /** \brief Return true if the state is being restored from the snapshot (false if being saved). */
+  inline bool isLoading() const { return loading; }
+
+  /** \brief Return true if this is a checkpoint of the running simulation (false if it's a model snapshot). */
+  inline bool isCheckpoint() const { return checkpoint; }
+
+  /** \brief Save or restore a block of memory.
+   *
+   * When the snapshot is saved, the given number of bytes at the
+   * buffer are written into the snapshot; when the snapshot is
+   * loaded, the same number of bytes are read from the snapshot into
+   * the buffer. It is an error to read beyond the data saved for the
+   * entity.
+   *
+   * \param buf points to the memory block
+   * \param len the number of bytes in the memory block
+   */
+  void data(void* buf, int len);
+
+  /** \brief Save or restore a variable (of a plain data type). */
+  template<typename T> void value(T& x) { data(&x, sizeof(T)); }
+
+  /** \brief Save or restore a string. */
+  void text(STRING& str);
+
+ private:
+  // only the simulator creates the snapshot for an entity: either
+  // the state is written to the given string, or it's read from the
+  // given memory block
+  Snapshot(STRING* savebuf, bool ckpt = false);
+  Snapshot(const char* loadbuf, int loadlen, bool ckpt = false);
+
+  bool loading; // true if restoring the state of the entity
+  bool checkpoint; // true if the snapshot is a checkpoint
+  STRING* save_buffer; // the state is appended to this string when saving
+  const char* load_buffer; // the state is read from this memory block when loading
+  int load_length; // the size of the memory block
+  int load_position; // the number of bytes already read
+
+  friend class Universe;
+}; /*class Snapshot*/
+
+}; /*namespace minissf*/
+
+#endif /*__MINISSF_SNAPSHOT_H__*/
+
+/*
+ * Copyright (c) 2011-2014 Florida International University.
+ *
+ * Permission is hereby granted, free of charge, to any individual or
+ * institution obtaining a copy of this software and associated
+ * documentation files (the "software"), to use, copy, modify, and
+ * distribute without restriction.
+ *
+ * The software is provided "as is", without warranty of any kind,
+ * express or implied, including but not limited to the warranties of
+ * merchantability, fitness for a particular purpose and
+ * noninfringement.  In no event shall Florida International
+ * University be liable for any claim, damages or other liability,
+ * whether in an action of contract, tort or otherwise, arising from,
+ * out of or in connection with the software or the use or other
+ * dealings in the software.
+ *
+ * This software is developed and maintained by
+ *
+ *   Modeling and Networking Systems Research Group
+ *   School of Computing and Information Sciences
+ *   Florida International University
+ *   Miami, Florida 33199, USA
+ *
+ * You can find our research at http://www.primessf.net/.
+ */